@@ -0,0 +1,378 @@
+/*
+* Copyright 2021-2021 Zhouwei. All rights reserved.
+* License: https://github.com/zwluoqi/mobile-visual-shader-editor#license-bsd-2-clause
+*/
+
+//命令行批量编译材质, 不依赖窗口和entry, 给构建机预编译用
+//vsg_batch [-j N] [-p glsl,essl,spirv,metal] [-o outDir] [--shader-root runtime_visual_shader] <.nodedata或目录>...
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <bx/commandline.h>
+#include <bx/file.h>
+#include <bx/string.h>
+#include <bgfx/bgfx.h>
+#include "bgfx_utils.h"
+
+#include "../shaderc/shaderc.h"
+#include "../shader_online/shader_graph/graph.h"
+#include "../shader_online/shader_graph/serialize.h"
+#include "../shader_online/shader_complie/code_generate.h"
+
+namespace vsgbatch {
+
+    struct Target{
+        const char* name;
+        const char* profile;
+        const char* platform;
+        bool serialized;//后端在shaderc里有进程级的锁, 多线程时同一时间只编一个
+    };
+
+    static const Target s_targets[] =
+    {
+        { "glsl",  "120",    "linux",   true  },
+        { "essl",  "100_es", "android", true  },
+        { "spirv", "spirv",  "linux",   false },
+        { "metal", "metal",  "osx",     false },
+    };
+
+    struct Material{
+        std::string path;
+        std::string name;
+        bool generated = false;
+        double generateMs = 0.0;
+        std::string vertex;
+        std::string fragment;
+        std::string varying;
+        uint64_t programKey = 0;//csg::structural_hash
+        size_t owner = 0;//结构相同的材质只编第一个, 其他的用它的二进制
+        std::vector<std::string> sharedNames;//owner上记着共用这份二进制的其他材质
+    };
+
+    struct Job{
+        size_t material;
+        const Target* target;
+        bool fragment;
+        bool success = false;
+        double compileMs = 0.0;
+        size_t binarySize = 0;
+    };
+
+    static double elapsed_ms(std::chrono::steady_clock::time_point start){
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    static bool read_file(const std::string& filePath,std::string& content){
+        bx::FileReader reader;
+        if(!bx::open(&reader, filePath.c_str())){
+            return false;
+        }
+        content.resize((size_t)bx::getSize(&reader));
+        bx::Error err;
+        bx::read(&reader, &content[0], (int32_t)content.size(), &err);
+        bx::close(&reader);
+        return err.isOk();
+    }
+
+    static bool write_file(const std::string& filePath,const std::vector<uint8_t>& data){
+        bx::FilePath fp(filePath.c_str());
+        if(!bx::makeAll(fp.getPath())){
+            return false;
+        }
+        bx::FileWriter writer;
+        if(!bx::open(&writer, filePath.c_str())){
+            return false;
+        }
+        bx::write(&writer, data.data(), (int32_t)data.size());
+        bx::close(&writer);
+        return true;
+    }
+
+    static bool ends_with(const std::string& str,const char* suffix){
+        const size_t len = strlen(suffix);
+        return str.size() >= len && 0 == str.compare(str.size() - len, len, suffix);
+    }
+
+    static void collect_nodedata(const std::string& path,std::vector<std::string>& files){
+        struct stat pathStat;
+        if(stat(path.c_str(), &pathStat) != 0){
+            bx::printf("skip %s: not found\n", path.c_str());
+            return;
+        }
+        if(!S_ISDIR(pathStat.st_mode)){
+            files.push_back(path);
+            return;
+        }
+        DIR* dir = opendir(path.c_str());
+        if(dir == NULL){
+            return;
+        }
+        std::vector<std::string> children;
+        while(struct dirent* entry = readdir(dir)){
+            if(entry->d_name[0] != '.'){
+                children.push_back(path + "/" + entry->d_name);
+            }
+        }
+        closedir(dir);
+        std::sort(children.begin(), children.end());
+        for(const auto& child : children){
+            struct stat childStat;
+            if(stat(child.c_str(), &childStat) == 0 && (S_ISDIR(childStat.st_mode) || ends_with(child, ".nodedata"))){
+                collect_nodedata(child, files);
+            }
+        }
+    }
+
+    //include文件所有编译线程共用, 每个只读一次
+    class IncludeCache{
+    public:
+        bool resolve(const std::string& filePath,std::string& source){
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = sources.find(filePath);
+            if(it == sources.end()){
+                std::string content;
+                const bool exist = read_file(filePath, content);
+                it = sources.emplace(filePath, std::make_pair(exist, content)).first;
+            }
+            source = it->second.second;
+            return it->second.first;
+        }
+    private:
+        std::mutex mutex;
+        std::map<std::string, std::pair<bool, std::string>> sources;
+    };
+
+    static void generate(Material& material){
+        const auto start = std::chrono::steady_clock::now();
+        std::string content;
+        if(!read_file(material.path, content)){
+            bx::printf("%s: can not read\n", material.path.c_str());
+            return;
+        }
+        boost::optional<csg::Graph> graph = csg::deserialize_graph(content);
+        if(!graph){
+            bx::printf("%s: not a graph\n", material.path.c_str());
+            return;
+        }
+        //每个材质一份SharedState, 渐变/曲线的层号是按材质分配的
+        auto sharedState = std::make_shared<cse::SharedState>();
+        auto code = csg::generate_graph_code(std::make_shared<csg::Graph>(*graph), sharedState);
+        material.vertex = code->ExportVertex();
+        material.fragment = code->ExportFragment();
+        material.varying = code->ExportVaring();
+        material.programKey = csg::structural_hash(material.vertex, material.fragment, material.varying);
+        material.generated = true;
+        material.generateMs = elapsed_ms(start);
+    }
+
+    static void compile(const Material& material,Job& job,const std::string& shaderRoot,const std::string& outDir,IncludeCache& includes){
+        const auto start = std::chrono::steady_clock::now();
+        const char* stage = job.fragment ? "frag" : "vertex";
+
+        runshaderc::CompileRequest request;
+        //和编辑器一样按shader_graph/<name>/<name>_<stage>.sc命名, include按src_shader查找
+        request.options.inputFilePath = shaderRoot + "/shader_graph/" + material.name + "/" + material.name + "_" + stage + ".sc";
+        request.options.shaderType = job.fragment ? 'f' : 'v';
+        request.options.platform = job.target->platform;
+        request.options.profile = job.target->profile;
+        request.options.includeDirs.push_back(shaderRoot + "/src_shader");
+        request.source = job.fragment ? material.fragment : material.vertex;
+        request.varying = material.varying;
+        request.includeResolver = [&includes](const std::string& filePath, std::string& source){
+            return includes.resolve(filePath, source);
+        };
+
+        runshaderc::CompileResult result = runshaderc::compile(request);
+        job.compileMs = elapsed_ms(start);
+        job.success = result.success;
+        job.binarySize = result.binary.size();
+        if(!result.success){
+            bx::printf("%s [%s %s]: %s\n", material.path.c_str(), job.target->name, stage, result.error.c_str());
+        }else if(!outDir.empty()){
+            write_file(outDir + "/" + job.target->name + "/" + material.name + "_" + stage + ".bin", result.binary);
+            for(const auto& sharedName : material.sharedNames){
+                write_file(outDir + "/" + job.target->name + "/" + sharedName + "_" + stage + ".bin", result.binary);
+            }
+        }
+    }
+
+    static void help(){
+        bx::printf(
+              "vsg_batch, compiles .nodedata materials without the editor.\n"
+              "usage: vsg_batch [options] <file.nodedata|dir>...\n"
+              "  -j <n>                  compile threads, default: all cores\n"
+              "  -p <list>               comma separated targets: glsl,essl,spirv,metal (default: all)\n"
+              "  -o <dir>                write <dir>/<target>/<name>_vertex.bin/_frag.bin\n"
+              "  --shader-root <dir>     runtime shader dir with src_shader/common/node (default: runtime_visual_shader)\n"
+              );
+    }
+
+    static int run(int _argc, const char* const* _argv){
+        bx::CommandLine cmdLine(_argc, _argv);
+        if(cmdLine.hasArg('h', "help")){
+            help();
+            return bx::kExitSuccess;
+        }
+
+        uint32_t numThreads = std::max(1u, std::thread::hardware_concurrency());
+        cmdLine.hasArg(numThreads, 'j');
+        numThreads = std::max(1u, numThreads);
+
+        const char* outDirArg = cmdLine.findOption('o');
+        const std::string outDir = outDirArg != NULL ? outDirArg : "";
+        const char* rootArg = cmdLine.findOption("shader-root");
+        //生成的源码里include的是"../common/..."和"../node/...", 相对于<shaderRoot>/src_shader
+        const std::string shaderRoot = rootArg != NULL ? rootArg : "runtime_visual_shader";
+
+        std::vector<const Target*> targets;
+        const char* targetArg = cmdLine.findOption('p');
+        for(const Target& target : s_targets){
+            if(targetArg == NULL || !bx::strFind(targetArg, target.name).isEmpty()){
+                targets.push_back(&target);
+            }
+        }
+        if(targets.empty()){
+            help();
+            return bx::kExitFailure;
+        }
+
+        std::vector<std::string> files;
+        for(int32_t ii = 1; ii < _argc; ++ii){
+            const char* arg = _argv[ii];
+            if(arg[0] == '-'){
+                //跳过带参数的选项
+                if(0 == bx::strCmp(arg, "-j") || 0 == bx::strCmp(arg, "-p") || 0 == bx::strCmp(arg, "-o") || 0 == bx::strCmp(arg, "--shader-root")){
+                    ++ii;
+                }
+                continue;
+            }
+            collect_nodedata(arg, files);
+        }
+        if(files.empty()){
+            help();
+            return bx::kExitFailure;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+
+        //代码生成会创建渐变贴图, bgfx资源只能在一个线程上建, 所以生成放在主线程顺序做
+        std::vector<Material> materials(files.size());
+        for(size_t i = 0; i < files.size(); i++){
+            materials[i].path = files[i];
+            bx::FilePath fp(files[i].c_str());
+            materials[i].name.assign(fp.getBaseName().getPtr(), fp.getBaseName().getTerm());
+            generate(materials[i]);
+        }
+        const double generateMs = elapsed_ms(start);
+
+        //只差参数默认值和贴图的材质源码相同, 每种结构只编一次
+        std::map<uint64_t, size_t> owners;
+        for(size_t i = 0; i < materials.size(); i++){
+            if(!materials[i].generated){
+                continue;
+            }
+            auto owner = owners.emplace(materials[i].programKey, i).first;
+            materials[i].owner = owner->second;
+            if(owner->second != i){
+                materials[owner->second].sharedNames.push_back(materials[i].name);
+            }
+        }
+
+        std::vector<Job> jobs;
+        for(size_t i = 0; i < materials.size(); i++){
+            if(!materials[i].generated || materials[i].owner != i){
+                continue;
+            }
+            for(const Target* target : targets){
+                Job vertexJob;
+                vertexJob.material = i;
+                vertexJob.target = target;
+                vertexJob.fragment = false;
+                jobs.push_back(vertexJob);
+                Job fragJob = vertexJob;
+                fragJob.fragment = true;
+                jobs.push_back(fragJob);
+            }
+        }
+
+        IncludeCache includes;
+        std::atomic<size_t> nextJob{ 0 };
+        std::vector<std::thread> workers;
+        for(uint32_t t = 0; t < std::min<size_t>(numThreads, jobs.size()); t++){
+            workers.emplace_back([&](){
+                for(size_t j = nextJob++; j < jobs.size(); j = nextJob++){
+                    compile(materials[jobs[j].material], jobs[j], shaderRoot, outDir, includes);
+                }
+            });
+        }
+        for(auto& worker : workers){
+            worker.join();
+        }
+
+        uint32_t failed = 0;
+        bx::printf("%-40s %-6s %10s %12s %10s %12s\n", "material", "target", "vs ms", "vs bytes", "fs ms", "fs bytes");
+        for(size_t i = 0; i < materials.size(); i++){
+            const Material& material = materials[i];
+            if(!material.generated){
+                failed++;
+                bx::printf("%-40s generate failed\n", material.name.c_str());
+                continue;
+            }
+            if(material.owner != i){
+                bx::printf("%-40s %-6s %10.1f  same program as %s\n", material.name.c_str(), "gen", material.generateMs, materials[material.owner].name.c_str());
+                continue;
+            }
+            bx::printf("%-40s %-6s %10.1f\n", material.name.c_str(), "gen", material.generateMs);
+            for(size_t j = 0; j + 1 < jobs.size(); j += 2){
+                const Job& vs = jobs[j];
+                const Job& fs = jobs[j + 1];
+                if(vs.material != i){
+                    continue;
+                }
+                failed += (vs.success ? 0 : 1) + (fs.success ? 0 : 1);
+                bx::printf("%-40s %-6s %10.1f %12zu %10.1f %12zu%s\n", "", vs.target->name
+                    , vs.compileMs, vs.binarySize, fs.compileMs, fs.binarySize
+                    , vs.success && fs.success ? "" : "  FAILED");
+            }
+        }
+        bx::printf("%zu materials, %zu programs, %zu stages, %u failed, %u threads, generate %.1f ms, total %.1f ms\n"
+            , materials.size(), owners.size(), jobs.size(), failed, (uint32_t)workers.size(), generateMs, elapsed_ms(start));
+        if(workers.size() > 1){
+            for(const Target* target : targets){
+                if(target->serialized){
+                    bx::printf("note: glsl/essl stages compile one at a time (glsl-optimizer is not thread-safe), their ms include waiting for the lock\n");
+                    break;
+                }
+            }
+        }
+
+        return failed == 0 ? bx::kExitSuccess : bx::kExitFailure;
+    }
+}
+
+int main(int _argc, const char* _argv[])
+{
+    //SharedState会建渐变贴图, 用Noop后端让bgfx在没有窗口的时候也能跑
+    bgfx::Init init;
+    init.type = bgfx::RendererType::Noop;
+    if(!bgfx::init(init)){
+        bx::printf("bgfx init failed\n");
+        return bx::kExitFailure;
+    }
+
+    const int result = vsgbatch::run(_argc, _argv);
+
+    bgfx::shutdown();
+    return result;
+}
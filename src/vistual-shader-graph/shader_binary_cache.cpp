@@ -0,0 +1,220 @@
+/*
+* Copyright 2021-2021 Zhouwei. All rights reserved.
+* License: https://github.com/zwluoqi/mobile-visual-shader-editor#license-bsd-2-clause
+*/
+
+#include <inttypes.h>
+#include <sstream>
+#include "vsg_global.h"
+#include "shader_binary_cache.h"
+
+namespace vsg {
+
+    static const char* disk_index_name = "index.txt";
+
+    //FNV-1a 64
+    static uint64_t hash_bytes(uint64_t hash,const void* data,size_t size){
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for(size_t i=0;i<size;i++){
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    //长度也算进去, 避免两段拼起来相同的输入撞key
+    static uint64_t hash_string(uint64_t hash,const char* str,size_t size){
+        const uint64_t len = size;
+        hash = hash_bytes(hash,&len,sizeof(len));
+        return hash_bytes(hash,str,size);
+    }
+
+    ShaderBinaryCache::EntryList::iterator ShaderBinaryCache::Lru::find(uint64_t key){
+        auto it = index.find(key);
+        return it == index.end() ? entries.end() : it->second;
+    }
+
+    void ShaderBinaryCache::Lru::touch(EntryList::iterator it){
+        entries.splice(entries.end(),entries,it);
+    }
+
+    void ShaderBinaryCache::Lru::push(const Entry& entry){
+        entries.push_back(entry);
+        index[entry.key] = std::prev(entries.end());
+        bytes += entry.size;
+    }
+
+    ShaderBinaryCache::Entry ShaderBinaryCache::Lru::pop_oldest(){
+        Entry entry = entries.front();
+        entries.pop_front();
+        index.erase(entry.key);
+        bytes -= entry.size;
+        return entry;
+    }
+
+    ShaderBinaryCache::ShaderBinaryCache(const std::string& _diskDir,uint64_t maxMemoryBytes,uint64_t maxDiskBytes)
+    :diskDir(_diskDir)
+    {
+        memory.maxBytes = maxMemoryBytes;
+        disk.maxBytes = maxDiskBytes;
+    }
+
+    ShaderBinaryCache::~ShaderBinaryCache(){
+        flush();
+    }
+
+    uint64_t ShaderBinaryCache::make_key(const std::string& expandedSource,const std::string& varyingDef,const char* shaderType,const char* platform,const char* profile){
+        const char* version = runshaderc::getVersionString();
+        uint64_t hash = 14695981039346656037ull;
+        hash = hash_string(hash,expandedSource.c_str(),expandedSource.size());
+        hash = hash_string(hash,varyingDef.c_str(),varyingDef.size());
+        hash = hash_string(hash,shaderType,strlen(shaderType));
+        hash = hash_string(hash,platform,strlen(platform));
+        hash = hash_string(hash,profile,strlen(profile));
+        hash = hash_string(hash,version,strlen(version));
+        return hash;
+    }
+
+    bool ShaderBinaryCache::find(uint64_t key,std::vector<uint8_t>& data){
+        std::unique_lock<std::mutex> lock(cache_mutex);
+        auto it = memory.find(key);
+        if(it != memory.entries.end()){
+            memory.touch(it);
+            data = *it->data;
+            return true;
+        }
+
+        load_disk_index();
+        it = disk.find(key);
+        if(it == disk.entries.end()){
+            return false;
+        }
+        const uint64_t entrySize = it->size;
+        const std::string filePath = disk_file(key);
+
+        //读.bin时放开锁, 另一个阶段的查找不用排在这次读文件后面
+        lock.unlock();
+        uint32_t size = 0;
+        void* fileData = load_file(filePath.c_str(),&size,false);
+        lock.lock();
+
+        //放锁期间这一项可能已经被淘汰了, 重新找一次
+        it = disk.find(key);
+        if(fileData == NULL || size != entrySize){
+            //文件被删掉或者没写完整
+            if(fileData != NULL){
+                BX_FREE(entry::getAllocator(),fileData);
+            }
+            if(it != disk.entries.end()){
+                disk.bytes -= it->size;
+                disk.index.erase(key);
+                disk.entries.erase(it);
+                diskIndexDirty = true;
+            }
+            return false;
+        }
+        //只改内存里的顺序, index.txt等insert或者flush时再写
+        if(it != disk.entries.end()){
+            disk.touch(it);
+            diskIndexDirty = true;
+        }
+
+        auto binary = std::make_shared<std::vector<uint8_t>>(static_cast<uint8_t*>(fileData),static_cast<uint8_t*>(fileData)+size);
+        BX_FREE(entry::getAllocator(),fileData);
+        insert_memory(key,binary);
+        data = *binary;
+        return true;
+    }
+
+    void ShaderBinaryCache::insert(uint64_t key,const std::vector<uint8_t>& data){
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        insert_memory(key,std::make_shared<std::vector<uint8_t>>(data));
+
+        if(diskDir.empty()){
+            return;
+        }
+        load_disk_index();
+        auto it = disk.find(key);
+        if(it != disk.entries.end()){
+            disk.touch(it);
+            diskIndexDirty = true;
+        }else if(data.size() <= disk.maxBytes && write_file(disk_file(key).c_str(),(void*)data.data(),(uint32_t)data.size(),false)){
+            disk.push(Entry{key,nullptr,data.size()});
+            while(disk.bytes > disk.maxBytes){
+                bx::remove(disk_file(disk.pop_oldest().key).c_str());
+            }
+            save_disk_index();
+        }
+    }
+
+    void ShaderBinaryCache::flush(){
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        if(diskIndexDirty){
+            save_disk_index();
+        }
+    }
+
+    void ShaderBinaryCache::insert_memory(uint64_t key,const std::shared_ptr<std::vector<uint8_t>>& data){
+        auto it = memory.find(key);
+        if(it != memory.entries.end()){
+            memory.touch(it);
+            return;
+        }
+        if(data->size() > memory.maxBytes){
+            return;
+        }
+        memory.push(Entry{key,data,data->size()});
+        while(memory.bytes > memory.maxBytes){
+            memory.pop_oldest();
+        }
+    }
+
+    std::string ShaderBinaryCache::disk_file(uint64_t key) const{
+        char name[32];
+        bx::snprintf(name,sizeof(name),"%016" PRIx64 ".bin",key);
+        return diskDir + "/" + name;
+    }
+
+    //index.txt每行是"key size", 最旧的在前面
+    void ShaderBinaryCache::load_disk_index(){
+        if(diskIndexLoaded || diskDir.empty()){
+            return;
+        }
+        diskIndexLoaded = true;
+
+        std::string indexPath = diskDir + "/" + disk_index_name;
+        uint32_t size = 0;
+        void* indexData = exist_file(indexPath.c_str()) ? load_file(indexPath.c_str(),&size,false) : NULL;
+        if(indexData == NULL){
+            return;
+        }
+        std::istringstream stream(std::string(static_cast<const char*>(indexData),size));
+        BX_FREE(entry::getAllocator(),indexData);
+
+        std::string keyStr;
+        uint64_t entrySize;
+        while(stream >> keyStr >> entrySize){
+            const uint64_t key = strtoull(keyStr.c_str(),NULL,16);
+            if(disk.find(key) == disk.entries.end()){
+                disk.push(Entry{key,nullptr,entrySize});
+            }
+        }
+        while(disk.bytes > disk.maxBytes){
+            bx::remove(disk_file(disk.pop_oldest().key).c_str());
+            diskIndexDirty = true;
+        }
+    }
+
+    void ShaderBinaryCache::save_disk_index(){
+        diskIndexDirty = false;
+        std::stringstream stream;
+        for(const auto& entry : disk.entries){
+            char key[32];
+            bx::snprintf(key,sizeof(key),"%016" PRIx64,entry.key);
+            stream<<key<<" "<<entry.size<<"\n";
+        }
+        std::string indexPath = diskDir + "/" + disk_index_name;
+        std::string content = stream.str();
+        write_file(indexPath.c_str(),(void*)content.c_str(),(uint32_t)content.size(),false);
+    }
+}
@@ -0,0 +1,67 @@
+/*
+* Copyright 2021-2021 Zhouwei. All rights reserved.
+* License: https://github.com/zwluoqi/mobile-visual-shader-editor#license-bsd-2-clause
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vsg{
+
+    //编译好的shader二进制缓存, 内存和磁盘各有一个按大小淘汰的LRU
+    //key只由编译输入决定, 撤销/重做或者切回之前的枚举值时可以直接拿到二进制
+    class ShaderBinaryCache
+    {
+    public:
+        //diskDir为空时只用内存缓存
+        ShaderBinaryCache(const std::string& diskDir,uint64_t maxMemoryBytes,uint64_t maxDiskBytes);
+        ~ShaderBinaryCache();
+
+        //展开include后的源码, varying.def, shader类型, 平台, profile和shaderc版本一起算hash
+        static uint64_t make_key(const std::string& expandedSource,const std::string& varyingDef,const char* shaderType,const char* platform,const char* profile);
+
+        bool find(uint64_t key,std::vector<uint8_t>& data);
+        void insert(uint64_t key,const std::vector<uint8_t>& data);
+        //命中只改内存里的LRU顺序, 写入/淘汰时才写index.txt, 剩下的顺序在这里写, 退出时调用
+        void flush();
+
+    private:
+        struct Entry{
+            uint64_t key;
+            std::shared_ptr<std::vector<uint8_t>> data;//磁盘LRU里为空
+            uint64_t size;
+        };
+        typedef std::list<Entry> EntryList;
+
+        struct Lru{
+            EntryList entries;//最近用的在后面
+            std::unordered_map<uint64_t,EntryList::iterator> index;
+            uint64_t bytes = 0;
+            uint64_t maxBytes = 0;
+
+            EntryList::iterator find(uint64_t key);
+            void touch(EntryList::iterator it);
+            void push(const Entry& entry);
+            Entry pop_oldest();
+        };
+
+        std::string disk_file(uint64_t key) const;
+        void load_disk_index();
+        void save_disk_index();
+        void insert_memory(uint64_t key,const std::shared_ptr<std::vector<uint8_t>>& data);
+
+        std::mutex cache_mutex;
+        std::string diskDir;
+        bool diskIndexLoaded = false;
+        bool diskIndexDirty = false;//磁盘LRU顺序变了还没写进index.txt
+        Lru memory;
+        Lru disk;
+    };
+}
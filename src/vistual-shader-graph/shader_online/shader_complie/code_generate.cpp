@@ -21,6 +21,8 @@
 #include <boost/tokenizer.hpp>
 
 #include "../shader_core/config.h"
+#include "../shader_core/hash.h"
+#include "../shader_core/profiler.h"
 #include "../shader_core/rect.h"
 #include "../shader_core/vector.h"
 
@@ -35,30 +37,16 @@
 #include "slot.h"
 #include "slot_id.h"
 #include "code_rampcolor_byte.h"
+#include "constant_fold.h"
+#include "shader_ir.h"
 
 
 namespace csg {
 
         static std::string ResolveNode(std::shared_ptr<csg::CodeGenerateData> codeGenerateData,  const std::shared_ptr<const Node> node, int getOutIndex = 0);
-        static std::string ResolveSlot(std::shared_ptr<csg::CodeGenerateData> codeGenerateData,  SlotId& slot, bool* connected);
+        static ir::Operand ResolveSlot(std::shared_ptr<csg::CodeGenerateData> codeGenerateData,  SlotId& slot, bool* connected);
 
 
-        static const char* type_shadername_str[static_cast<int>(csg::SlotType::Count)+1] =
-        {
-            "float",//BOOL
-            "Closure",//CLOSURE
-            "vec4",//COLOR
-            "float",//FLOAT
-            "float",//INT
-            "vec3",//VECTOR
-            "Enumeration",//ENUM
-            "float",//CURVE_RGB
-            "float",//CURVE_VECTOR
-            "float",//COLOR_RAMP
-            "IMAGE",
-            "[ERROR]"
-        };
-
         static const csc::UniformType::Enum type_shadername_uniformType[static_cast<int>(csg::SlotType::Count)+1] =
         {
             csc::UniformType::Float,//BOOL,
@@ -92,81 +80,17 @@ namespace csg {
             "error",
         };
 
-        static std::string convert_type_shader_name(csg::SlotType s_type,csg::SlotType d_type,std::string s_slot_shader_name){
-            std::stringstream ret;
-            switch (s_type) {
-                case SlotType::BOOL:
-                case SlotType::FLOAT:
-                case SlotType::INT:
-                    switch (d_type) {
-                        case SlotType::COLOR:
-                        case SlotType::VECTOR:
-                            ret<<type_shadername_str[static_cast<int>(d_type)];
-                            ret<<"("<<s_slot_shader_name<<")";
-                            return ret.str();
-                            break;
-                        case SlotType::FLOAT:
-                        case SlotType::INT:
-                        case SlotType::BOOL:
-                            return s_slot_shader_name;
-                            break;
-                        default:
-                            assert(false);
-                            break;
-                    }
-                    break;
-                case SlotType::COLOR:
-                    switch (d_type) {
-                        case SlotType::FLOAT:
-                        case SlotType::INT:
-                        case SlotType::BOOL:
-                            ret<<s_slot_shader_name<<".x";
-                            return ret.str();
-                            break;
-                        case SlotType::VECTOR:
-                            ret<<s_slot_shader_name<<".xyz";
-                            return ret.str();
-                            break;
-                        default:
-                            assert(false);
-                            break;
-                    }
-                    break;
-                case SlotType::VECTOR:
-                    switch (d_type) {
-                        case SlotType::FLOAT:
-                        case SlotType::INT:
-                        case SlotType::BOOL:
-                            ret<<s_slot_shader_name<<".x";
-                            return ret.str();
-                            break;
-                        case SlotType::COLOR:
-                            ret<<type_shadername_str[static_cast<int>(d_type)];
-                            ret<<"("<<s_slot_shader_name<<",1.0)";
-                            return ret.str();
-                            break;
-                        default:
-                            break;
-                    }
-                    break;
-                default:
-                    assert(false);
-                    break;
-            }
-            return s_slot_shader_name;
-        }
-
         static const std::string val_glsl_str(csc::Float3 val)
         {
             std::stringstream ret;
-            ret<<"vec3("<<val.x<<","<<val.y<<","<<val.z<<");";
+            ret<<"vec3("<<val.x<<","<<val.y<<","<<val.z<<")";
             return ret.str();
         }
 
         static const std::string val_glsl_str(csc::Float4 val)
         {
             std::stringstream ret;
-            ret<<"vec4("<<val.x<<","<<val.y<<","<<val.z<<","<<val.w<<");";
+            ret<<"vec4("<<val.x<<","<<val.y<<","<<val.z<<","<<val.w<<")";
             return ret.str();
         }
 
@@ -180,6 +104,12 @@ namespace csg {
             return uniformData;
         }
 
+        //prelude values are declared once at the top of main()
+        static void AddPreludeValue(std::shared_ptr<csg::CodeGenerateData> codeGenerateData, const char* name, const char* expr) {
+            const ir::Value value{ ir::Value::builtin(name) };
+            codeGenerateData->fragment.declare(-1, value, ir::Value::literal(value.type, expr));
+        }
+
         static void AddMVPUniform(std::shared_ptr<csg::CodeGenerateData> codeGenerateData) {
             //default val
         }
@@ -188,11 +118,11 @@ namespace csg {
         static void AddLightUniform(std::shared_ptr<csg::CodeGenerateData> codeGenerateData) {
             codeGenerateData->AddUniformParams(UniformCodeData{ ShaderDataType::varying, "vWorldToLight",csc::UniformType::Mat4 });
             codeGenerateData->AddUniformParams(UniformCodeData{ ShaderDataType::varying, "vPositionFromLight",csc::UniformType::Vec4 });
-            codeGenerateData->vertex_stream << " vWorldToLight = uLightVP;\n";
-            codeGenerateData->vertex_stream << " vPositionFromLight = uLightMVP * vec4(a_position, 1.0);\n";
+            codeGenerateData->AddVertexStatement("vWorldToLight", "uLightVP");
+            codeGenerateData->AddVertexStatement("vPositionFromLight", "uLightMVP * vec4(a_position, 1.0)");
             
-            codeGenerateData->fragment_stream << "vec3 lightDir = normalize(uLightDir.xyz);\n";
-            codeGenerateData->fragment_stream << "vec3 lightRadiance = uLightRadiance.xyz;\n";
+            AddPreludeValue(codeGenerateData, "lightDir", "normalize(uLightDir.xyz)");
+            AddPreludeValue(codeGenerateData, "lightRadiance", "uLightRadiance.xyz");
 
         }
 
@@ -207,19 +137,19 @@ namespace csg {
 
             
             
-            codeGenerateData->vertex_stream << " GPU_WORLD_POSITION = mul(u_model[0] , vec4(a_position, 1.0)).xyz;\n";
-            codeGenerateData->vertex_stream << " VERTEX_CD_MTFACE = vec3(a_texcoord0,0.0);\n";
-            codeGenerateData->vertex_stream << " VERTEX_CD_ORCO = a_position;\n";
+            codeGenerateData->AddVertexStatement("GPU_WORLD_POSITION", "mul(u_model[0] , vec4(a_position, 1.0)).xyz");
+            codeGenerateData->AddVertexStatement("VERTEX_CD_MTFACE", "vec3(a_texcoord0,0.0)");
+            codeGenerateData->AddVertexStatement("VERTEX_CD_ORCO", "a_position");
 
-            codeGenerateData->vertex_stream << " gl_Position = mul(u_modelViewProj ,vec4(a_position, 1.0));\n";
+            codeGenerateData->AddVertexStatement("gl_Position", "mul(u_modelViewProj ,vec4(a_position, 1.0))");
 
 
-            codeGenerateData->fragment_stream << "vec3 viewDir = mul(u_view , vec4(GPU_WORLD_POSITION,1.0));\n";
-            codeGenerateData->fragment_stream << "vec4 colorRamp = texture(ramp_curve,VERTEX_CD_MTFACE);\n";
-            codeGenerateData->fragment_stream << "vec3 GPU_VIEW_POSITION = mul(u_view , vec4(GPU_WORLD_POSITION, 1.0)).xyz;\n";
-            codeGenerateData->fragment_stream << "vec2 GPU_BARYCENTRIC_TEXCO=vec2(0.0,0.0);\n";
-            codeGenerateData->fragment_stream << "vec3 GPU_BARYCENTRIC_DIST=vec3(0.0,0.0,0.0);\n";
-            codeGenerateData->fragment_stream << "vec4 GPU_CAMERA_TEXCO_FACTORS = vec4(1.0,1.0,0.0,0.0);\n";
+            AddPreludeValue(codeGenerateData, "viewDir", "mul(u_view , vec4(GPU_WORLD_POSITION,1.0))");
+            AddPreludeValue(codeGenerateData, "colorRamp", "texture(ramp_curve,VERTEX_CD_MTFACE)");
+            AddPreludeValue(codeGenerateData, "GPU_VIEW_POSITION", "mul(u_view , vec4(GPU_WORLD_POSITION, 1.0)).xyz");
+            AddPreludeValue(codeGenerateData, "GPU_BARYCENTRIC_TEXCO", "vec2(0.0,0.0)");
+            AddPreludeValue(codeGenerateData, "GPU_BARYCENTRIC_DIST", "vec3(0.0,0.0,0.0)");
+            AddPreludeValue(codeGenerateData, "GPU_CAMERA_TEXCO_FACTORS", "vec4(1.0,1.0,0.0,0.0)");
             
         }
 
@@ -230,11 +160,16 @@ namespace csg {
             codeGenerateData->AddUniformParams(UniformCodeData{ ShaderDataType::varying,"GPU_WORLD_NORMAL",csc::UniformType::Vec3         });//世界空间法线,TODO也许有问题，发现插值导致在顶点着色数据不对
             codeGenerateData->AddUniformParams(UniformCodeData{ ShaderDataType::varying,"VERTEX_CD_TANGENT",csc::UniformType::Vec4 });//顶点切线
 
-            codeGenerateData->vertex_stream << " GPU_WORLD_NORMAL = mul(transpose((u_model[1])) , vec4(a_normal, 0.0)).xyz;\n";
-            codeGenerateData->vertex_stream << " VERTEX_CD_TANGENT = a_tangent;\n";
+            codeGenerateData->AddVertexStatement("GPU_WORLD_NORMAL", "mul(transpose((u_model[1])) , vec4(a_normal, 0.0)).xyz");
+            codeGenerateData->AddVertexStatement("VERTEX_CD_TANGENT", "a_tangent");
         }
 
 
+        //curve ranges and control points are baked into the shader as constants
+        static void AddCurveValue(std::shared_ptr<csg::CodeGenerateData> codeGenerateData, const SlotId& slotId, const std::string& name, ir::Type type, const std::string& value) {
+            codeGenerateData->fragment.declare(slotId.node_id(), ir::Value::temp(type, name), ir::Value::literal(type, value));
+        }
+
         static std::string code_slot_value(std::shared_ptr<csg::CodeGenerateData> codeGenerateData,
                                            SlotId& slotId,
                                            const csg::SlotValue& slot_value,
@@ -243,8 +178,8 @@ namespace csg {
         {
             switch (slot_value.type()) {
             case csg::SlotType::BOOL:
-                if (slot_value.as<csg::BoolSlotValue>().has_value()) {
-                    const csg::BoolSlotValue bool_slot_value{ slot_value.as<csg::BoolSlotValue>().value() };
+                if (const csg::BoolSlotValue* const value_ptr = slot_value.as_ptr<csg::BoolSlotValue>()) {
+                    const csg::BoolSlotValue& bool_slot_value{ *value_ptr };
                     if (bool_slot_value.get()) {
                         outFloat4Value.x = 1;
                         return "1";
@@ -256,27 +191,27 @@ namespace csg {
                 }
                 break;
             case csg::SlotType::COLOR:
-                if (slot_value.as<csg::ColorSlotValue>().has_value()) {
-                    const csg::ColorSlotValue color_slot_value{ slot_value.as<csg::ColorSlotValue>().value() };
+                if (const csg::ColorSlotValue* const value_ptr = slot_value.as_ptr<csg::ColorSlotValue>()) {
+                    const csg::ColorSlotValue& color_slot_value{ *value_ptr };
                     const csc::Float3 color{ color_slot_value.get() };
                     outFloat4Value.x = color.x;
                     outFloat4Value.y = color.y;
                     outFloat4Value.z = color.z;
                     std::stringstream sstream;
-                    sstream << std::fixed << std::setprecision(SERIALIZED_GRAPH_PRECISION) << type_shadername_str[static_cast<int>(slot_value.type())] << "(" << color.x << ',' << color.y << ',' << color.z<<",1.0f" << ")";
+                    sstream << std::fixed << std::setprecision(SERIALIZED_GRAPH_PRECISION) << ir::type_name(ir::slot_type(slot_value.type())) << "(" << color.x << ',' << color.y << ',' << color.z<<",1.0f" << ")";
                     return sstream.str();
                 }
                 break;
             case csg::SlotType::ENUM:
-                if (slot_value.as<csg::EnumSlotValue>().has_value()) {
-                    const csg::EnumSlotValue enum_slot_value{ slot_value.as<csg::EnumSlotValue>().value() };
+                if (const csg::EnumSlotValue* const value_ptr = slot_value.as_ptr<csg::EnumSlotValue>()) {
+                    const csg::EnumSlotValue& enum_slot_value{ *value_ptr };
                     outFloat4Value.x = enum_slot_value.get()*1.0;
                     return std::string{ enum_slot_value.internal_name() };
                 }
                 break;
             case csg::SlotType::FLOAT:
-                if (slot_value.as<csg::FloatSlotValue>().has_value()) {
-                    const csg::FloatSlotValue float_slot_value{ slot_value.as<csg::FloatSlotValue>().value() };
+                if (const csg::FloatSlotValue* const value_ptr = slot_value.as_ptr<csg::FloatSlotValue>()) {
+                    const csg::FloatSlotValue& float_slot_value{ *value_ptr };
                     outFloat4Value.x = float_slot_value.get();
                     std::stringstream sstream;
                     sstream << std::fixed << std::setprecision(SERIALIZED_GRAPH_PRECISION) << float_slot_value.get();
@@ -284,8 +219,8 @@ namespace csg {
                 }
                 break;
             case csg::SlotType::INT:
-                if (slot_value.as<csg::IntSlotValue>().has_value()) {
-                    const csg::IntSlotValue int_slot_value{ slot_value.as<csg::IntSlotValue>().value() };
+                if (const csg::IntSlotValue* const value_ptr = slot_value.as_ptr<csg::IntSlotValue>()) {
+                    const csg::IntSlotValue& int_slot_value{ *value_ptr };
                     outFloat4Value.x = int_slot_value.get();
                     std::stringstream sstream;
                     sstream << int_slot_value.get();
@@ -293,22 +228,22 @@ namespace csg {
                 }
                 break;
             case csg::SlotType::VECTOR:
-                if (slot_value.as<csg::VectorSlotValue>().has_value()) {
-                    const csg::VectorSlotValue vec_slot_value{ slot_value.as<csg::VectorSlotValue>().value() };
+                if (const csg::VectorSlotValue* const value_ptr = slot_value.as_ptr<csg::VectorSlotValue>()) {
+                    const csg::VectorSlotValue& vec_slot_value{ *value_ptr };
                     const csc::Float3 color{ vec_slot_value.get() };
                     outFloat4Value.x = color.x;
                     outFloat4Value.y = color.y;
                     outFloat4Value.z = color.z;
                     std::stringstream sstream;
-                    sstream << std::fixed << std::setprecision(SERIALIZED_GRAPH_PRECISION) << type_shadername_str[static_cast<int>(slot_value.type())] << "(" << color.x << ',' << color.y << ',' << color.z<<")";
+                    sstream << std::fixed << std::setprecision(SERIALIZED_GRAPH_PRECISION) << ir::type_name(ir::slot_type(slot_value.type())) << "(" << color.x << ',' << color.y << ',' << color.z<<")";
                     return sstream.str();
                 }
                 break;
 
             case csg::SlotType::CURVE_RGB:
-            	if (slot_value.as<csg::RGBCurveSlotValue>().has_value()) {
+            	if (const csg::RGBCurveSlotValue* const value_ptr = slot_value.as_ptr<csg::RGBCurveSlotValue>()) {
 //            		constexpr char CURVE_SEPARATOR{ '/' };
-            		const csg::RGBCurveSlotValue rgb_slot_value{ slot_value.as<csg::RGBCurveSlotValue>().value() };
+            		const csg::RGBCurveSlotValue& rgb_slot_value{ *value_ptr };
             		std::stringstream sstream;
                     
                     
@@ -318,24 +253,24 @@ namespace csg {
                     csc::Float4 ext_y;
                     csc::Float4 ext_z;
                     csc::Float4 ext_w;
-                    auto samplerY = codeGenerateData->current_layer;
-                    codeGenerateData->current_layer = SetRGBCurveSlotValue(codeGenerateData->shareState,&rgb_slot_value,codeGenerateData->current_layer,&range,&ext_x,&ext_y,&ext_z,&ext_w);
-                    codeGenerateData->shareState->setSlotLayer(slotId.slot_id(), samplerY);
+                    auto samplerY = SetRGBCurveSlotValue(codeGenerateData->shareState,&rgb_slot_value,slotId,&range,&ext_x,&ext_y,&ext_z,&ext_w);
+                    codeGenerateData->current_layer++;
+                    outFloat4Value.x = float(samplerY);
                     //TODO 理论上应该设置为uuniform
-                    codeGenerateData->fragment_stream<<"vec4 "<<slotName<<"_range="<<val_glsl_str(range)<<";\n";
-                    codeGenerateData->fragment_stream<<"vec4 "<<slotName<<"_ext_x="<<val_glsl_str(ext_x)<<";\n";
-                    codeGenerateData->fragment_stream<<"vec4 "<<slotName<<"_ext_y="<<val_glsl_str(ext_y)<<";\n";
-                    codeGenerateData->fragment_stream<<"vec4 "<<slotName<<"_ext_z="<<val_glsl_str(ext_z)<<";\n";
-                    codeGenerateData->fragment_stream<<"vec4 "<<slotName<<"_ext_w="<<val_glsl_str(ext_w)<<";\n";
+                    AddCurveValue(codeGenerateData, slotId, slotName+"_range", ir::Type::Vec4, val_glsl_str(range));
+                    AddCurveValue(codeGenerateData, slotId, slotName+"_ext_x", ir::Type::Vec4, val_glsl_str(ext_x));
+                    AddCurveValue(codeGenerateData, slotId, slotName+"_ext_y", ir::Type::Vec4, val_glsl_str(ext_y));
+                    AddCurveValue(codeGenerateData, slotId, slotName+"_ext_z", ir::Type::Vec4, val_glsl_str(ext_z));
+                    AddCurveValue(codeGenerateData, slotId, slotName+"_ext_w", ir::Type::Vec4, val_glsl_str(ext_w));
                     sstream << samplerY;
                     
                     return sstream.str();
             	}
             	break;
             case csg::SlotType::CURVE_VECTOR:
-            	if (slot_value.as<csg::VectorCurveSlotValue>().has_value()) {
+            	if (const csg::VectorCurveSlotValue* const value_ptr = slot_value.as_ptr<csg::VectorCurveSlotValue>()) {
             	//	constexpr char CURVE_SEPARATOR{ '/' };
-            		const csg::VectorCurveSlotValue curve_slot_value{ slot_value.as<csg::VectorCurveSlotValue>().value() };
+            		const csg::VectorCurveSlotValue& curve_slot_value{ *value_ptr };
             		std::stringstream sstream;
                     
                     auto slotName = codeGenerateData->graph->GetSlotName(slotId);
@@ -343,24 +278,24 @@ namespace csg {
                     csc::Float4 ext_x;
                     csc::Float4 ext_y;
                     csc::Float4 ext_z;
-                    auto samplerY = codeGenerateData->current_layer;
-                    codeGenerateData->current_layer = SetVectorCurveSlotValue(codeGenerateData->shareState,&curve_slot_value,codeGenerateData->current_layer,&range,&ext_x,&ext_y,&ext_z);
-                    codeGenerateData->shareState->setSlotLayer(slotId.slot_id(), samplerY);
-                    codeGenerateData->fragment_stream<<"vec3 "<<slotName<<"_range="<<val_glsl_str(range)<<";\n";
-                    codeGenerateData->fragment_stream<<"vec4 "<<slotName<<"_ext_x="<<val_glsl_str(ext_x)<<";\n";
-                    codeGenerateData->fragment_stream<<"vec4 "<<slotName<<"_ext_y="<<val_glsl_str(ext_y)<<";\n";
-                    codeGenerateData->fragment_stream<<"vec4 "<<slotName<<"_ext_z="<<val_glsl_str(ext_z)<<";\n";
+                    auto samplerY = SetVectorCurveSlotValue(codeGenerateData->shareState,&curve_slot_value,slotId,&range,&ext_x,&ext_y,&ext_z);
+                    codeGenerateData->current_layer++;
+                    outFloat4Value.x = float(samplerY);
+                    AddCurveValue(codeGenerateData, slotId, slotName+"_range", ir::Type::Vec3, val_glsl_str(range));
+                    AddCurveValue(codeGenerateData, slotId, slotName+"_ext_x", ir::Type::Vec4, val_glsl_str(ext_x));
+                    AddCurveValue(codeGenerateData, slotId, slotName+"_ext_y", ir::Type::Vec4, val_glsl_str(ext_y));
+                    AddCurveValue(codeGenerateData, slotId, slotName+"_ext_z", ir::Type::Vec4, val_glsl_str(ext_z));
                     sstream << samplerY;
                     return sstream.str();
             	}
             	break;
             case csg::SlotType::COLOR_RAMP:
-                if (slot_value.as<csg::ColorRampSlotValue>().has_value()) {
-                    csg::ColorRampSlotValue ramp_slot_value{ slot_value.as<csg::ColorRampSlotValue>().value() };
+                if (const csg::ColorRampSlotValue* const value_ptr = slot_value.as_ptr<csg::ColorRampSlotValue>()) {
+                    const csg::ColorRampSlotValue& ramp_slot_value{ *value_ptr };
                     
-                    auto samplerY = codeGenerateData->current_layer;
-                    codeGenerateData->current_layer = SetColorRampSlotValue(codeGenerateData->shareState,&ramp_slot_value,codeGenerateData->current_layer);
-                    codeGenerateData->shareState->setSlotLayer(slotId.slot_id(), samplerY);
+                    auto samplerY = SetColorRampSlotValue(codeGenerateData->shareState,&ramp_slot_value,slotId);
+                    codeGenerateData->current_layer++;
+                    outFloat4Value.x = float(samplerY);
                     
                     std::stringstream sstream;
                     sstream << samplerY;
@@ -369,8 +304,8 @@ namespace csg {
                 break;
                     
             case csg::SlotType::IMAGE:
-                if (slot_value.as<csg::ImageSlotValue>().has_value()) {
-                   const csg::ImageSlotValue int_slot_value{ slot_value.as<csg::ImageSlotValue>().value() };
+                if (const csg::ImageSlotValue* const value_ptr = slot_value.as_ptr<csg::ImageSlotValue>()) {
+                   const csg::ImageSlotValue& int_slot_value{ *value_ptr };
                    outSamplerFilePath = int_slot_value.get();
                    std::stringstream sstream;
                    sstream << int_slot_value.get();
@@ -385,42 +320,80 @@ namespace csg {
             return "ERROR";
         }
 
-        static const char* GetSlotDataType(std::shared_ptr<Graph> graph,  SlotId& slot) {
+        static ir::Type GetSlotValueType(std::shared_ptr<Graph> graph,  SlotId& slot) {
             const auto dest_node{ graph->get(slot.node_id()) };
-            const auto opt_slot{ dest_node->slot(slot.index()) };
-            return type_shadername_str[static_cast<int>(opt_slot->type())];
+            const Slot* const opt_slot{ dest_node->slot_ptr(slot.index()) };
+            return ir::slot_type(opt_slot->type());
         }
 
         static csc::UniformType::Enum GetSlotUniformType(std::shared_ptr<Graph> graph,  SlotId& slot) {
             const auto dest_node{ graph->get(slot.node_id()) };
-            const auto opt_slot{ dest_node->slot(slot.index()) };
+            const Slot* const opt_slot{ dest_node->slot_ptr(slot.index()) };
             return type_shadername_uniformType[static_cast<int>(opt_slot->type())];
         }
 
         static const char* GetSlotDataTypeDefaultValue(std::shared_ptr<Graph> graph,  SlotId& slot) {
             const auto dest_node{ graph->get(slot.node_id()) };
-            const auto opt_slot{ dest_node->slot(slot.index()) };
+            const Slot* const opt_slot{ dest_node->slot_ptr(slot.index()) };
             return type_default_val_str[static_cast<int>(opt_slot->type())];
         }
 
-        static std::string ResolveSlot(std::shared_ptr<csg::CodeGenerateData> codeGenerateData,SlotId& slotId,bool* connected) {
+        //折叠后的值写成uniform的默认值,用科学计数法保证总有小数点
+        static std::string folded_glsl_str(const csc::Float4& value, const ir::Type type)
+        {
+            std::stringstream sstream;
+            sstream << std::scientific << std::setprecision(8);
+            switch (type) {
+            case ir::Type::Vec3:
+                sstream << "vec3(" << value.x << ',' << value.y << ',' << value.z << ")";
+                break;
+            case ir::Type::Vec4:
+                sstream << "vec4(" << value.x << ',' << value.y << ',' << value.z << ',' << value.w << ")";
+                break;
+            default:
+                sstream << value.x;
+                break;
+            }
+            return sstream.str();
+        }
+
+        //上游节点已折叠:整条常量链只剩这一个uniform,编辑时按上游输出槽找下标,改值时直接更新
+        static ir::Value AddFoldedValue(std::shared_ptr<csg::CodeGenerateData> codeGenerateData, const SlotId& sourceSlotId, SlotType sourceType, const csc::Float4& value) {
+            auto graph = codeGenerateData->graph;
+            const ir::Type type{ ir::slot_type(sourceType) };
+            const std::string valueStr{ folded_glsl_str(value, type) };
+            const std::string outName = graph->GetSlotName(sourceSlotId);
+            UniformCodeData uniformData = ConvertToUniformData(outName, valueStr);
+            uniformData.dataType = ShaderDataType::uniformFrag;
+            uniformData.uniformType = type_shadername_uniformType[static_cast<int>(sourceType)];
+            uniformData.defaultValue = value;
+            uniformData.editable = true;
+            uniformData.slotNode = sourceSlotId.node_id();
+            uniformData.slotIndex = static_cast<uint32_t>(sourceSlotId.index());
+            uniformData.textFilePath[0] = 0;
+            codeGenerateData->AddUniformParams(uniformData);
+            return ir::Value::uniform(type, outName);
+        }
+
+        static ir::Operand ResolveSlot(std::shared_ptr<csg::CodeGenerateData> codeGenerateData,SlotId& slotId,bool* connected) {
             auto graph=codeGenerateData->graph;
-            auto connect = graph->get_connection(slotId);
+            const Connection* connect = graph->find_connection(slotId);
             auto node = graph->get(slotId.node_id());
-            auto slot = node->slot(slotId.index());
+            const Slot* const slot = node->slot_ptr(slotId.index());
             
-            *connected = connect.has_value();
-            if (connect.has_value()) {
+            *connected = connect != nullptr;
+            if (connect != nullptr) {
                 auto source_slot_id = connect->source();
                 const auto source_node{ graph->get(source_slot_id.node_id()) };
                 if(source_node != nullptr){
                     auto source_connect_slot_name = ResolveNode(codeGenerateData, source_node, (int)connect->source().index());
-                    auto source_slot = source_node->slot(source_slot_id.index());
-                    if(source_slot->type() == slot->type()){
-                        return source_connect_slot_name;
-                    }else{
-                        return convert_type_shader_name(source_slot->type(),slot->type(),source_connect_slot_name);
+                    const Slot* const source_slot = source_node->slot_ptr(source_slot_id.index());
+                    if (const FoldedSlots* const folded = codeGenerateData->folder.evaluate(source_node->id())) {
+                        const ir::Value folded_value{ AddFoldedValue(codeGenerateData, source_slot_id, source_slot->type(), (*folded)[source_slot_id.index()]) };
+                        return ir::convert_operand(folded_value, source_slot->type(), slot->type());
                     }
+                    const ir::Value source_value{ ir::Value::temp(ir::slot_type(source_slot->type()), source_connect_slot_name) };
+                    return ir::convert_operand(source_value, source_slot->type(), slot->type());
                 }else{
                     printf("not has source node by connect");
                 }
@@ -431,18 +404,18 @@ namespace csg {
             //2.使用内部申明的vvarying值
             auto gpuName = slot->getGPUVaryName();
             if(gpuName != nullptr){
-                return gpuName;
+                return ir::Value::builtin(gpuName);
             }else{
-                auto slotValue0 = graph->get_slot_value(slotId);
+                const SlotValue* const slotValue0 = node->slot_value_ptr(slotId.index());
                 std::string outValueStr;
                 Float4 outValue;
                 
                 std::string samplerTexFilePath;
 
-                if (slotValue0.has_value()) {
+                if (slotValue0 != nullptr) {
                     outValueStr = code_slot_value(codeGenerateData,
                                                       slotId,
-                                                      slotValue0.value(),
+                                                      *slotValue0,
                                                       outValue,
                                                       samplerTexFilePath);
                 }
@@ -453,8 +426,9 @@ namespace csg {
                
                 if(slot->type() == SlotType::CLOSURE)
                 {
-                    auto outTypeStr = GetSlotDataType(graph, slotId);
-                    codeGenerateData->fragment_stream<<outTypeStr<<" "<<outName<<"="<<outValueStr<<";\n";
+                    const ir::Value closure{ ir::Value::temp(ir::Type::Closure, outName) };
+                    codeGenerateData->fragment.declare(node->id(), closure, ir::Value::literal(ir::Type::Closure, outValueStr));
+                    return closure;
                 }
                 else
                 {
@@ -463,13 +437,15 @@ namespace csg {
                     uniformData.dataType = ShaderDataType::uniformFrag;
                     uniformData.uniformType = uniformType;
                     uniformData.defaultValue = outValue;
-                    uniformData.uniformId = slotId.slot_id();
+                    uniformData.editable = true;
+                    uniformData.slotNode = slotId.node_id();
+                    uniformData.slotIndex = static_cast<uint32_t>(slotId.index());
                     strcpy(uniformData.textFilePath, samplerTexFilePath.c_str());
                     
                     codeGenerateData->AddUniformParams(uniformData);
                 }
                 
-                return outName;
+                return ir::Value::uniform(ir::slot_type(slot->type()), outName);
             }
         }
 
@@ -479,309 +455,60 @@ namespace csg {
                                 const char* fun_name,
                                 std::vector<std::string>& p_outVals,
                                 int funNameMask = 0,
-                                std::vector<std::string>* ext_inputVals = nullptr) {
+                                std::vector<ir::Value>* ext_inputVals = nullptr) {
             auto graph=codeGenerateData->graph;
             auto slotCount = node->slots().size();
-            auto funParamsCount = slotCount;
 
             bool connected;
 
-            std::vector<std::string> p_inputVals;
-
-            std::vector<const char *> inputVals;
-            std::vector<const char *> outParam;
+            std::vector<ir::Operand> inputVals;
+            std::vector<ir::Value> outParam;
             
             std::stringstream newFunPreName;
+            bool hasFunPreName = false;
             for (size_t i = 0; i < slotCount; i++)
             {
                 SlotId slotIdi = SlotId(node->id(), i);
 
                 //this is fun name
                 if ((funNameMask & (2<<i)) > 0 ) {
-                    auto slotValue0 = graph->get_slot_value(slotIdi);
+                    const SlotValue* const slotValue0 = node->slot_value_ptr(i);
+                    assert(slotValue0 != nullptr);
                     Float4 value;
                     std::string samplerTexFilePath;
-                    std::string funMaskPrefix = code_slot_value(codeGenerateData, slotIdi, slotValue0.value(),value,samplerTexFilePath);
-                    if(funParamsCount != slotCount){
+                    std::string funMaskPrefix = code_slot_value(codeGenerateData, slotIdi, *slotValue0,value,samplerTexFilePath);
+                    if(hasFunPreName){
                         newFunPreName <<"_"<< funMaskPrefix;
                     }else{
                         newFunPreName << funMaskPrefix;
                     }
-                    funParamsCount--;
+                    hasFunPreName = true;
                     continue;
                 }
 
                 //this is out param
                 if (node->slot_dir(i) == SlotDirection::OUTPUT) {
-                    std::string outType = GetSlotDataType(graph, slotIdi);
                     std::string outValue = graph->GetSlotName(slotIdi);
-                    codeGenerateData->fragment_stream << " " << outType << " " << outValue <<";\n";
+                    outParam.push_back(ir::Value::temp(GetSlotValueType(graph, slotIdi), outValue));
                     p_outVals.push_back(outValue);
                 }
                 //this is in param
                 else {
-                    std::string inputValue = ResolveSlot(codeGenerateData, slotIdi, &connected);
-                    p_inputVals.push_back(inputValue);
+                    inputVals.push_back(ResolveSlot(codeGenerateData, slotIdi, &connected));
                 }
             }
             newFunPreName << fun_name;
-            std::string newFunName = newFunPreName.str();
-            
 
-            std::stringstream error;
-            for(int i=0;i<p_inputVals.size();i++){
-                inputVals.push_back(&p_inputVals[i][0]);
-            }
             if(ext_inputVals != nullptr){
-                for(int i=0;i<ext_inputVals->size();i++){
-                    inputVals.push_back(&ext_inputVals->at(i)[0]);
-                }
-                funParamsCount += ext_inputVals->size();
-            }
-
-            for(int j=0;j<p_outVals.size();j++){
-                outParam.push_back(&p_outVals[j][0]);
-            }
-            
-            char buff[1024];
-            const char* new_fun_name_ptr = newFunName.c_str();
-            if (funParamsCount == 2) {
-                if (outParam.size() == 1) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], outParam[0]);
-                }
-                else {
-                    assert(false);
-                }
-            }
-            else if (funParamsCount == 3) {
-                if (outParam.size() == 1) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1],outParam[0]);
-                }
-                else if (outParam.size() == 2) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0],  outParam[0], outParam[1]);
-                }
-                else {
-                    assert(false);
-                }
-            }
-            else if (funParamsCount == 4) {
-                if (outParam.size() == 1) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], outParam[0]);
-                }
-                else if (outParam.size() == 2) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], outParam[0], outParam[1]);
-                }
-                else if (outParam.size() == 3) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0],  outParam[0], outParam[1], outParam[2]);
-                }
-                else {
-                    assert(false);
-                }
-            }
-            else if (funParamsCount == 5) {
-                if (outParam.size() == 1) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], outParam[0]);
-                }
-                else if (outParam.size() == 2) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], outParam[0], outParam[1]);
-                }
-                else if (outParam.size() == 3) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], outParam[0], outParam[1], outParam[2]);
-                }
-                else {
-                    assert(false);
-                }
-            }
-            else if (funParamsCount == 6) {
-                if (outParam.size() == 1) {
-
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], outParam[0]);
-                }
-                else if (outParam.size() == 2) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], outParam[0], outParam[1]);
-                }
-                else if (outParam.size() == 3) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], outParam[0], outParam[1], outParam[2]);
-                }
-                else {
-                    assert(false);
-                }
-            }
-            else if (funParamsCount == 7) {
-                if (outParam.size() == 1) {
-
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], outParam[0]);
-                }
-                else if (outParam.size() == 2) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], outParam[0], outParam[1]);
-                }
-                else if (outParam.size() == 3) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], outParam[0], outParam[1], outParam[2]);
-                }
-                else {
-                    assert(false);
-                }
-            }
-            else if (funParamsCount == 8) {
-                if (outParam.size() == 1) {
-
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], inputVals[6], outParam[0]);
-                }
-                else if (outParam.size() == 2) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], outParam[0], outParam[1]);
-                }
-                else if (outParam.size() == 3) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], outParam[0], outParam[1], outParam[2]);
-                }
-                else if (outParam.size() == 4) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3],  outParam[0], outParam[1], outParam[2],outParam[3]);
-                }
-                else if (outParam.size() == 5) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], outParam[0], outParam[1], outParam[2],outParam[3],outParam[4]);
-                }
-                else {
-                   assert(false);
-                }
-            }
-            else if (funParamsCount == 9) {
-                if (outParam.size() == 1) {
-
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], inputVals[6], inputVals[7], outParam[0]);
-                }
-                else if (outParam.size() == 2) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], inputVals[6], outParam[0], outParam[1]);
-                }
-                else if (outParam.size() == 3) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], outParam[0], outParam[1], outParam[2]);
-                }
-                else {
-                    assert(false);
-                }
-            }
-            else if (funParamsCount == 10) {
-                if (outParam.size() == 1) {
-
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], inputVals[6], inputVals[7], inputVals[8], outParam[0]);
-                }
-                else if (outParam.size() == 2) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], inputVals[6], inputVals[7], outParam[0], outParam[1]);
-                }
-                else if (outParam.size() == 3) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], inputVals[6], outParam[0], outParam[1], outParam[2]);
-                }
-                else if (outParam.size() == 4) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], outParam[0], outParam[1], outParam[2],outParam[3]);
-                }
-                else {
-                   assert(false);
-                }
-            }
-            else if (funParamsCount == 11) {
-                if (outParam.size() == 1) {
-
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], inputVals[6], inputVals[7], inputVals[8], inputVals[9], outParam[0]);
-                }
-                else if (outParam.size() == 2) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], inputVals[6], inputVals[7], inputVals[8], outParam[0], outParam[1]);
-                }
-                else if (outParam.size() == 3) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], inputVals[6], inputVals[7], outParam[0], outParam[1], outParam[2]);
-                }
-                else if (outParam.size() == 4) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], inputVals[6], outParam[0], outParam[1], outParam[2],outParam[3]);
-                }
-                else {
-                    assert(false);
-                }
-            }
-            else if (funParamsCount == 12) {
-                if (outParam.size() == 1) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], inputVals[6], inputVals[7], inputVals[8], inputVals[9], inputVals[10], outParam[0]);
-                }
-                else if (outParam.size() == 2) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], inputVals[6], inputVals[7], inputVals[8], inputVals[9], outParam[0], outParam[1]);
-                }
-                else if (outParam.size() == 3) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], inputVals[6], inputVals[7], inputVals[8], outParam[0], outParam[1], outParam[2]);
-                }
-                else if (outParam.size() == 4) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], inputVals[6], inputVals[7], outParam[0], outParam[1], outParam[2], outParam[3]);
-                }
-                else if (outParam.size() == 5) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], inputVals[6], outParam[0], outParam[1], outParam[2], outParam[3],outParam[4]);
-                }
-                else if (outParam.size() == 7) {
-                   snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4],  outParam[0], outParam[1], outParam[2], outParam[3],outParam[4],outParam[5],outParam[6]);
-               }
-                else {
-                    assert(false);
-                }
+                inputVals.insert(inputVals.end(), ext_inputVals->begin(), ext_inputVals->end());
             }
-            else if (funParamsCount == 13) {
-                if (outParam.size() == 7) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4],inputVals[5],outParam[0], outParam[1], outParam[2], outParam[3],outParam[4],outParam[5],outParam[6]);
-                }
-                 else {
-                     assert(false);
-                 }
-            }
-            else if (funParamsCount == 14) {
-                if (outParam.size() == 1) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], inputVals[6], inputVals[7], inputVals[8], inputVals[9], inputVals[10], inputVals[11], inputVals[12], outParam[0]);
-                }
-                else if (outParam.size() == 2) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], inputVals[6], inputVals[7], inputVals[8], inputVals[9],inputVals[10], inputVals[11],  outParam[0], outParam[1]);
-                }
-                else if (outParam.size() == 3) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], inputVals[6], inputVals[7], inputVals[8], inputVals[9],inputVals[10],outParam[0], outParam[1], outParam[2]);
-                }
-                else if (outParam.size() == 4) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], inputVals[6], inputVals[7], inputVals[8], inputVals[9],outParam[0], outParam[1], outParam[2], outParam[3]);
-                }
-                else if (outParam.size() == 5) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], inputVals[6], inputVals[7], inputVals[8],outParam[0], outParam[1], outParam[2], outParam[3],outParam[4]);
-                }
-                else if (outParam.size() == 9) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], outParam[0], outParam[1], outParam[2], outParam[3],outParam[4],outParam[5], outParam[6], outParam[7], outParam[8]);
-                }
-                else {
-                    assert(false);
-                }
-            }
-            else if (funParamsCount == 16) {
-                if (outParam.size() == 1) {
 
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], inputVals[6], inputVals[7], inputVals[8], inputVals[9], inputVals[10],inputVals[11],inputVals[12],inputVals[13],inputVals[14], outParam[0]);
-                }
-                else if (outParam.size() == 2) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], inputVals[6], inputVals[7], inputVals[8], inputVals[9],inputVals[10],inputVals[11],inputVals[12],inputVals[13], outParam[0], outParam[1]);
-                }
-                else if (outParam.size() == 3) {
-                    snprintf(buff, sizeof(buff), new_fun_name_ptr, inputVals[0], inputVals[1], inputVals[2], inputVals[3], inputVals[4], inputVals[5], inputVals[6], inputVals[7], inputVals[8],inputVals[10],inputVals[11],inputVals[12], outParam[0], outParam[1], outParam[2]);
-                }
-                else {
-                    assert(false);
-                }
-            }
-            else {
-                assert(false);
-            }
-            codeGenerateData->fragment_stream << " "<< buff << ";\n";
-            return;
+            codeGenerateData->fragment.call(node->id(), newFunPreName.str(), std::move(inputVals), std::move(outParam));
         }
 
-        static std::string ResolveNode(std::shared_ptr<csg::CodeGenerateData> codeGenerateData, const std::shared_ptr<const Node> node,int getOutIndex) {
+        //生成节点自身的代码,调用前所有连线的上游节点已经处理过
+        static std::string EmitNode(std::shared_ptr<csg::CodeGenerateData> codeGenerateData, const std::shared_ptr<const Node> node,int getOutIndex) {
             auto graph=codeGenerateData->graph;
-            
-            //已经处理过的节点
-            if(codeGenerateData->hasProcessedNode(node->id())){
-                SlotId slotIdIndex = SlotId(node->id(), getOutIndex);
-                std::string outValue = graph->GetSlotName(slotIdIndex);
-                return outValue;
-            }
-            
-            //标记处理该节点
-            codeGenerateData->processedNode(node->id());
 
             switch (node->type()) {
                 //////
@@ -791,8 +518,8 @@ namespace csg {
                 {
                     bool connected;
                     SlotId slotId0 = SlotId(node->id(), 0);
-                    std::string surface = ResolveSlot(codeGenerateData, slotId0,&connected);
-                    codeGenerateData->fragment_stream << " gl_FragColor = " << surface <<".radiance;" << "\n";
+                    ir::Operand surface = ResolveSlot(codeGenerateData, slotId0,&connected);
+                    codeGenerateData->fragment.output(node->id(), surface);
                     return "";
                 }
                 break;
@@ -802,42 +529,42 @@ namespace csg {
             case NodeType::BRIGHTNESS_CONTRAST:
                 {
                     std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData, node, "node_brightness_contrast(%s,%s,%s,%s)", outParam);
+                    ProcessNode(codeGenerateData, node, "node_brightness_contrast", outParam);
                     return outParam[0];
                 }
                 break;
             case NodeType::GAMMA:
             {
                 std::vector<std::string> outParam;
-                ProcessNode(codeGenerateData, node, "node_gamma(%s,%s,%s)",  outParam);
+                ProcessNode(codeGenerateData, node, "node_gamma",  outParam);
                 return outParam[0];
             }
                 break;
             case NodeType::HSV:
             {
                 std::vector<std::string> outParam;
-                ProcessNode(codeGenerateData, node, "node_hsv(%s,%s,%s,%s,%s,%s)",  outParam);
+                ProcessNode(codeGenerateData, node, "node_hsv",  outParam);
                 return outParam[getOutIndex];
             }
                 break;
             case NodeType::INVERT:
             {
                 std::vector<std::string> outParam;
-                ProcessNode(codeGenerateData, node, "node_invert(%s,%s,%s)",  outParam);
+                ProcessNode(codeGenerateData, node, "node_invert",  outParam);
                 return outParam[getOutIndex];
             }
                 break;
             case NodeType::LIGHT_FALLOFF:
             {
                 std::vector<std::string> outParam;
-                ProcessNode(codeGenerateData, node, "node_light_falloff(%s,%s,%s,%s,%s)",  outParam);
+                ProcessNode(codeGenerateData, node, "node_light_falloff",  outParam);
                 return outParam[getOutIndex];
             }
                 break;
             case NodeType::MIX_RGB:
             {
                 std::vector<std::string> outParam;
-                ProcessNode(codeGenerateData, node, "(%s,%s,%s,%s,%s)",  outParam,2<<1);
+                ProcessNode(codeGenerateData, node, "",  outParam,2<<1);
                 return outParam[getOutIndex];
             }
                 break;
@@ -848,14 +575,14 @@ namespace csg {
                 SlotId slotId0 = SlotId(node->id(), 1);
                 std::string outValue = graph->GetSlotName(slotId0);
                 
-                std::vector<std::string> extInput;
-                extInput.push_back(outValue+"_range");
-                extInput.push_back(outValue+"_ext_x");
-                extInput.push_back(outValue+"_ext_y");
-                extInput.push_back(outValue+"_ext_z");
-                extInput.push_back(outValue+"_ext_w");
+                std::vector<ir::Value> extInput;
+                extInput.push_back(ir::Value::temp(ir::Type::Vec4, outValue+"_range"));
+                extInput.push_back(ir::Value::temp(ir::Type::Vec4, outValue+"_ext_x"));
+                extInput.push_back(ir::Value::temp(ir::Type::Vec4, outValue+"_ext_y"));
+                extInput.push_back(ir::Value::temp(ir::Type::Vec4, outValue+"_ext_z"));
+                extInput.push_back(ir::Value::temp(ir::Type::Vec4, outValue+"_ext_w"));
                 
-            	ProcessNode(codeGenerateData, node, "curves_rgb(%s,%s,%s,%s,%s,%s,%s,%s,%s)", outParam,0,&extInput);
+            	ProcessNode(codeGenerateData, node, "curves_rgb", outParam,0,&extInput);
             	return outParam[getOutIndex];
             }
             	break;
@@ -865,14 +592,14 @@ namespace csg {
             case NodeType::BLACKBODY:
             {
                 std::vector<std::string> outParam;
-                ProcessNode(codeGenerateData,  node, "node_blackbody(%s,%s)",  outParam);
+                ProcessNode(codeGenerateData,  node, "node_blackbody",  outParam);
                 return outParam[getOutIndex];
             }
                 break;
             case NodeType::CLAMP:
             {
                 std::vector<std::string> outParam;
-                ProcessNode(codeGenerateData,  node, "(%s,%s,%s,%s)",  outParam,2<<1);
+                ProcessNode(codeGenerateData,  node, "",  outParam,2<<1);
                 return outParam[getOutIndex];
             }
                 break;
@@ -884,19 +611,17 @@ namespace csg {
                 SlotId slotId3 = SlotId(node->id(), 3);
 
                 bool connected;
-                std::string outType = GetSlotDataType(graph, slotId0);
                 std::string outValue = graph->GetSlotName(slotId0);
-                std::string outType1 = GetSlotDataType(graph, slotId1);
                 std::string outValue1 = graph->GetSlotName(slotId1);
                 
 
-                std::string TextureSamplerY = ResolveSlot(codeGenerateData, slotId2, &connected);
-                std::string fac = ResolveSlot(codeGenerateData,  slotId3, &connected);
+                ir::Operand TextureSamplerY = ResolveSlot(codeGenerateData, slotId2, &connected);
+                ir::Operand fac = ResolveSlot(codeGenerateData,  slotId3, &connected);
 
 
-                codeGenerateData->fragment_stream << " " << outType << " " << outValue <<";\n";
-                codeGenerateData->fragment_stream << " " << outType1 << " " << outValue1 <<";\n";
-                codeGenerateData->fragment_stream << "valtorgb("<<fac<<","<<"ramp_curve"<<","<<TextureSamplerY<<","<<outValue<<","<<outValue1<<");\n";
+                codeGenerateData->fragment.call(node->id(), "valtorgb",
+                                                { fac, ir::Value::builtin("ramp_curve"), TextureSamplerY },
+                                                { ir::Value::temp(GetSlotValueType(graph, slotId0), outValue), ir::Value::temp(GetSlotValueType(graph, slotId1), outValue1) });
                 if(getOutIndex == 0){
                     return outValue;
                 }else{
@@ -908,7 +633,7 @@ namespace csg {
             {
 
                 std::vector<std::string> outParam;
-                ProcessNode(codeGenerateData,  node, "node_combine_hsv(%s,%s,%s,%s)",  outParam);
+                ProcessNode(codeGenerateData,  node, "node_combine_hsv",  outParam);
                 return outParam[getOutIndex];
 
             }
@@ -916,63 +641,63 @@ namespace csg {
             case NodeType::COMBINE_RGB:
             {
                 std::vector<std::string> outParam;
-                ProcessNode(codeGenerateData,  node, "node_combine_rgb(%s,%s,%s,%s)",  outParam);
+                ProcessNode(codeGenerateData,  node, "node_combine_rgb",  outParam);
                 return outParam[getOutIndex];
             }
                 break;
             case NodeType::COMBINE_XYZ:
             {
                 std::vector<std::string> outParam;
-                ProcessNode(codeGenerateData,  node, "node_combine_xyz(%s,%s,%s,%s)",  outParam);
+                ProcessNode(codeGenerateData,  node, "node_combine_xyz",  outParam);
                 return outParam[getOutIndex];
             }
                 break;
             case NodeType::MAP_RANGE:
             {
                 std::vector<std::string> outParam;
-                ProcessNode(codeGenerateData,  node, "(%s,%s,%s,%s,%s,%s,%s)",  outParam,2<<1);
+                ProcessNode(codeGenerateData,  node, "",  outParam,2<<1);
                 return outParam[getOutIndex];
             }
                 break;
             case NodeType::MATH:
             {
                 std::vector<std::string> outParam;
-                ProcessNode(codeGenerateData,  node, "(%s,%s,%s,%s)",  outParam,2<<1);
+                ProcessNode(codeGenerateData,  node, "",  outParam,2<<1);
                 return outParam[getOutIndex];
             }
                 break;
             case NodeType::RGB_TO_BW:
             {
                 std::vector<std::string> outParam;
-                ProcessNode(codeGenerateData,  node, "node_rgbtobw(%s,%s)",  outParam);
+                ProcessNode(codeGenerateData,  node, "node_rgbtobw",  outParam);
                 return outParam[getOutIndex];
             }
                 break;
             case NodeType::SEPARATE_HSV:
                 {
                     std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData,  node, "node_separate_hsv(%s,%s,%s,%s)", outParam);
+                    ProcessNode(codeGenerateData,  node, "node_separate_hsv", outParam);
                     return outParam[getOutIndex];
                 }
             	break;
             case NodeType::SEPARATE_RGB:
                 {
                     std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData,  node, "node_separate_rgb(%s,%s,%s,%s)", outParam);
+                    ProcessNode(codeGenerateData,  node, "node_separate_rgb", outParam);
                     return outParam[getOutIndex];
                 }
             	break;
             case NodeType::SEPARATE_XYZ:
                 {
                     std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData,  node, "node_separate_xyz(%s,%s,%s,%s)", outParam);
+                    ProcessNode(codeGenerateData,  node, "node_separate_xyz", outParam);
                     return outParam[getOutIndex];
                 }
             	break;
             case NodeType::VECTOR_MATH:
                 {
                     std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData,  node, "(%s,%s,%s,%s,%s,%s)", outParam,2<<2);
+                    ProcessNode(codeGenerateData,  node, "", outParam,2<<2);
                     return outParam[getOutIndex];
                 }
             	break;
@@ -980,12 +705,12 @@ namespace csg {
                 {
                     SlotId slotId1 = SlotId(node->id(), 1);
                     
-                    std::vector<std::string> extInput;
-                    codeGenerateData->shareState->setSlotLayer(slotId1.slot_id(), codeGenerateData->current_layer);
-                    extInput.push_back(std::to_string(codeGenerateData->current_layer));
-                    codeGenerateData->current_layer = SetWaveLength(codeGenerateData->shareState,codeGenerateData->current_layer);
+                    std::vector<ir::Value> extInput;
+                    const int row = SetWaveLength(codeGenerateData->shareState,slotId1);
+                    codeGenerateData->current_layer++;
+                    extInput.push_back(ir::Value::literal(ir::Type::Float, std::to_string(float(row))));
                     std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData,  node, "node_wavelength(%s,%s,%s)",  outParam,0,&extInput);
+                    ProcessNode(codeGenerateData,  node, "node_wavelength",  outParam,0,&extInput);
                     return outParam[getOutIndex];
                 }
             	break;
@@ -1005,47 +730,47 @@ namespace csg {
             case NodeType::BEVEL:
                 {
                     std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData,  node, "node_bevel(%s,%s,%s,%s)", outParam,2<<2);
+                    ProcessNode(codeGenerateData,  node, "node_bevel", outParam,2<<2);
                     return outParam[getOutIndex];
                 }
             	break;
             case NodeType::CAMERA_DATA:
                 {
                     std::vector<std::string> outParam;
-                    std::vector<std::string> inputExtra;
-                    inputExtra.push_back("GPU_WORLD_POSITION");
-                    ProcessNode(codeGenerateData,  node, "node_camera(%s,%s,%s,%s)", outParam,0,&inputExtra);
+                    std::vector<ir::Value> inputExtra;
+                    inputExtra.push_back(ir::Value::builtin("GPU_WORLD_POSITION"));
+                    ProcessNode(codeGenerateData,  node, "node_camera", outParam,0,&inputExtra);
                     return outParam[getOutIndex];
                 }
             	break;
             case NodeType::FRESNEL:
                 {
                     std::vector<std::string> outParam;
-                    std::vector<std::string> inputExtra;
-                    inputExtra.push_back("GPU_VIEW_POSITION");
-                    ProcessNode(codeGenerateData,  node, "node_fresnel(%s,%s,%s,%s)", outParam,0,&inputExtra);
+                    std::vector<ir::Value> inputExtra;
+                    inputExtra.push_back(ir::Value::builtin("GPU_VIEW_POSITION"));
+                    ProcessNode(codeGenerateData,  node, "node_fresnel", outParam,0,&inputExtra);
                     return outParam[getOutIndex];
                 }
             	break;
             case NodeType::GEOMETRY:
                 {
                     std::vector<std::string> outParam;
-                    std::vector<std::string> inputExtra;
-                    inputExtra.push_back("GPU_VIEW_POSITION");
-                    inputExtra.push_back("GPU_WORLD_NORMAL");
-                    inputExtra.push_back("VERTEX_CD_ORCO");
-                    inputExtra.push_back("GPU_BARYCENTRIC_TEXCO");
-                    inputExtra.push_back("GPU_WORLD_POSITION");
-                    ProcessNode(codeGenerateData,  node, "node_geometry(%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s)", outParam,0,&inputExtra);
+                    std::vector<ir::Value> inputExtra;
+                    inputExtra.push_back(ir::Value::builtin("GPU_VIEW_POSITION"));
+                    inputExtra.push_back(ir::Value::builtin("GPU_WORLD_NORMAL"));
+                    inputExtra.push_back(ir::Value::builtin("VERTEX_CD_ORCO"));
+                    inputExtra.push_back(ir::Value::builtin("GPU_BARYCENTRIC_TEXCO"));
+                    inputExtra.push_back(ir::Value::builtin("GPU_WORLD_POSITION"));
+                    ProcessNode(codeGenerateData,  node, "node_geometry", outParam,0,&inputExtra);
                     return outParam[getOutIndex];
                 }
             	break;
             case NodeType::LAYER_WEIGHT:
                 {
                     std::vector<std::string> outParam;
-                    std::vector<std::string> inputExtra;
-                    inputExtra.push_back("GPU_VIEW_POSITION");
-                    ProcessNode(codeGenerateData,  node, "node_layer_weight(%s,%s,%s,%s,%s)", outParam,0,&inputExtra);
+                    std::vector<ir::Value> inputExtra;
+                    inputExtra.push_back(ir::Value::builtin("GPU_VIEW_POSITION"));
+                    ProcessNode(codeGenerateData,  node, "node_layer_weight", outParam,0,&inputExtra);
                     return outParam[getOutIndex];
                 }
             	break;
@@ -1067,60 +792,60 @@ namespace csg {
             case NodeType::OBJECT_INFO:
                 {
                     std::vector<std::string> outParam;
-                    std::vector<std::string> inputExtra;
-                    inputExtra.push_back("GPU_OBJECT_COLOR");
-                    inputExtra.push_back("GPU_OBJECT_INFO");
-                    inputExtra.push_back("GPU_OBJECT_MAT_INDEX");
-                    ProcessNode(codeGenerateData,  node, "node_object_info(%s,%s,%s,%s,%s,%s,%s,%s)", outParam,0,&inputExtra);
+                    std::vector<ir::Value> inputExtra;
+                    inputExtra.push_back(ir::Value::builtin("GPU_OBJECT_COLOR"));
+                    inputExtra.push_back(ir::Value::builtin("GPU_OBJECT_INFO"));
+                    inputExtra.push_back(ir::Value::builtin("GPU_OBJECT_MAT_INDEX"));
+                    ProcessNode(codeGenerateData,  node, "node_object_info", outParam,0,&inputExtra);
                     return outParam[getOutIndex];
                 }
             	break;
             case NodeType::RGB:
                 {
                     std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData,  node, "node_rgb(%s,%s)", outParam);
+                    ProcessNode(codeGenerateData,  node, "node_rgb", outParam);
                     return outParam[getOutIndex];
                                     }
                 break;
             case NodeType::TANGENT:
                 {
                     std::vector<std::string> outParam;
-                    std::vector<std::string> inputExtra;
-                    inputExtra.push_back("VERTEX_CD_TANGENT");
-                    inputExtra.push_back("VERTEX_CD_ORCO");
-                    inputExtra.push_back("GPU_WORLD_NORMAL");
-                    ProcessNode(codeGenerateData,  node, "node_tangent(%s,%s,%s,%s,%s,%s)", outParam,0,&inputExtra);
+                    std::vector<ir::Value> inputExtra;
+                    inputExtra.push_back(ir::Value::builtin("VERTEX_CD_TANGENT"));
+                    inputExtra.push_back(ir::Value::builtin("VERTEX_CD_ORCO"));
+                    inputExtra.push_back(ir::Value::builtin("GPU_WORLD_NORMAL"));
+                    ProcessNode(codeGenerateData,  node, "node_tangent", outParam,0,&inputExtra);
                     return outParam[getOutIndex];
                 }
             	break;
             case NodeType::TEXTURE_COORDINATE:
                 {
                     std::vector<std::string> outParam;
-                    std::vector<std::string> inputExtra;
-                    inputExtra.push_back("GPU_VIEW_POSITION");
-                    inputExtra.push_back("GPU_WORLD_NORMAL");
-                    inputExtra.push_back("GPU_CAMERA_TEXCO_FACTORS");
-                    inputExtra.push_back("VERTEX_CD_ORCO");
-                    inputExtra.push_back("VERTEX_CD_MTFACE");
-                    inputExtra.push_back("GPU_WORLD_POSITION");
-                    ProcessNode(codeGenerateData,  node, "node_tex_coord(%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s)", outParam,0,&inputExtra);
+                    std::vector<ir::Value> inputExtra;
+                    inputExtra.push_back(ir::Value::builtin("GPU_VIEW_POSITION"));
+                    inputExtra.push_back(ir::Value::builtin("GPU_WORLD_NORMAL"));
+                    inputExtra.push_back(ir::Value::builtin("GPU_CAMERA_TEXCO_FACTORS"));
+                    inputExtra.push_back(ir::Value::builtin("VERTEX_CD_ORCO"));
+                    inputExtra.push_back(ir::Value::builtin("VERTEX_CD_MTFACE"));
+                    inputExtra.push_back(ir::Value::builtin("GPU_WORLD_POSITION"));
+                    ProcessNode(codeGenerateData,  node, "node_tex_coord", outParam,0,&inputExtra);
                     return outParam[getOutIndex];
                 }
             	break;
             case NodeType::VALUE:
                 {
                     std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData,  node, "node_value(%s,%s)", outParam);
+                    ProcessNode(codeGenerateData,  node, "node_value", outParam);
                     return outParam[getOutIndex];
                 }
                 break;
             case NodeType::WIREFRAME:
                 {
                     std::vector<std::string> outParam;
-                    std::vector<std::string> inputExtra;
-                    inputExtra.push_back("GPU_BARYCENTRIC_TEXCO");
-                    inputExtra.push_back("GPU_BARYCENTRIC_DIST");
-                    ProcessNode(codeGenerateData,  node, "node_node_wireframe(%s,%s,%s,%s,%s)", outParam,0,&inputExtra);
+                    std::vector<ir::Value> inputExtra;
+                    inputExtra.push_back(ir::Value::builtin("GPU_BARYCENTRIC_TEXCO"));
+                    inputExtra.push_back(ir::Value::builtin("GPU_BARYCENTRIC_DIST"));
+                    ProcessNode(codeGenerateData,  node, "node_node_wireframe", outParam,0,&inputExtra);
                     return outParam[getOutIndex];
                 }
             	break;
@@ -1130,7 +855,7 @@ namespace csg {
             case NodeType::ADD_SHADER:
                 {
                     std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData,  node, "node_add_shader(%s,%s,%s)", outParam);
+                    ProcessNode(codeGenerateData,  node, "node_add_shader", outParam);
                     return outParam[getOutIndex];
                 }
             	break;
@@ -1147,16 +872,16 @@ namespace csg {
             case NodeType::DIFFUSE_BSDF:
                 {
                     std::vector<std::string> outParam;
-                    std::vector<std::string> extInput;
-                    extInput.push_back("GPU_WORLD_POSITION");
-                    ProcessNode(codeGenerateData,  node, "node_bsdf_orenNayar(%s,%s,%s,%s,%s)", outParam,0,&extInput);
+                    std::vector<ir::Value> extInput;
+                    extInput.push_back(ir::Value::builtin("GPU_WORLD_POSITION"));
+                    ProcessNode(codeGenerateData,  node, "node_bsdf_orenNayar", outParam,0,&extInput);
                     return outParam[getOutIndex];
                 }
                 break;
             case NodeType::EMISSION:
             {
                 std::vector<std::string> outParam;
-                ProcessNode(codeGenerateData,  node, "node_bsdf_emission(%s,%s,%s)", outParam);
+                ProcessNode(codeGenerateData,  node, "node_bsdf_emission", outParam);
                 return outParam[getOutIndex];
             }
                 break;
@@ -1178,9 +903,9 @@ namespace csg {
             case NodeType::PBR:
                 {
                     std::vector<std::string> outParam;
-                    std::vector<std::string> extInput;
-                    extInput.push_back("GPU_WORLD_POSITION");
-                    ProcessNode(codeGenerateData,  node, "node_bsdf_pbr(%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s)", outParam,0,&extInput);
+                    std::vector<ir::Value> extInput;
+                    extInput.push_back(ir::Value::builtin("GPU_WORLD_POSITION"));
+                    ProcessNode(codeGenerateData,  node, "node_bsdf_pbr", outParam,0,&extInput);
                     return outParam[getOutIndex];
                 }
                 break;
@@ -1199,7 +924,7 @@ namespace csg {
             case NodeType::MIX_SHADER:
                 {
                     std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData,  node, "node_mix_shader(%s,%s,%s,%s)", outParam);
+                    ProcessNode(codeGenerateData,  node, "node_mix_shader", outParam);
                     return outParam[getOutIndex];
                 }
             	break;
@@ -1327,70 +1052,70 @@ namespace csg {
             case NodeType::BRICK_TEX:
                 {
                     std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData,  node, "node_tex_brick(%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s)", outParam);
+                    ProcessNode(codeGenerateData,  node, "node_tex_brick", outParam);
                     return outParam[getOutIndex];
                 }
             	break;
             case NodeType::CHECKER_TEX:
                 {
                     std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData,  node, "node_tex_checker(%s,%s,%s,%s,%s,%s)", outParam);
+                    ProcessNode(codeGenerateData,  node, "node_tex_checker", outParam);
                     return outParam[getOutIndex];
                 }
             	break;
             case NodeType::GRADIENT_TEX:
                 {
                     std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData,  node, "(%s,%s,%s)", outParam,2<<2);
+                    ProcessNode(codeGenerateData,  node, "", outParam,2<<2);
                     return outParam[getOutIndex];
                 }
             	break;
             case NodeType::IMAGE_TEX:
                 {
                     std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData,  node, "(%s,%s,%s,%s,%s)", outParam,2<<2);
+                    ProcessNode(codeGenerateData,  node, "", outParam,2<<2);
                     return outParam[getOutIndex];
                 }
                 break;
             case NodeType::MAGIC_TEX:
                 {
                    std::vector<std::string> outParam;
-                   ProcessNode(codeGenerateData,  node, "node_tex_magic(%s,%s,%s,%s,%s,%s)", outParam);
+                   ProcessNode(codeGenerateData,  node, "node_tex_magic", outParam);
                    return outParam[getOutIndex];
                 }
             	break;
             case NodeType::MUSGRAVE_TEX:
                 {
                     std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData,  node, "(%s,%s,%s,%s,%s,%s,%s,%s,%s)", outParam,2<<1|2<<2);
+                    ProcessNode(codeGenerateData,  node, "", outParam,2<<1|2<<2);
                     return outParam[getOutIndex];
                 }
             	break;
             case NodeType::NOISE_TEX:
                 {
                     std::vector<std::string> outParam;
-                   ProcessNode(codeGenerateData,  node, "(%s,%s,%s,%s,%s,%s,%s,%s)", outParam,2<<2);
+                   ProcessNode(codeGenerateData,  node, "", outParam,2<<2);
                    return outParam[getOutIndex];
                 }
             	break;
             case NodeType::VORONOI_TEX:
                 {
                     std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData,  node, "_node_tex_voronoi(%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s)", outParam,2<<5|2<<6);
+                    ProcessNode(codeGenerateData,  node, "_node_tex_voronoi", outParam,2<<5|2<<6);
                     return outParam[getOutIndex];
                 }
             	break;
             case NodeType::WAVE_TEX:
                 {
                     std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData,  node, "node_tex_wave(%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s)", outParam);
+                    ProcessNode(codeGenerateData,  node, "node_tex_wave", outParam);
                     return outParam[getOutIndex];
                 }
             	break;
             case NodeType::WHITE_NOISE_TEX:
                 {
                    std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData,  node, "(%s,%s,%s,%s)", outParam,2<<2);
+                    ProcessNode(codeGenerateData,  node, "", outParam,2<<2);
                     return outParam[getOutIndex];
                 }
             	break;
@@ -1400,16 +1125,16 @@ namespace csg {
             case NodeType::BUMP:
                 {
                     std::vector<std::string> outParam;
-                    std::vector<std::string> extInput;
-                    extInput.push_back("GPU_VIEW_POSITION");
-                    ProcessNode(codeGenerateData,  node, "node_bump(%s,%s,%s,%s,%s,%s,%s)", outParam,0,&extInput);
+                    std::vector<ir::Value> extInput;
+                    extInput.push_back(ir::Value::builtin("GPU_VIEW_POSITION"));
+                    ProcessNode(codeGenerateData,  node, "node_bump", outParam,0,&extInput);
                     return outParam[getOutIndex];
                 }
             	break;
             case NodeType::DISPLACEMENT:
                 {
                     std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData,  node, "(%s,%s,%s,%s,%s)", outParam,2<<1);
+                    ProcessNode(codeGenerateData,  node, "", outParam,2<<1);
                     return outParam[getOutIndex];
                 }
             	break;
@@ -1431,7 +1156,7 @@ namespace csg {
             //	_slot_aliases.push_back(std::make_pair("type", "mapping_type"));
                 {
                     std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData,  node, "(%s,%s,%s,%s,%s)", outParam,2<<1);
+                    ProcessNode(codeGenerateData,  node, "", outParam,2<<1);
                     return outParam[getOutIndex];
                 }
             	break;
@@ -1446,7 +1171,7 @@ namespace csg {
             //	} });
                 {
                     std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData,  node, "node_normal(%s,%s,%s,%s)", outParam);
+                    ProcessNode(codeGenerateData,  node, "node_normal", outParam);
                     return outParam[getOutIndex];
                 }
             	break;
@@ -1457,11 +1182,11 @@ namespace csg {
             //	_slots.push_back(Slot{ "Color",    "color",    ColorSlotValue{ csc::Float3{ 0.5f, 0.5f, 1.0f} } });
                 {
                     std::vector<std::string> outParam;
-                    std::vector<std::string> inputExtra;
-                    inputExtra.push_back("GPU_OBJECT_INFO");
-                    inputExtra.push_back("VERTEX_CD_TANGENT");
-                    inputExtra.push_back("GPU_WORLD_NORMAL");
-                    ProcessNode(codeGenerateData,  node, "(%s,%s,%s,%s,%s,%s)", outParam,2<<1,&inputExtra);
+                    std::vector<ir::Value> inputExtra;
+                    inputExtra.push_back(ir::Value::builtin("GPU_OBJECT_INFO"));
+                    inputExtra.push_back(ir::Value::builtin("VERTEX_CD_TANGENT"));
+                    inputExtra.push_back(ir::Value::builtin("GPU_WORLD_NORMAL"));
+                    ProcessNode(codeGenerateData,  node, "", outParam,2<<1,&inputExtra);
                     return outParam[getOutIndex];
                 }
             	break;
@@ -1476,13 +1201,13 @@ namespace csg {
                     SlotId slotId0 = SlotId(node->id(), 1);
                     std::string outValue = graph->GetSlotName(slotId0);
                     
-                    std::vector<std::string> extInput;
-                    extInput.push_back(outValue+"_range");
-                    extInput.push_back(outValue+"_ext_x");
-                    extInput.push_back(outValue+"_ext_y");
-                    extInput.push_back(outValue+"_ext_z");
+                    std::vector<ir::Value> extInput;
+                    extInput.push_back(ir::Value::temp(ir::Type::Vec4, outValue+"_range"));
+                    extInput.push_back(ir::Value::temp(ir::Type::Vec4, outValue+"_ext_x"));
+                    extInput.push_back(ir::Value::temp(ir::Type::Vec4, outValue+"_ext_y"));
+                    extInput.push_back(ir::Value::temp(ir::Type::Vec4, outValue+"_ext_z"));
                     std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData,  node, "node_curves_vec(%s,%s,%s,%s,%s,%s,%s,%s)",outParam,0,&extInput);
+                    ProcessNode(codeGenerateData,  node, "node_curves_vec",outParam,0,&extInput);
                     return outParam[getOutIndex];
                 }
             	break;
@@ -1494,17 +1219,17 @@ namespace csg {
             //	_slots.push_back(Slot{ "Scale",        "scale",        FloatSlotValue{ 1.0f, 0.0f, FLT_MAX } });
                 {
                     std::vector<std::string> outParam;
-                    std::vector<std::string> inputExtra;
-                    inputExtra.push_back("VERTEX_CD_TANGENT");
-                    inputExtra.push_back("GPU_WORLD_NORMAL");
-                    ProcessNode(codeGenerateData,  node, "(%s,%s,%s,%s,%s,%s)", outParam,2<<1,&inputExtra);
+                    std::vector<ir::Value> inputExtra;
+                    inputExtra.push_back(ir::Value::builtin("VERTEX_CD_TANGENT"));
+                    inputExtra.push_back(ir::Value::builtin("GPU_WORLD_NORMAL"));
+                    ProcessNode(codeGenerateData,  node, "", outParam,2<<1,&inputExtra);
                     return outParam[getOutIndex];
                 }
             	break;
             case NodeType::VECTOR_TRANSFORM:
                 {
                     std::vector<std::string> outParam;
-                    ProcessNode(codeGenerateData,  node, "(%s,%s)", outParam,2<<1|2<<2|2<<3);
+                    ProcessNode(codeGenerateData,  node, "", outParam,2<<1|2<<2|2<<3);
                     return outParam[getOutIndex];
                 }
             	break;
@@ -1515,10 +1240,76 @@ namespace csg {
 
         }
 
-        std::shared_ptr<csg::CodeGenerateData> generate_graph_code( std::shared_ptr<Graph> graph,std::shared_ptr<cse::SharedState> sharedState){
+        static std::string ResolveNode(std::shared_ptr<csg::CodeGenerateData> codeGenerateData, const std::shared_ptr<const Node> node,int getOutIndex) {
+            auto graph=codeGenerateData->graph;
+            
+            //已经处理过的节点
+            if(codeGenerateData->hasProcessedNode(node->id())){
+                SlotId slotIdIndex = SlotId(node->id(), getOutIndex);
+                std::string outValue = graph->GetSlotName(slotIdIndex);
+                return outValue;
+            }
+            
+            //标记处理该节点
+            codeGenerateData->processedNode(node->id());
 
-            std::shared_ptr<csg::CodeGenerateData> codeGenerateData = std::make_shared<csg::CodeGenerateData>(graph,sharedState) ;
-            std::shared_ptr<Node> masterNode;
+            //先处理上游节点,这样本节点生成的代码只依赖自身内容和上游的变量名
+            //位置不影响生成的代码,拖动节点不能让它和下游的缓存失效
+            uint64_t key{ csc::hash_value(node->content_hash()) };
+            for (size_t i = 0; i < node->slots().size(); i++) {
+                const Connection* const connect = graph->find_connection(SlotId(node->id(), i));
+                if (connect == nullptr) {
+                    continue;
+                }
+                const auto source_node{ graph->get(connect->source().node_id()) };
+                if (source_node == nullptr) {
+                    continue;
+                }
+                ResolveNode(codeGenerateData, source_node, (int)connect->source().index());
+                key = csc::hash_value(i, key);
+                key = csc::hash_value(codeGenerateData->GetNodeKey(source_node->id()), key);
+                key = csc::hash_value(connect->source().index(), key);
+            }
+            //变量名由节点顺序决定; 登记ramp行的节点不进缓存, 行号不用算进key
+            key = csc::hash_value(node->id(), key);
+            key = csc::hash_value(graph->getOrderByNodeId(node->id()), key);
+            codeGenerateData->SetNodeKey(node->id(), key);
+
+            //常量节点不生成代码,下游在ResolveSlot里直接取折叠值
+            if (codeGenerateData->folder.evaluate(node->id()) != nullptr) {
+                return graph->GetSlotName(SlotId(node->id(), getOutIndex));
+            }
+
+            if (codeGenerateData->ReplaySnippet(node->id(), key)) {
+                if (node->type() == NodeType::MATERIAL_OUTPUT) {
+                    return "";
+                }
+                return graph->GetSlotName(SlotId(node->id(), getOutIndex));
+            }
+
+            //ramp/curve节点会在ramp atlas里登记行,每次都要重新生成
+            const int layer = codeGenerateData->current_layer;
+            codeGenerateData->BeginSnippet();
+            const std::string outValue{ EmitNode(codeGenerateData, node, getOutIndex) };
+            codeGenerateData->EndSnippet(node->id(), key, layer == codeGenerateData->current_layer);
+            return outValue;
+        }
+
+        uint64_t structural_hash(const std::string& vertex, const std::string& fragment, const std::string& varying) {
+            uint64_t hash = csc::HASH_SEED;
+            for (const std::string* source : { &vertex, &fragment, &varying }) {
+                const uint64_t size = source->size();
+                hash = csc::hash_value(size, hash);
+                hash = csc::hash_bytes(source->data(), source->size(), hash);
+            }
+            //0留给不是生成出来的program
+            return hash != 0 ? hash : 1;
+        }
+
+        std::shared_ptr<csg::CodeGenerateData> generate_graph_code( std::shared_ptr<Graph> graph,std::shared_ptr<cse::SharedState> sharedState,std::shared_ptr<CodeSnippetCache> snippetCache){
+
+            std::shared_ptr<csg::CodeGenerateData> codeGenerateData = std::make_shared<csg::CodeGenerateData>(graph,sharedState,snippetCache) ;
+            std::shared_ptr<const Node> masterNode;
             for (const auto& node : graph->nodes()) {
                 if (node->type() == csg::NodeType::MATERIAL_OUTPUT) {
                     masterNode = node;
@@ -1533,23 +1324,173 @@ namespace csg {
             AddMVPUniform(codeGenerateData);
 
 
+            //这次没有再登记的槽释放它们的ramp行
+            sharedState->begin_ramp_rows();
             ResolveNode(codeGenerateData,masterNode);
+            sharedState->end_ramp_rows();
+            codeGenerateData->PruneSnippetCache();
+            codeGenerateData->EliminateDeadCode();
+            codeGenerateData->PackUniformParams();
             
 
             return codeGenerateData;
         }
 
-        bool complie_graph( std::shared_ptr<Graph> the_graph,std::shared_ptr<cse::SharedState> shared_state,bool saveData2File){
-            std::shared_ptr<csg::CodeGenerateData> code = csg::generate_graph_code(the_graph,shared_state);
+        void refresh_folded_uniforms(std::shared_ptr<Graph> graph, std::shared_ptr<cse::SharedState> sharedState, NodeId nodeId) {
+            ConstantFolder folder{ *graph };
+            std::vector<NodeId> pending{ nodeId };
+            std::map<NodeId, int> visited;
+            while (!pending.empty()) {
+                const NodeId id = pending.back();
+                pending.pop_back();
+                if (visited.count(id) > 0) {
+                    continue;
+                }
+                visited[id] = 0;
+                const FoldedSlots* const folded = folder.evaluate(id);
+                if (folded == nullptr) {
+                    //不能折叠的节点用的是自身的uniform,已经由调用方更新
+                    continue;
+                }
+                const auto node{ graph->get(id) };
+                for (size_t i = 0; i < node->slots().size(); i++) {
+                    if (node->slot_dir(i) != SlotDirection::OUTPUT) {
+                        continue;
+                    }
+                    const SlotId outSlotId{ id, i };
+                    sharedState->push_slot_val_change(outSlotId, (*folded)[i]);
+                }
+                for (const SlotId& dest : graph->connections_from(id)) {
+                    pending.push_back(dest.node_id());
+                }
+            }
+        }
+
+        struct NodeInclude {
+            NodeType type;
+            const char* file;
+        };
+
+        //node.cginc里各节点对应的文件,顺序和node.cginc一致
+        //closure_eval_lib先引入,带上base_h里的工具函数和Closure定义,没有#include的节点文件也能编译
+        static const NodeInclude s_nodeIncludes[] =
+        {
+            { NodeType::MATERIAL_OUTPUT,     "light/closure_eval_lib.cginc" },
+            { NodeType::BRIGHTNESS_CONTRAST, "color/node_brightness_contrast.cginc" },
+            { NodeType::RGB_CURVES,          "color/node_curves_rgb.cginc" },
+            { NodeType::HSV,                 "color/node_hsv.cginc" },
+            { NodeType::GAMMA,               "color/node_gamma.cginc" },
+            { NodeType::INVERT,              "color/node_invert.cginc" },
+            { NodeType::LIGHT_FALLOFF,       "color/node_light_falloff.cginc" },
+            { NodeType::MIX_RGB,             "color/node_mix.cginc" },
+            { NodeType::BLACKBODY,           "converter/node_blackbody.cginc" },
+            { NodeType::COMBINE_HSV,         "converter/node_combine_hsv.cginc" },
+            { NodeType::COMBINE_RGB,         "converter/node_combine_rgb.cginc" },
+            { NodeType::COMBINE_XYZ,         "converter/node_combine_xyz.cginc" },
+            { NodeType::MAP_RANGE,           "converter/node_map_range.cginc" },
+            { NodeType::MATH,                "converter/node_math.cginc" },
+            { NodeType::RGB_TO_BW,           "converter/node_rgbtobw.cginc" },
+            { NodeType::SEPARATE_HSV,        "converter/node_separate_hsv.cginc" },
+            { NodeType::SEPARATE_RGB,        "converter/node_separate_rgb.cginc" },
+            { NodeType::SEPARATE_XYZ,        "converter/node_separate_xyz.cginc" },
+            { NodeType::VECTOR_MATH,         "converter/node_vector_math.cginc" },
+            { NodeType::COLOR_RAMP,          "converter/node_color_ramp.cginc" },
+            { NodeType::CLAMP,               "converter/node_clamp.cginc" },
+            { NodeType::WAVELENGTH,          "converter/node_wavelength.cginc" },
+            { NodeType::DIFFUSE_BSDF,        "shader/node_bsdf_oren_nayar.cginc" },
+            { NodeType::EMISSION,            "shader/node_bsdf_emission.cginc" },
+            { NodeType::PBR,                 "shader/node_bsdf_surface.cginc" },
+            { NodeType::ADD_SHADER,          "shader/node_add_shader.cginc" },
+            { NodeType::MIX_SHADER,          "shader/node_mix_shader.cginc" },
+            { NodeType::CHECKER_TEX,         "texture/node_tex_checker.cginc" },
+            { NodeType::BRICK_TEX,           "texture/node_tex_brick.cginc" },
+            { NodeType::GRADIENT_TEX,        "texture/node_tex_gradient.cginc" },
+            { NodeType::IMAGE_TEX,           "texture/node_tex_image.cginc" },
+            { NodeType::MAGIC_TEX,           "texture/node_tex_magic.cginc" },
+            { NodeType::MUSGRAVE_TEX,        "texture/node_tex_musgrave.cginc" },
+            { NodeType::NOISE_TEX,           "texture/node_tex_noise.cginc" },
+            { NodeType::VORONOI_TEX,         "texture/node_tex_voronoi.cginc" },
+            { NodeType::WAVE_TEX,            "texture/node_tex_wave.cginc" },
+            { NodeType::WHITE_NOISE_TEX,     "texture/node_tex_white_noise.cginc" },
+            { NodeType::BUMP,                "vector/node_bump.cginc" },
+            { NodeType::DISPLACEMENT,        "vector/node_displacement.cginc" },
+            { NodeType::MAPPING,             "vector/node_mapping.cginc" },
+            { NodeType::NORMAL,              "vector/node_normal.cginc" },
+            { NodeType::NORMAL_MAP,          "vector/node_normal_map.cginc" },
+            { NodeType::VECTOR_CURVES,       "vector/node_vector_curves.cginc" },
+            { NodeType::VECTOR_DISPLACEMENT, "vector/node_vector_displacement.cginc" },
+            { NodeType::VECTOR_TRANSFORM,    "vector/node_vector_transform.cginc" },
+            { NodeType::BEVEL,               "input/node_bevel.cginc" },
+            { NodeType::CAMERA_DATA,         "input/node_camera.cginc" },
+            { NodeType::FRESNEL,             "input/node_fresnel.cginc" },
+            { NodeType::LAYER_WEIGHT,        "input/node_fresnel.cginc" },//fresnel_dielectric
+            { NodeType::GEOMETRY,            "input/node_geometry.cginc" },
+            { NodeType::LAYER_WEIGHT,        "input/node_layer_weight.cginc" },
+            { NodeType::LIGHT_PATH,          "input/node_light_path.cginc" },
+            { NodeType::OBJECT_INFO,         "input/node_object_info.cginc" },
+            { NodeType::RGB,                 "input/node_rgb.cginc" },
+            { NodeType::TANGENT,             "input/node_tangent.cginc" },
+            { NodeType::TEXTURE_COORDINATE,  "input/node_tex_coord.cginc" },
+            { NodeType::VALUE,               "input/node_value.cginc" },
+            { NodeType::WIREFRAME,           "input/node_wireframe.cginc" },
+        };
+
+        std::vector<std::string> node_include_files(const Graph& graph, const ir::Function& fragment) {
+            std::vector<bool> used(static_cast<size_t>(NodeType::COUNT), false);
+            used[static_cast<size_t>(NodeType::MATERIAL_OUTPUT)] = true;
+            for (const ir::Op& op : fragment.ops) {
+                //prelude ops (node -1) are not in the graph
+                const auto node{ graph.get(op.node) };
+                if (node != nullptr) {
+                    used[static_cast<size_t>(node->type())] = true;
+                }
+            }
+
+            std::vector<bool> covered(static_cast<size_t>(NodeType::COUNT), false);
+            std::vector<std::string> files;
+            for (const NodeInclude& include : s_nodeIncludes) {
+                const size_t type{ static_cast<size_t>(include.type) };
+                if (!used[type]) {
+                    continue;
+                }
+                covered[type] = true;
+                if (std::find(files.begin(), files.end(), include.file) == files.end()) {
+                    files.push_back(include.file);
+                }
+            }
+            for (size_t type = 0; type < used.size(); type++) {
+                if (used[type] && !covered[type]) {
+                    //不认识的节点,退回到整个节点库
+                    return std::vector<std::string>{ "node.cginc" };
+                }
+            }
+            return files;
+        }
+
+        bool complie_graph( std::shared_ptr<Graph> the_graph,std::shared_ptr<cse::SharedState> shared_state,std::shared_ptr<CodeSnippetCache> snippet_cache,bool saveData2File){
+            csc::ProfileScope generatePhase("generate_graph_code");
+            std::shared_ptr<csg::CodeGenerateData> code = csg::generate_graph_code(the_graph,shared_state,snippet_cache);
+            generatePhase.stop();
             shared_state->record_connect_nodes(code->get_connected_nodes());
-            auto uniformParams = code->GetUniformData(shared_state);
+            csc::ProfileScope uniformPhase("uniform data");
+            std::unordered_map<SlotId,uint16_t> slotIndices;
+            auto uniformParams = code->GetUniformData(shared_state,slotIndices);
+            uniformPhase.stop();
+            //先换参数表再交出代码, 之后的改值都按新表的下标走
+            shared_state->set_uniform_layout(std::move(slotIndices));
             uint32_t size = (uint32_t)uniformParams.size()*sizeof(csc::UniformData);
+            std::string str;
             if(saveData2File){
-                std::string str = the_graph->serialize();
-                shared_state->set_output_code(str,code->ExportVertex(), code->ExportFragment(),code->ExportVaring(),(void*)&uniformParams[0],size);
-            }else{
-                shared_state->set_output_code("",code->ExportVertex(), code->ExportFragment(),code->ExportVaring(),(void*)&uniformParams[0],size);
+                csc::ProfileScope serializePhase("serialize graph");
+                str = the_graph->serialize();
             }
+            csc::ProfileScope exportPhase("export code");
+            std::string vertex = code->ExportVertex();
+            std::string fragment = code->ExportFragment();
+            std::string varying = code->ExportVaring();
+            exportPhase.stop();
+            const uint64_t programKey = structural_hash(vertex,fragment,varying);
+            shared_state->set_output_code(str,vertex,fragment,varying,(void*)&uniformParams[0],size,programKey);
             return true;
         }
 
@@ -15,13 +15,18 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <set>
 #include <sstream>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 #include <boost/optional.hpp>
 #include "../shader_core/shader_def.h"
 #include "../shader_editor/shared_state.h"
 #include "node_id.h"
+#include "slot_id.h"
+#include "constant_fold.h"
+#include "shader_ir.h"
 
 using namespace csc;
 //
@@ -133,7 +138,11 @@ namespace csg {
         csc::ShaderAttributeType::Enum attributeType = csc::ShaderAttributeType::Count;
         char defaultVal[64];
         Float4 defaultValue;//mat3 mat4 暂时不支持
-        uint64_t uniformId;
+        //编辑器改这个槽的值时更新这个uniform, 完整的NodeId不会像slot_id()那样撞车
+        bool editable = false;
+        NodeId slotNode = 0;
+        uint32_t slotIndex = 0;
+        int32_t packedOffset = -1;//打进PACKED_PARAMS_NAME数组时的float下标
         char textFilePath[256];
     };
 
@@ -142,6 +151,66 @@ namespace csg {
 		std::string funContent;
 	};
 
+    //单个节点上次生成的代码片段,key相同时直接复用
+    struct NodeCodeSnippet {
+        uint64_t key;
+        std::vector<ir::Op> ops;
+        std::vector<UniformCodeData> uniforms;
+    };
+
+    //按节点缓存生成结果,只有内容或输入连线变化的节点需要重新生成
+    //不是线程安全的,同一时间只能被一次生成过程使用
+    class CodeSnippetCache {
+    private:
+        std::map<csg::NodeId, NodeCodeSnippet> snippets;
+
+    public:
+        const NodeCodeSnippet* find(const csg::NodeId nodeId, const uint64_t key) const {
+            const auto iter = snippets.find(nodeId);
+            if (iter == snippets.end() || iter->second.key != key) {
+                return nullptr;
+            }
+            return &iter->second;
+        }
+
+        void store(const csg::NodeId nodeId, NodeCodeSnippet&& snippet) {
+            snippets[nodeId] = std::move(snippet);
+        }
+
+        void erase(const csg::NodeId nodeId) {
+            snippets.erase(nodeId);
+        }
+
+        //删除本次生成没有访问到的节点(已删除或断开)
+        void retain(const std::map<csg::NodeId, int>& visitedNodes) {
+            for (auto iter = snippets.begin(); iter != snippets.end();) {
+                if (visitedNodes.count(iter->first) == 0) {
+                    iter = snippets.erase(iter);
+                }
+                else {
+                    ++iter;
+                }
+            }
+        }
+
+        void clear() {
+            snippets.clear();
+        }
+
+        size_t size() const {
+            return snippets.size();
+        }
+    };
+
+
+    //files under runtime_visual_shader/node the fragment code calls into, in node.cginc order
+    std::vector<std::string> node_include_files(const Graph& graph, const ir::Function& fragment);
+
+    //顶点着色器里的一条赋值,varying没人读时整条去掉
+    struct VertexStatement {
+        std::string target;
+        std::string expr;
+    };
 
 	class CodeGenerateData {
 	private:
@@ -161,18 +230,34 @@ namespace csg {
         //add info to process code
         std::map<csg::NodeId, int> processedNodes;
         //当前引用2Du图片的高度索引
+
+        //每个节点本次生成的缓存key,下游节点的key依赖上游节点的key
+        std::map<csg::NodeId, uint64_t> nodeKeys;
+        //正在录制的节点片段,从snippetBegin开始的op属于该节点
+        bool recordingSnippet;
+        size_t snippetBegin;
+        std::vector<UniformCodeData> recordedUniforms;
         
 	public:
-		std::stringstream fragment_stream;
-		std::stringstream vertex_stream;
-        int current_layer;//每次重新生成ramp重置为0
+		ir::Function fragment;//main()里的代码,导出时才生成GLSL
+		std::vector<VertexStatement> vertexStatements;
+        int current_layer;//本次生成登记过的ramp行数, 只用来判断节点能否缓存
         std::shared_ptr<csg::Graph> graph;
         std::shared_ptr<cse::SharedState> shareState;
+        std::shared_ptr<CodeSnippetCache> snippetCache;//为空时不做增量生成
+        ConstantFolder folder;//输入都是常量的转换节点在CPU上算好,不生成代码
+        bool packUniforms;//float/vec2/vec3/vec4参数打包进一个vec4数组,每次draw只传一次
+        uint16_t packedRows;
 
 
-		CodeGenerateData(std::shared_ptr<csg::Graph> _graph,std::shared_ptr<cse::SharedState> _shareState) {
+		CodeGenerateData(std::shared_ptr<csg::Graph> _graph,std::shared_ptr<cse::SharedState> _shareState,std::shared_ptr<CodeSnippetCache> _snippetCache = nullptr) : folder{ *_graph } {
             graph = _graph;
             shareState = _shareState;
+            snippetCache = _snippetCache;
+            packUniforms = true;
+            packedRows = 0;
+            recordingSnippet = false;
+            snippetBegin = 0;
 			fragment_head_stream << "//--------\n";
 			fragment_head_stream << "//this fragment code generate by zhouxingxing's visual shader scirpt app\n";
             fragment_head_stream<<pre_uniform_str;
@@ -194,6 +279,119 @@ namespace csg {
             processedNodes[nodeId] = 0;
         }
 
+        uint64_t GetNodeKey(const csg::NodeId nodeId) const {
+            const auto iter = nodeKeys.find(nodeId);
+            return iter != nodeKeys.end() ? iter->second : 0;
+        }
+        void SetNodeKey(const csg::NodeId nodeId, const uint64_t key) {
+            nodeKeys[nodeId] = key;
+        }
+
+        //命中缓存时把节点上次的代码和uniform重新加入
+        bool ReplaySnippet(const csg::NodeId nodeId, const uint64_t key) {
+            if (snippetCache == nullptr) {
+                return false;
+            }
+            const NodeCodeSnippet* const snippet = snippetCache->find(nodeId, key);
+            if (snippet == nullptr) {
+                return false;
+            }
+            fragment.ops.insert(fragment.ops.end(), snippet->ops.begin(), snippet->ops.end());
+            for (const auto& uniformData : snippet->uniforms) {
+                AddUniformParams(uniformData);
+            }
+            return true;
+        }
+
+        //开始录制一个节点自身生成的代码,上游节点必须在此之前处理完
+        void BeginSnippet() {
+            assert(!recordingSnippet);
+            if (snippetCache == nullptr) {
+                return;
+            }
+            recordingSnippet = true;
+            recordedUniforms.clear();
+            snippetBegin = fragment.ops.size();
+        }
+
+        void EndSnippet(const csg::NodeId nodeId, const uint64_t key, const bool cacheable) {
+            if (!recordingSnippet) {
+                return;
+            }
+            recordingSnippet = false;
+            NodeCodeSnippet snippet{ key, std::vector<ir::Op>(fragment.ops.begin() + snippetBegin, fragment.ops.end()), std::move(recordedUniforms) };
+            recordedUniforms.clear();
+            if (cacheable) {
+                snippetCache->store(nodeId, std::move(snippet));
+            }
+            else {
+                snippetCache->erase(nodeId);
+            }
+        }
+
+        void AddVertexStatement(const std::string& target, const std::string& expr) {
+            vertexStatements.push_back(VertexStatement{ target, expr });
+        }
+
+        //导出前去掉没人读的输出,prelude,uniform,varying和attribute
+        void EliminateDeadCode() {
+            std::set<std::string> fragmentLive;
+            ir::eliminate_dead_code(fragment, fragmentLive);
+            auto notIn = [](const std::set<std::string>& live) {
+                return [&live](const UniformCodeData& uniformData) { return live.count(uniformData.uniformName) == 0; };
+            };
+            uniformFragParams.erase(std::remove_if(uniformFragParams.begin(), uniformFragParams.end(), notIn(fragmentLive)), uniformFragParams.end());
+            varyingParams.erase(std::remove_if(varyingParams.begin(), varyingParams.end(), notIn(fragmentLive)), varyingParams.end());
+
+            std::set<std::string> vertexLive;
+            std::vector<VertexStatement> statements;
+            for (auto& statement : vertexStatements) {
+                if (statement.target == "gl_Position" || fragmentLive.count(statement.target) > 0) {
+                    ir::collect_identifiers(statement.expr, vertexLive);
+                    statements.push_back(std::move(statement));
+                }
+            }
+            vertexStatements = std::move(statements);
+            attributeParams.erase(std::remove_if(attributeParams.begin(), attributeParams.end(), notIn(vertexLive)), attributeParams.end());
+            uniformVertexParams.erase(std::remove_if(uniformVertexParams.begin(), uniformVertexParams.end(), notIn(vertexLive)), uniformVertexParams.end());
+        }
+
+        //去掉死代码之后给fragment参数分配打包位置:大的先放,每个参数不跨vec4,放进第一个剩余分量够的行
+        void PackUniformParams() {
+            packedRows = 0;
+            std::vector<UniformCodeData*> order;
+            for (auto& uniformData : uniformFragParams) {
+                uniformData.packedOffset = -1;
+                if (packUniforms && csc::packed_component_count(uniformData.uniformType) > 0) {
+                    order.push_back(&uniformData);
+                }
+            }
+            std::stable_sort(order.begin(), order.end(), [](const UniformCodeData* a, const UniformCodeData* b) {
+                return csc::packed_component_count(a->uniformType) > csc::packed_component_count(b->uniformType);
+            });
+            std::vector<uint8_t> rowUsed;
+            for (auto* uniformData : order) {
+                const uint8_t count = csc::packed_component_count(uniformData->uniformType);
+                size_t row = 0;
+                while (row < rowUsed.size() && rowUsed[row] + count > 4) {
+                    row++;
+                }
+                if (row == rowUsed.size()) {
+                    rowUsed.push_back(0);
+                }
+                uniformData->packedOffset = static_cast<int32_t>(row * 4 + rowUsed[row]);
+                rowUsed[row] += count;
+            }
+            packedRows = static_cast<uint16_t>(rowUsed.size());
+        }
+
+        //生成结束后清理缓存中已经不在图里的节点
+        void PruneSnippetCache() {
+            if (snippetCache != nullptr) {
+                snippetCache->retain(processedNodes);
+            }
+        }
+
 		bool HasFun(std::string funName) {
 			return fragmentFunMap.count(funName);
 		}
@@ -218,6 +416,9 @@ namespace csg {
 		}
 
 		bool AddUniformParams(const UniformCodeData& uniformData) {
+            if (recordingSnippet) {
+                recordedUniforms.push_back(uniformData);
+            }
 			if (params.count(uniformData.uniformName) > 0) {
 				return false;
 			}
@@ -287,14 +488,17 @@ namespace csg {
             for (const auto& uniformData : this->varyingParams) {
                 this->fragment_head_stream << " " << uniformData.uniformName;
                 i++;
-                if(i<this->attributeParams.size()){
+                if(i<this->varyingParams.size()){
                    this->fragment_head_stream << ",";
                 }
             }
             this->fragment_head_stream << " // in...\n";
             this->fragment_head_stream << "\n";
             this->fragment_head_stream << "#include \"../common/common.sh\"\n";
-            this->fragment_head_stream << "#include \"../node/node.cginc\"\n";
+            //只引入图里用到的节点文件,shaderc不用每次预处理整个节点库
+            for (const auto& file : node_include_files(*graph, fragment)) {
+                this->fragment_head_stream << "#include \"../node/" << file << "\"\n";
+            }
             this->fragment_head_stream << "\n";
             
             u_int16_t samplerIndex = 0;
@@ -302,10 +506,25 @@ namespace csg {
                 if(uniformData.uniformType == csc::UniformType::Sampler){
                     this->fragment_head_stream << "SAMPLER2D("  << uniformData.uniformName << ","<< (samplerIndex) <<");\n";
                     samplerIndex++;
-                }else{
+                }else if(uniformData.packedOffset < 0){
                     this->fragment_head_stream << "uniform " << s_uniforType[uniformData.uniformType] << " " << uniformData.uniformName << ";\n";
                 }
             }
+            //打包的参数用宏换成数组分量,main里的代码不用变
+            if(packedRows > 0){
+                this->fragment_head_stream << "uniform vec4 " << csc::PACKED_PARAMS_NAME << "[" << packedRows << "];\n";
+                for (const auto& uniformData : this->uniformFragParams) {
+                    if(uniformData.packedOffset < 0){
+                        continue;
+                    }
+                    const uint8_t count = csc::packed_component_count(uniformData.uniformType);
+                    this->fragment_head_stream << "#define " << uniformData.uniformName << " (" << csc::PACKED_PARAMS_NAME << "[" << uniformData.packedOffset / 4 << "]";
+                    if(count < 4){
+                        this->fragment_head_stream << "." << std::string("xyzw").substr(uniformData.packedOffset % 4, count);
+                    }
+                    this->fragment_head_stream << ")\n";
+                }
+            }
             this->fragment_head_stream << "\n";
             
 //            for (const auto& uniformData : this->localParams) {
@@ -329,7 +548,7 @@ namespace csg {
 			
 
 			this->fragment_head_stream << "void main(){\n";
-			this->fragment_head_stream << fragment_stream.str();
+			ir::emit_glsl(fragment, this->fragment_head_stream);
 			this->fragment_head_stream << "\n}\n";
 			return this->fragment_head_stream.str();
 		}
@@ -369,38 +588,64 @@ namespace csg {
             }
 
 			this->vertex_head_stream << "void main(){\n";
-			this->vertex_head_stream << vertex_stream.str();
+			for (const auto& statement : this->vertexStatements) {
+				this->vertex_head_stream << " " << statement.target << " = " << statement.expr << ";\n";
+			}
 			this->vertex_head_stream << "\n}\n";
 			return this->vertex_head_stream.str();
 		}
         
         
-        std::vector<csc::UniformData> GetUniformData(const std::shared_ptr<cse::SharedState> shared_state){
+        //slotIndices返回每个可编辑槽在参数表里的下标
+        std::vector<csc::UniformData> GetUniformData(const std::shared_ptr<cse::SharedState> shared_state,std::unordered_map<SlotId,uint16_t>& slotIndices){
             std::vector<csc::UniformData> uniforms;
             u_int16_t samplerIndex = 0;
+            slotIndices.clear();
             
             csc::UniformData rampSampler;
-            auto rampTextureHandle =  shared_state->GetRampTextureHandler();//todo;
+            auto rampTextureHandle =  shared_state->GetRampTextureHandler();
             rampSampler.uniformUnionData = UniformUnionData{TextureData{rampTextureHandle,9}};
-            rampSampler.uniformId = shared_state->GetRampTextureUniformId();
+            rampSampler.uniformIndex = csc::RAMP_CURVE_UNIFORM_INDEX;
             strcpy( rampSampler.uniformName , "ramp_curve");
             rampSampler.uniformType = csc::UniformType::Sampler;
             uniforms.push_back(rampSampler);
             
+            //和上面的贴图同时取, 行数一定对得上
+            csc::UniformData rampSize;
+            rampSize.uniformUnionData = UniformUnionData{shared_state->GetRampCurveSize()};
+            rampSize.uniformIndex = csc::RAMP_CURVE_SIZE_UNIFORM_INDEX;
+            strcpy( rampSize.uniformName , csc::RAMP_CURVE_SIZE_NAME);
+            rampSize.uniformType = csc::UniformType::Vec4;
+            uniforms.push_back(rampSize);
+            
             for (const auto& uniformData : this->uniformFragParams) {
                 csc::UniformData tmp;
                 if(uniformData.uniformType == csc::UniformType::Sampler){
-                    auto textureHandle =  shared_state->AddTextureHandler(uniformData.textFilePath);//todo;
+                    auto textureHandle =  shared_state->AddSlotTextureHandler(SlotId{uniformData.slotNode,uniformData.slotIndex},uniformData.textFilePath);
                     tmp.uniformUnionData = UniformUnionData{TextureData{textureHandle,samplerIndex}};
                     samplerIndex++;
                 }else{
                     tmp.uniformUnionData = UniformUnionData{uniformData.defaultValue};
                 }
-                tmp.uniformId = uniformData.uniformId;
+                tmp.uniformIndex = static_cast<uint16_t>(uniforms.size());
+                tmp.packedOffset = uniformData.packedOffset;
+                if(uniformData.editable){
+                    slotIndices[SlotId{uniformData.slotNode,uniformData.slotIndex}] = tmp.uniformIndex;
+                }
                 strcpy( tmp.uniformName , uniformData.uniformName);
                 tmp.uniformType = uniformData.uniformType;
                 uniforms.push_back(tmp);
             }
+            //打包数组放在最后, 前面可编辑参数的下标不受影响
+            if(packedRows > 0){
+                csc::UniformData packed;
+                packed.uniformUnionData = UniformUnionData{Float4()};
+                packed.uniformIndex = static_cast<uint16_t>(uniforms.size());
+                strcpy( packed.uniformName , csc::PACKED_PARAMS_NAME);
+                packed.uniformType = csc::UniformType::Vec4;
+                packed.num = packedRows;
+                uniforms.push_back(packed);
+            }
             return uniforms;//里面有些变量并不是在node中定义的,而是在codeh中定义的,但是需要声明 所以一并处理了
         }
         
@@ -413,7 +658,14 @@ namespace csg {
         }
 	};
 
-	std::shared_ptr<csg::CodeGenerateData> generate_graph_code( std::shared_ptr<Graph> graph,std::shared_ptr<cse::SharedState> sharedState);
+	//slot values of a folded node changed: push the new folded values of it and everything folded downstream
+	void refresh_folded_uniforms(std::shared_ptr<Graph> graph, std::shared_ptr<cse::SharedState> sharedState, NodeId nodeId);
+
+	//生成的三份源码决定program, 参数默认值和贴图路径只在参数表里, 所以只差这些的图hash相同, 可以共用一个program
+	uint64_t structural_hash(const std::string& vertex, const std::string& fragment, const std::string& varying);
+
+	std::shared_ptr<csg::CodeGenerateData> generate_graph_code( std::shared_ptr<Graph> graph,std::shared_ptr<cse::SharedState> sharedState,std::shared_ptr<CodeSnippetCache> snippetCache = nullptr);
 
-    bool complie_graph( std::shared_ptr<Graph> graph,std::shared_ptr<cse::SharedState> sharedState,bool saveData2File);
+    //snippetCache由调用方持有, 同一个编辑器里的每次编译传同一个, 为空时整图重新生成
+    bool complie_graph( std::shared_ptr<Graph> graph,std::shared_ptr<cse::SharedState> sharedState,std::shared_ptr<CodeSnippetCache> snippetCache,bool saveData2File);
 }
@@ -4,6 +4,7 @@
 */
 
 #include "code_rampcolor_byte.h"
+#include <bx/debug.h>
 
 
 
@@ -18,21 +19,21 @@ namespace csg {
 		pixels[0] = a[2]*255;
 	}
 
-	int gpu_material_ramp_texture_row_set(const std::shared_ptr<cse::SharedState> shareState, int size, uint32_t* pixels, int layer) {
-		if (layer >= CM_TABLE) {
-			//越界了,每帧最多使用的band
-            assert(false);
+	int gpu_material_ramp_texture_row_set(const std::shared_ptr<cse::SharedState> shareState, int size, uint32_t* pixels, const SlotId& owner) {
+		assert(size == MAX_COLOR_BAND);
+		const int row = shareState->AssignRampRow(owner, pixels);
+		if (row < 0) {
+			//行数到上限了, 先用第0行, 不再assert
+			bx::debugPrintf("ramp_curve is full, node %lld slot %u uses row 0\n", (long long)owner.node_id(), (unsigned)owner.index());
+			return 0;
 		}
-		else {
-			shareState->UpdateLayerRampBuffer(pixels,layer);
-		}
-        return layer+1;
+        return row;
 	}
 
-	int GPU_color_band(const std::shared_ptr<cse::SharedState> shareState, int size, uint32_t* pixels, int layer) {
-        return gpu_material_ramp_texture_row_set(shareState, size, pixels, layer);
-//		free(pixels);
-//		return texId;
+	int GPU_color_band(const std::shared_ptr<cse::SharedState> shareState, int size, uint32_t* pixels, const SlotId& owner) {
+        const int row = gpu_material_ramp_texture_row_set(shareState, size, pixels, owner);
+		free(pixels);
+		return row;
 	}
 
 	void BKE_curvemapping_table_RGBA(const Curve* cumap_x,const Curve* cumap_y,const Curve* cumap_z,const Curve* cumap_w, uint32_t** array, int* size)
@@ -40,7 +41,8 @@ namespace csg {
 		int a;
 
 		*size = MAX_COLOR_BAND;
-		*array = (uint32_t*)malloc(sizeof(uint32_t) * (*size));
+		//没有w曲线时alpha保持0, 同样的曲线才能按内容共用一行
+		*array = (uint32_t*)calloc(*size, sizeof(uint32_t));
 
 		//直接在curve里面缓存,不用每次算
 		auto cached_x_curve = cumap_x->eval_curve<MAX_COLOR_BAND>();
@@ -76,15 +78,15 @@ namespace csg {
 	/// </summary>
 	/// <param name="mat"></param>
 	/// <param name="cumap"></param>
-	/// <param name="accessLayer"></param>
+	/// <param name="owner"></param>
 	/// <returns></returns>
-    int SetVectorCurveSlotValue(const std::shared_ptr<cse::SharedState> shareState, const VectorCurveSlotValue* cumap,int accessLayer,csc::Float3* range,csc::Float4* extx,csc::Float4* exty,csc::Float4* extz) {
+    int SetVectorCurveSlotValue(const std::shared_ptr<cse::SharedState> shareState, const VectorCurveSlotValue* cumap,const SlotId& owner,csc::Float3* range,csc::Float4* extx,csc::Float4* exty,csc::Float4* extz) {
         uint32_t* array;
 		int size;
 
 		BKE_curvemapping_table_RGBA(cumap->get_x_ptr(),cumap->get_y_ptr(),cumap->get_z_ptr(),nullptr, &array, &size);
 
-		accessLayer = GPU_color_band(shareState, size, array, accessLayer);
+		const int row = GPU_color_band(shareState, size, array, owner);
         
 
         if(range != nullptr){
@@ -118,17 +120,17 @@ namespace csg {
                 }
             }
         }
-        return accessLayer;
+        return row;
 	}
 
 
-    int SetRGBCurveSlotValue(const std::shared_ptr<cse::SharedState> shareState,const RGBCurveSlotValue* cumap,int accessLayer,csc::Float4* range,csc::Float4* extx,csc::Float4* exty,csc::Float4* extz,csc::Float4* extw) {
+    int SetRGBCurveSlotValue(const std::shared_ptr<cse::SharedState> shareState,const RGBCurveSlotValue* cumap,const SlotId& owner,csc::Float4* range,csc::Float4* extx,csc::Float4* exty,csc::Float4* extz,csc::Float4* extw) {
         uint32_t* array;
         int size;
 
         BKE_curvemapping_table_RGBA(cumap->get_x_ptr(),cumap->get_y_ptr(),cumap->get_z_ptr(),cumap->get_all_ptr(), &array, &size);
 
-        accessLayer = GPU_color_band(shareState, size, array, accessLayer);
+        const int row = GPU_color_band(shareState, size, array, owner);
         
 
         if(range != nullptr){
@@ -164,7 +166,7 @@ namespace csg {
                 }
             }
         }
-        return accessLayer;
+        return row;
     }
 
 
@@ -188,16 +190,13 @@ namespace csg {
 		}
 	}
 
-	int SetColorRampSlotValue(const std::shared_ptr<cse::SharedState> shareState,const ColorRampSlotValue* cumap,int accessLayer) {
+	int SetColorRampSlotValue(const std::shared_ptr<cse::SharedState> shareState,const ColorRampSlotValue* cumap,const SlotId& owner) {
         uint32_t* array;
 		int size;
 
 		BKE_colorband_evaluate_table_rgba(cumap, &array, &size);
 
-		accessLayer = GPU_color_band(shareState, size, array, accessLayer);
-
-        
-        return accessLayer;
+		return GPU_color_band(shareState, size, array, owner);
 	}
 
 
@@ -255,7 +254,7 @@ namespace csg {
 	void wavelength_to_xyz_table(uint32_t** array, int* size) {
 		
 		*size = MAX_COLOR_BAND;
-		*array = (uint32_t*)malloc(sizeof(uint32_t) * (*size));
+		*array = (uint32_t*)calloc(*size, sizeof(uint32_t));
 
 		uint32_t* r_table = *array;
 		int width = *size;
@@ -270,13 +269,13 @@ namespace csg {
 		}
 	}
 
-	int SetWaveLength(const std::shared_ptr<cse::SharedState> shareState, int accessLayer) {
+	int SetWaveLength(const std::shared_ptr<cse::SharedState> shareState, const SlotId& owner) {
 
         uint32_t* array;
 		int size;
 		wavelength_to_xyz_table(&array, &size);
 
-        accessLayer = GPU_color_band(shareState, size, array, accessLayer);
+        const int row = GPU_color_band(shareState, size, array, owner);
 
 		//data->r[0] = xyz_to_rgb[0];
 		//data->r[1] = xyz_to_rgb[3];
@@ -288,6 +287,6 @@ namespace csg {
 		//data->b[1] = xyz_to_rgb[5];
 		//data->b[2] = xyz_to_rgb[8];
 
-        return accessLayer;
+        return row;
 	}
 }
@@ -22,9 +22,9 @@ namespace csg {
 	/// </summary>
 	/// <param name="mat"></param>
 	/// <param name="cumap"></param>
-	/// <param name="accessLayer"></param>
-	/// <returns></returns>
-    int SetVectorCurveSlotValue(const std::shared_ptr<cse::SharedState> shareState, const VectorCurveSlotValue* cumap,int accessLayer,csc::Float3* range = nullptr,csc::Float4* extx= nullptr,csc::Float4* exty= nullptr,csc::Float4* extz= nullptr);
+	/// <param name="owner">占用这一行的槽</param>
+	/// <returns>ramp_curve里的行号</returns>
+    int SetVectorCurveSlotValue(const std::shared_ptr<cse::SharedState> shareState, const VectorCurveSlotValue* cumap,const SlotId& owner,csc::Float3* range = nullptr,csc::Float4* extx= nullptr,csc::Float4* exty= nullptr,csc::Float4* extz= nullptr);
 
 
 
@@ -33,9 +33,9 @@ namespace csg {
     /// </summary>
     /// <param name="mat"></param>
     /// <param name="cumap"></param>
-    /// <param name="accessLayer"></param>
-    /// <returns></returns>
-    int SetRGBCurveSlotValue(const std::shared_ptr<cse::SharedState> shareState, const RGBCurveSlotValue* cumap,int accessLayer,csc::Float4* range = nullptr,csc::Float4* extx= nullptr,csc::Float4* exty= nullptr,csc::Float4* extz= nullptr,csc::Float4* extw= nullptr);
+    /// <param name="owner">占用这一行的槽</param>
+    /// <returns>ramp_curve里的行号</returns>
+    int SetRGBCurveSlotValue(const std::shared_ptr<cse::SharedState> shareState, const RGBCurveSlotValue* cumap,const SlotId& owner,csc::Float4* range = nullptr,csc::Float4* extx= nullptr,csc::Float4* exty= nullptr,csc::Float4* extz= nullptr,csc::Float4* extw= nullptr);
 
 
 
@@ -44,12 +44,12 @@ namespace csg {
 	/// </summary>
 	/// <param name="mat"></param>
 	/// <param name="cumap"></param>
-	/// <param name="accessLayer"></param>
-	/// <returns></returns>
-    int SetColorRampSlotValue(const std::shared_ptr<cse::SharedState> shareState,const ColorRampSlotValue* cumap,int accessLayer) ;
+	/// <param name="owner">占用这一行的槽</param>
+	/// <returns>ramp_curve里的行号</returns>
+    int SetColorRampSlotValue(const std::shared_ptr<cse::SharedState> shareState,const ColorRampSlotValue* cumap,const SlotId& owner) ;
 
 
 	
-    //将wave数据转为贴图
-    int SetWaveLength(const std::shared_ptr<cse::SharedState> shareState, int accessLayer);
+    //将wave数据转为贴图, 所有wavelength节点的内容一样, 共用一行
+    int SetWaveLength(const std::shared_ptr<cse::SharedState> shareState, const SlotId& owner);
 }
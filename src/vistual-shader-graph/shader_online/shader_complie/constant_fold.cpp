@@ -0,0 +1,692 @@
+/*
+* Copyright 2021-2021 Zhouwei. All rights reserved.
+* License: https://github.com/zwluoqi/mobile-visual-shader-editor#license-bsd-2-clause
+*/
+
+#include "constant_fold.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "graph.h"
+#include "node.h"
+#include "node_type.h"
+#include "slot.h"
+#include "slot_id.h"
+
+namespace csg {
+
+	//////
+	// GLSL helpers, same semantics as the shader built-ins and include/math_util_h.cginc
+	//////
+
+	static float glsl_fract(const float a)
+	{
+		return a - std::floor(a);
+	}
+
+	static float glsl_mod(const float x, const float y)
+	{
+		return x - y * std::floor(x / y);
+	}
+
+	static float glsl_sign(const float a)
+	{
+		return (a > 0.0f) ? 1.0f : ((a < 0.0f) ? -1.0f : 0.0f);
+	}
+
+	static float glsl_clamp(const float x, const float lo, const float hi)
+	{
+		return std::min(std::max(x, lo), hi);
+	}
+
+	static float glsl_smoothstep(const float edge0, const float edge1, const float x)
+	{
+		const float t{ glsl_clamp((x - edge0) / (edge1 - edge0), 0.0f, 1.0f) };
+		return t * t * (3.0f - 2.0f * t);
+	}
+
+	static float safe_divide(const float a, const float b)
+	{
+		return (b != 0.0f) ? a / b : 0.0f;
+	}
+
+	static float compatible_fmod(const float a, const float b)
+	{
+		const float c{ (b != 0.0f) ? glsl_fract(std::fabs(a / b)) * std::fabs(b) : 0.0f };
+		return (a < 0.0f) ? -c : c;
+	}
+
+	static float compatible_pow(const float x, const float y)
+	{
+		if (y == 0.0f) {
+			return 1.0f;
+		}
+		if (x < 0.0f) {
+			if (glsl_mod(-y, 2.0f) == 0.0f) {
+				return std::pow(-x, y);
+			}
+			else {
+				return -std::pow(-x, y);
+			}
+		}
+		else if (x == 0.0f) {
+			return 0.0f;
+		}
+		return std::pow(x, y);
+	}
+
+	static float wrap(const float a, const float b, const float c)
+	{
+		const float range{ b - c };
+		return (range != 0.0f) ? a - (range * std::floor((a - c) / range)) : c;
+	}
+
+	static float smootherstep(const float edge0, const float edge1, const float ix)
+	{
+		const float x{ glsl_clamp(safe_divide((ix - edge0), (edge1 - edge0)), 0.0f, 1.0f) };
+		return x * x * x * (x * (x * 6.0f - 15.0f) + 10.0f);
+	}
+
+	static float dot3(const csc::Float4& a, const csc::Float4& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	template <typename F> static csc::Float4 map3(const csc::Float4& a, F f)
+	{
+		return csc::Float4{ f(a.x), f(a.y), f(a.z), 0.0f };
+	}
+
+	template <typename F> static csc::Float4 map3(const csc::Float4& a, const csc::Float4& b, F f)
+	{
+		return csc::Float4{ f(a.x, b.x), f(a.y, b.y), f(a.z, b.z), 0.0f };
+	}
+
+	static csc::Float4 scale3(const csc::Float4& a, const float s)
+	{
+		return csc::Float4{ a.x * s, a.y * s, a.z * s, 0.0f };
+	}
+
+	static csc::Float4 normalize3(const csc::Float4& a)
+	{
+		const float len{ std::sqrt(dot3(a, a)) };
+		return scale3(a, 1.0f / len);
+	}
+
+	//////
+	// include/color_h.cginc
+	//////
+
+	static csc::Float4 rgb_to_hsv(const csc::Float4& rgb)
+	{
+		const float cmax{ std::max(rgb.x, std::max(rgb.y, rgb.z)) };
+		const float cmin{ std::min(rgb.x, std::min(rgb.y, rgb.z)) };
+		const float cdelta{ cmax - cmin };
+
+		const float v{ cmax };
+		const float s{ (cmax != 0.0f) ? cdelta / cmax : 0.0f };
+		float h{ 0.0f };
+		if (s != 0.0f) {
+			const float cx{ (cmax - rgb.x) / cdelta };
+			const float cy{ (cmax - rgb.y) / cdelta };
+			const float cz{ (cmax - rgb.z) / cdelta };
+			if (rgb.x == cmax) {
+				h = cz - cy;
+			}
+			else if (rgb.y == cmax) {
+				h = 2.0f + cx - cz;
+			}
+			else {
+				h = 4.0f + cy - cx;
+			}
+			h /= 6.0f;
+			if (h < 0.0f) {
+				h += 1.0f;
+			}
+		}
+		return csc::Float4{ h, s, v, rgb.w };
+	}
+
+	static csc::Float4 hsv_to_rgb(const csc::Float4& hsv)
+	{
+		float h{ hsv.x };
+		const float s{ hsv.y };
+		const float v{ hsv.z };
+		if (s == 0.0f) {
+			return csc::Float4{ v, v, v, hsv.w };
+		}
+		if (h == 1.0f) {
+			h = 0.0f;
+		}
+		h *= 6.0f;
+		const float i{ std::floor(h) };
+		const float f{ h - i };
+		const float p{ v * (1.0f - s) };
+		const float q{ v * (1.0f - (s * f)) };
+		const float t{ v * (1.0f - (s * (1.0f - f))) };
+		if (i == 0.0f) {
+			return csc::Float4{ v, t, p, hsv.w };
+		}
+		else if (i == 1.0f) {
+			return csc::Float4{ q, v, p, hsv.w };
+		}
+		else if (i == 2.0f) {
+			return csc::Float4{ p, v, t, hsv.w };
+		}
+		else if (i == 3.0f) {
+			return csc::Float4{ p, q, v, hsv.w };
+		}
+		else if (i == 4.0f) {
+			return csc::Float4{ t, p, v, hsv.w };
+		}
+		return csc::Float4{ v, p, q, hsv.w };
+	}
+
+	//////
+	// converter/node_math.cginc, dispatched on the function name the shader calls
+	//////
+
+	static bool fold_math(const char* const fun, const float a, const float b, const float c, float& result)
+	{
+		if (std::strcmp(fun, "math_add") == 0) {
+			result = a + b;
+		}
+		else if (std::strcmp(fun, "math_subtract") == 0) {
+			result = a - b;
+		}
+		else if (std::strcmp(fun, "math_multiply") == 0) {
+			result = a * b;
+		}
+		else if (std::strcmp(fun, "math_divide") == 0) {
+			result = safe_divide(a, b);
+		}
+		else if (std::strcmp(fun, "math_power") == 0) {
+			if (a >= 0.0f) {
+				result = compatible_pow(a, b);
+			}
+			else {
+				const float fraction{ glsl_mod(std::fabs(b), 1.0f) };
+				result = (fraction > 0.999f || fraction < 0.001f) ? compatible_pow(a, std::floor(b + 0.5f)) : 0.0f;
+			}
+		}
+		else if (std::strcmp(fun, "math_logarithm") == 0) {
+			result = (a > 0.0f && b > 0.0f) ? std::log2(a) / std::log2(b) : 0.0f;
+		}
+		else if (std::strcmp(fun, "math_sqrt") == 0) {
+			result = (a > 0.0f) ? std::sqrt(a) : 0.0f;
+		}
+		else if (std::strcmp(fun, "math_absolute") == 0) {
+			result = std::fabs(a);
+		}
+		else if (std::strcmp(fun, "math_radians") == 0) {
+			result = a * (3.14159265358979f / 180.0f);
+		}
+		else if (std::strcmp(fun, "math_degrees") == 0) {
+			result = a * (180.0f / 3.14159265358979f);
+		}
+		else if (std::strcmp(fun, "math_minimum") == 0) {
+			result = std::min(a, b);
+		}
+		else if (std::strcmp(fun, "math_maximum") == 0) {
+			result = std::max(a, b);
+		}
+		else if (std::strcmp(fun, "math_less_than") == 0) {
+			result = (a < b) ? 1.0f : 0.0f;
+		}
+		else if (std::strcmp(fun, "math_greater_than") == 0) {
+			result = (a > b) ? 1.0f : 0.0f;
+		}
+		else if (std::strcmp(fun, "math_round") == 0) {
+			result = std::floor(a + 0.5f);
+		}
+		else if (std::strcmp(fun, "math_floor") == 0) {
+			result = std::floor(a);
+		}
+		else if (std::strcmp(fun, "math_ceil") == 0) {
+			result = std::ceil(a);
+		}
+		else if (std::strcmp(fun, "math_fraction") == 0) {
+			result = a - std::floor(a);
+		}
+		else if (std::strcmp(fun, "math_modulo") == 0) {
+			result = compatible_fmod(a, b);
+		}
+		else if (std::strcmp(fun, "math_snap") == 0) {
+			result = std::floor(safe_divide(a, b)) * b;
+		}
+		else if (std::strcmp(fun, "math_pingpong") == 0) {
+			result = (b != 0.0f) ? std::fabs(glsl_fract((a - b) / (b * 2.0f)) * b * 2.0f - b) : 0.0f;
+		}
+		else if (std::strcmp(fun, "math_wrap") == 0) {
+			result = wrap(a, b, c);
+		}
+		else if (std::strcmp(fun, "math_sine") == 0) {
+			result = std::sin(a);
+		}
+		else if (std::strcmp(fun, "math_cosine") == 0) {
+			result = std::cos(a);
+		}
+		else if (std::strcmp(fun, "math_tangent") == 0) {
+			result = std::tan(a);
+		}
+		else if (std::strcmp(fun, "math_sinh") == 0) {
+			result = std::sinh(a);
+		}
+		else if (std::strcmp(fun, "math_cosh") == 0) {
+			result = std::cosh(a);
+		}
+		else if (std::strcmp(fun, "math_tanh") == 0) {
+			result = std::tanh(a);
+		}
+		else if (std::strcmp(fun, "math_arcsine") == 0) {
+			result = (a <= 1.0f && a >= -1.0f) ? std::asin(a) : 0.0f;
+		}
+		else if (std::strcmp(fun, "math_arccosine") == 0) {
+			result = (a <= 1.0f && a >= -1.0f) ? std::acos(a) : 0.0f;
+		}
+		else if (std::strcmp(fun, "math_arctangent") == 0 || std::strcmp(fun, "math_arctan2") == 0) {
+			//the shader version of arctan2 ignores b as well
+			result = std::atan(a);
+		}
+		else if (std::strcmp(fun, "math_sign") == 0) {
+			result = glsl_sign(a);
+		}
+		else if (std::strcmp(fun, "math_exponent") == 0) {
+			result = std::exp(a);
+		}
+		else if (std::strcmp(fun, "math_compare") == 0) {
+			result = (std::fabs(a - b) <= std::max(c, 1e-5f)) ? 1.0f : 0.0f;
+		}
+		else if (std::strcmp(fun, "math_multiply_add") == 0) {
+			result = a * b + c;
+		}
+		else {
+			//no shader implementation with this name, leave it to the GPU compiler
+			return false;
+		}
+		return true;
+	}
+
+	//////
+	// converter/node_vector_math.cginc
+	//////
+
+	static bool fold_vector_math(const char* const fun,
+		const csc::Float4& a, const csc::Float4& b, const csc::Float4& c, const float scale,
+		csc::Float4& out_vector, float& out_value)
+	{
+		out_vector = csc::Float4{};
+		out_value = 0.0f;
+		if (std::strcmp(fun, "vector_math_add") == 0) {
+			out_vector = map3(a, b, [](float x, float y) { return x + y; });
+		}
+		else if (std::strcmp(fun, "vector_math_subtract") == 0) {
+			out_vector = map3(a, b, [](float x, float y) { return x - y; });
+		}
+		else if (std::strcmp(fun, "vector_math_multiply") == 0) {
+			out_vector = map3(a, b, [](float x, float y) { return x * y; });
+		}
+		else if (std::strcmp(fun, "vector_math_divide") == 0) {
+			out_vector = map3(a, b, safe_divide);
+		}
+		else if (std::strcmp(fun, "vector_math_cross") == 0) {
+			out_vector = csc::Float4{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x, 0.0f };
+		}
+		else if (std::strcmp(fun, "vector_math_project") == 0) {
+			const float len_squared{ dot3(b, b) };
+			out_vector = (len_squared != 0.0f) ? scale3(b, dot3(a, b) / len_squared) : csc::Float4{};
+		}
+		else if (std::strcmp(fun, "vector_math_reflect") == 0) {
+			const csc::Float4 n{ normalize3(b) };
+			const csc::Float4 reflected{ scale3(n, 2.0f * dot3(n, a)) };
+			out_vector = map3(a, reflected, [](float x, float y) { return x - y; });
+		}
+		else if (std::strcmp(fun, "vector_math_dot") == 0) {
+			out_value = dot3(a, b);
+		}
+		else if (std::strcmp(fun, "vector_math_distance") == 0) {
+			const csc::Float4 d{ map3(a, b, [](float x, float y) { return x - y; }) };
+			out_value = std::sqrt(dot3(d, d));
+		}
+		else if (std::strcmp(fun, "vector_math_length") == 0) {
+			out_value = std::sqrt(dot3(a, a));
+		}
+		else if (std::strcmp(fun, "vector_math_scale") == 0) {
+			out_vector = scale3(a, scale);
+		}
+		else if (std::strcmp(fun, "vector_math_normalize") == 0) {
+			const float len_squared{ dot3(a, a) };
+			out_vector = (len_squared > 0.0f) ? scale3(a, 1.0f / std::sqrt(len_squared)) : scale3(a, 1.0f);
+		}
+		else if (std::strcmp(fun, "vector_math_snap") == 0) {
+			out_vector = map3(a, b, [](float x, float y) { return std::floor(safe_divide(x, y)) * y; });
+		}
+		else if (std::strcmp(fun, "vector_math_floor") == 0) {
+			out_vector = map3(a, [](float x) { return std::floor(x); });
+		}
+		else if (std::strcmp(fun, "vector_math_ceil") == 0) {
+			out_vector = map3(a, [](float x) { return std::ceil(x); });
+		}
+		else if (std::strcmp(fun, "vector_math_modulo") == 0) {
+			out_vector = map3(a, b, compatible_fmod);
+		}
+		else if (std::strcmp(fun, "vector_math_fraction") == 0) {
+			out_vector = map3(a, glsl_fract);
+		}
+		else if (std::strcmp(fun, "vector_math_absolute") == 0) {
+			out_vector = map3(a, [](float x) { return std::fabs(x); });
+		}
+		else if (std::strcmp(fun, "vector_math_minimum") == 0) {
+			out_vector = map3(a, b, [](float x, float y) { return std::min(x, y); });
+		}
+		else if (std::strcmp(fun, "vector_math_maximum") == 0) {
+			out_vector = map3(a, b, [](float x, float y) { return std::max(x, y); });
+		}
+		else if (std::strcmp(fun, "vector_math_sine") == 0) {
+			out_vector = map3(a, [](float x) { return std::sin(x); });
+		}
+		else if (std::strcmp(fun, "vector_math_cosine") == 0) {
+			out_vector = map3(a, [](float x) { return std::cos(x); });
+		}
+		else if (std::strcmp(fun, "vector_math_tangent") == 0) {
+			out_vector = map3(a, [](float x) { return std::tan(x); });
+		}
+		else if (std::strcmp(fun, "vector_math_multiply_add") == 0) {
+			out_vector = csc::Float4{ a.x * b.x + c.x, a.y * b.y + c.y, a.z * b.z + c.z, 0.0f };
+		}
+		else {
+			return false;
+		}
+		return true;
+	}
+
+	//////
+	// converter/node_map_range.cginc, node_clamp.cginc
+	//////
+
+	static bool fold_map_range(const char* const fun,
+		const float value, const float from_min, const float from_max, const float to_min, const float to_max, const float steps,
+		float& result)
+	{
+		if (std::strcmp(fun, "map_range_linear") == 0) {
+			result = (from_max != from_min) ? to_min + ((value - from_min) / (from_max - from_min)) * (to_max - to_min) : 0.0f;
+		}
+		else if (std::strcmp(fun, "map_range_stepped") == 0) {
+			if (from_max != from_min) {
+				float factor{ (value - from_min) / (from_max - from_min) };
+				factor = (steps > 0.0f) ? std::floor(factor * (steps + 1.0f)) / steps : 0.0f;
+				result = to_min + factor * (to_max - to_min);
+			}
+			else {
+				result = 0.0f;
+			}
+		}
+		else if (std::strcmp(fun, "map_range_smoothstep") == 0) {
+			if (from_max != from_min) {
+				const float factor{ (from_min > from_max) ? 1.0f - glsl_smoothstep(from_max, from_min, value) :
+				                                            glsl_smoothstep(from_min, from_max, value) };
+				result = to_min + factor * (to_max - to_min);
+			}
+			else {
+				result = 0.0f;
+			}
+		}
+		else if (std::strcmp(fun, "map_range_smootherstep") == 0) {
+			if (from_max != from_min) {
+				const float factor{ (from_min > from_max) ? 1.0f - smootherstep(from_max, from_min, value) :
+				                                            smootherstep(from_min, from_max, value) };
+				result = to_min + factor * (to_max - to_min);
+			}
+			else {
+				result = 0.0f;
+			}
+		}
+		else {
+			return false;
+		}
+		return true;
+	}
+
+	static bool fold_clamp(const char* const fun, const float value, const float min, const float max, float& result)
+	{
+		if (std::strcmp(fun, "clamp_value") == 0) {
+			result = glsl_clamp(value, min, max);
+		}
+		else if (std::strcmp(fun, "clamp_minmax") == 0) {
+			result = std::min(std::max(value, min), max);
+		}
+		else if (std::strcmp(fun, "clamp_range") == 0) {
+			result = (max > min) ? glsl_clamp(value, min, max) : glsl_clamp(value, max, min);
+		}
+		else {
+			return false;
+		}
+		return true;
+	}
+
+	//////
+	// converter/node_blackbody.cginc
+	//////
+
+	static csc::Float4 blackbody(const float temperature)
+	{
+		float r{ 56100000.0f * std::pow(temperature, (-3.0f / 2.0f)) + 148.0f };
+		float g{ 100.04f * std::log(temperature) - 623.6f };
+		if (temperature > 6500.0f) {
+			g = 35200000.0f * std::pow(temperature, (-3.0f / 2.0f)) + 184.0f;
+		}
+		float b{ 194.18f * std::log(temperature) - 1448.6f };
+		r = glsl_clamp(r, 0.0f, 255.0f) / 255.0f;
+		g = glsl_clamp(g, 0.0f, 255.0f) / 255.0f;
+		b = glsl_clamp(b, 0.0f, 255.0f) / 255.0f;
+		if (temperature < 1000.0f) {
+			r *= temperature / 1000.0f;
+			g *= temperature / 1000.0f;
+			b *= temperature / 1000.0f;
+		}
+		return csc::Float4{ r, g, b, 1.0f };
+	}
+
+	//////
+	// ConstantFolder
+	//////
+
+	//the value code generation sends as the uniform for an unconnected slot
+	static boost::optional<csc::Float4> unconnected_value(const SlotValue& slot_value)
+	{
+		switch (slot_value.type()) {
+		case SlotType::BOOL:
+			return csc::Float4{ slot_value.as_ptr<BoolSlotValue>()->get() ? 1.0f : 0.0f, 0.0f, 0.0f, 0.0f };
+		case SlotType::FLOAT:
+			return csc::Float4{ slot_value.as_ptr<FloatSlotValue>()->get(), 0.0f, 0.0f, 0.0f };
+		case SlotType::INT:
+			return csc::Float4{ static_cast<float>(slot_value.as_ptr<IntSlotValue>()->get()), 0.0f, 0.0f, 0.0f };
+		case SlotType::COLOR:
+			return csc::Float4{ slot_value.as_ptr<ColorSlotValue>()->get(), 0.0f };
+		case SlotType::VECTOR:
+			return csc::Float4{ slot_value.as_ptr<VectorSlotValue>()->get(), 0.0f };
+		default:
+			return boost::none;
+		}
+	}
+
+	//same conversions ir::convert_operand applies in the shader
+	static csc::Float4 convert_value(const csc::Float4& value, const SlotType s_type, const SlotType d_type)
+	{
+		const bool s_scalar{ s_type == SlotType::FLOAT || s_type == SlotType::INT || s_type == SlotType::BOOL };
+		const bool d_scalar{ d_type == SlotType::FLOAT || d_type == SlotType::INT || d_type == SlotType::BOOL };
+		if (s_type == d_type || (s_scalar && d_scalar)) {
+			return value;
+		}
+		if (s_scalar) {
+			return csc::Float4{ value.x, value.x, value.x, value.x };
+		}
+		if (d_scalar) {
+			return csc::Float4{ value.x, 0.0f, 0.0f, 0.0f };
+		}
+		if (s_type == SlotType::VECTOR && d_type == SlotType::COLOR) {
+			return csc::Float4{ value.x, value.y, value.z, 1.0f };
+		}
+		return csc::Float4{ value.x, value.y, value.z, 0.0f };
+	}
+
+	bool is_foldable_node_type(const Node& node)
+	{
+		switch (node.type()) {
+		case NodeType::BLACKBODY:
+		case NodeType::CLAMP:
+		case NodeType::COMBINE_HSV:
+		case NodeType::COMBINE_RGB:
+		case NodeType::COMBINE_XYZ:
+		case NodeType::MAP_RANGE:
+		case NodeType::MATH:
+		case NodeType::RGB_TO_BW:
+		case NodeType::SEPARATE_HSV:
+		case NodeType::SEPARATE_RGB:
+		case NodeType::SEPARATE_XYZ:
+		case NodeType::VECTOR_MATH:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	const FoldedSlots* ConstantFolder::evaluate(const NodeId node_id)
+	{
+		const auto iter = folded.find(node_id);
+		if (iter != folded.end()) {
+			return iter->second ? &*iter->second : nullptr;
+		}
+		const std::shared_ptr<const Node> node{ graph.get(node_id) };
+		if (node == nullptr || is_foldable_node_type(*node) == false) {
+			folded[node_id] = boost::none;
+			return nullptr;
+		}
+		//mark first so a cycle ends up unfoldable instead of recursing forever
+		folded[node_id] = boost::none;
+		boost::optional<FoldedSlots> result{ fold(*node) };
+		folded[node_id] = std::move(result);
+		const boost::optional<FoldedSlots>& stored{ folded[node_id] };
+		return stored ? &*stored : nullptr;
+	}
+
+	boost::optional<FoldedSlots> ConstantFolder::fold(const Node& node)
+	{
+		//inputs in slot order, the same order the shader function takes them
+		std::vector<csc::Float4> in;
+		const char* fun{ "" };
+		for (size_t i = 0; i < node.slots().size(); i++) {
+			const Slot& slot{ node.slots()[i] };
+			if (slot.dir() == SlotDirection::OUTPUT) {
+				continue;
+			}
+			if (slot.type() == SlotType::ENUM) {
+				fun = node.slot_value_ptr(i)->as_ptr<EnumSlotValue>()->internal_name();
+				continue;
+			}
+			const Connection* const connection{ graph.find_connection(SlotId{ node.id(), i }) };
+			if (connection != nullptr) {
+				const FoldedSlots* const source{ evaluate(connection->source().node_id()) };
+				if (source == nullptr) {
+					return boost::none;
+				}
+				const std::shared_ptr<const Node> source_node{ graph.get(connection->source().node_id()) };
+				const SlotType source_type{ source_node->slot_ptr(connection->source().index())->type() };
+				in.push_back(convert_value((*source)[connection->source().index()], source_type, slot.type()));
+				continue;
+			}
+			const SlotValue* const slot_value{ node.slot_value_ptr(i) };
+			if (slot_value == nullptr || slot.getGPUVaryName() != nullptr) {
+				return boost::none;
+			}
+			const boost::optional<csc::Float4> value{ unconnected_value(*slot_value) };
+			if (value.has_value() == false) {
+				return boost::none;
+			}
+			in.push_back(*value);
+		}
+
+		std::vector<csc::Float4> out;
+		switch (node.type()) {
+		case NodeType::BLACKBODY:
+			out.push_back(blackbody(in[0].x));
+			break;
+		case NodeType::CLAMP:
+			{
+				float result;
+				if (fold_clamp(fun, in[0].x, in[1].x, in[2].x, result) == false) {
+					return boost::none;
+				}
+				out.push_back(csc::Float4{ result, 0.0f, 0.0f, 0.0f });
+			}
+			break;
+		case NodeType::COMBINE_HSV:
+			out.push_back(hsv_to_rgb(csc::Float4{ in[0].x, in[1].x, in[2].x, 1.0f }));
+			break;
+		case NodeType::COMBINE_RGB:
+		case NodeType::COMBINE_XYZ:
+			out.push_back(csc::Float4{ in[0].x, in[1].x, in[2].x, 1.0f });
+			break;
+		case NodeType::MAP_RANGE:
+			{
+				float result;
+				if (fold_map_range(fun, in[0].x, in[1].x, in[2].x, in[3].x, in[4].x, in[5].x, result) == false) {
+					return boost::none;
+				}
+				out.push_back(csc::Float4{ result, 0.0f, 0.0f, 0.0f });
+			}
+			break;
+		case NodeType::MATH:
+			{
+				float result;
+				if (fold_math(fun, in[0].x, in[1].x, in[2].x, result) == false) {
+					return boost::none;
+				}
+				out.push_back(csc::Float4{ result, 0.0f, 0.0f, 0.0f });
+			}
+			break;
+		case NodeType::RGB_TO_BW:
+			out.push_back(csc::Float4{ dot3(in[0], csc::Float4{ 0.2126f, 0.7152f, 0.0722f, 0.0f }), 0.0f, 0.0f, 0.0f });
+			break;
+		case NodeType::SEPARATE_HSV:
+			{
+				const csc::Float4 hsv{ rgb_to_hsv(in[0]) };
+				out.push_back(csc::Float4{ hsv.x, 0.0f, 0.0f, 0.0f });
+				out.push_back(csc::Float4{ hsv.y, 0.0f, 0.0f, 0.0f });
+				out.push_back(csc::Float4{ hsv.z, 0.0f, 0.0f, 0.0f });
+			}
+			break;
+		case NodeType::SEPARATE_RGB:
+		case NodeType::SEPARATE_XYZ:
+			out.push_back(csc::Float4{ in[0].x, 0.0f, 0.0f, 0.0f });
+			out.push_back(csc::Float4{ in[0].y, 0.0f, 0.0f, 0.0f });
+			out.push_back(csc::Float4{ in[0].z, 0.0f, 0.0f, 0.0f });
+			break;
+		case NodeType::VECTOR_MATH:
+			{
+				csc::Float4 out_vector;
+				float out_value;
+				if (fold_vector_math(fun, in[0], in[1], in[2], in[3].x, out_vector, out_value) == false) {
+					return boost::none;
+				}
+				out.push_back(out_vector);
+				out.push_back(csc::Float4{ out_value, 0.0f, 0.0f, 0.0f });
+			}
+			break;
+		default:
+			return boost::none;
+		}
+
+		//outputs come first in all of these nodes, in the same order as out
+		FoldedSlots slots(node.slots().size());
+		size_t out_index{ 0 };
+		for (size_t i = 0; i < node.slots().size() && out_index < out.size(); i++) {
+			if (node.slots()[i].dir() == SlotDirection::OUTPUT) {
+				slots[i] = out[out_index++];
+			}
+		}
+		return slots;
+	}
+}
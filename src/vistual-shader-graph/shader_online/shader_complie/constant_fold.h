@@ -0,0 +1,50 @@
+/*
+* Copyright 2021-2021 Zhouwei. All rights reserved.
+* License: https://github.com/zwluoqi/mobile-visual-shader-editor#license-bsd-2-clause
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief CPU versions of the converter node functions, used to fold nodes whose inputs are all constant.
+ */
+
+#include <map>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include "../shader_core/vector.h"
+
+#include "node_id.h"
+
+namespace csg {
+	class Graph;
+	class Node;
+	class SlotValue;
+
+	//Values of a node's slots as the shader sees them, indexed by slot index.
+	//Float slots use x, colors and vectors use xyz.
+	typedef std::vector<csc::Float4> FoldedSlots;
+
+	//Evaluates converter nodes (math, vector math, map range, clamp, combine/separate, rgb to bw, blackbody)
+	//whose inputs are unconnected or connected to other foldable nodes.
+	//The results match runtime_visual_shader/node/converter/*.cginc.
+	class ConstantFolder {
+	public:
+		explicit ConstantFolder(const Graph& graph) : graph{ graph } {}
+
+		//nullptr when the node has to be evaluated on the GPU
+		const FoldedSlots* evaluate(NodeId node_id);
+
+	private:
+		boost::optional<FoldedSlots> fold(const Node& node);
+
+		const Graph& graph;
+		std::map<NodeId, boost::optional<FoldedSlots>> folded;
+	};
+
+	//true for node types ConstantFolder has CPU versions of
+	bool is_foldable_node_type(const Node& node);
+}
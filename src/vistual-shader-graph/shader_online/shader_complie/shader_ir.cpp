@@ -0,0 +1,295 @@
+/*
+* Copyright 2021-2021 Zhouwei. All rights reserved.
+* License: https://github.com/zwluoqi/mobile-visual-shader-editor#license-bsd-2-clause
+*/
+
+#include "shader_ir.h"
+
+#include <cassert>
+#include <cctype>
+
+namespace csg {
+	namespace ir {
+
+		struct BuiltinName {
+			const char* name;
+			ValueKind kind;
+			Type type;
+		};
+
+		//names the prelude and the vertex shader define for the fragment main()
+		static const BuiltinName s_builtins[] =
+		{
+			{ "GPU_WORLD_POSITION",       ValueKind::Varying, Type::Vec3 },
+			{ "VERTEX_CD_MTFACE",         ValueKind::Varying, Type::Vec3 },
+			{ "VERTEX_CD_ORCO",           ValueKind::Varying, Type::Vec3 },
+			{ "GPU_WORLD_NORMAL",         ValueKind::Varying, Type::Vec3 },
+			{ "VERTEX_CD_TANGENT",        ValueKind::Varying, Type::Vec4 },
+			{ "vWorldToLight",            ValueKind::Varying, Type::Mat4 },
+			{ "vPositionFromLight",       ValueKind::Varying, Type::Vec4 },
+			{ "lightDir",                 ValueKind::Builtin, Type::Vec3 },
+			{ "lightRadiance",            ValueKind::Builtin, Type::Vec3 },
+			{ "viewDir",                  ValueKind::Builtin, Type::Vec3 },
+			{ "colorRamp",                ValueKind::Builtin, Type::Vec4 },
+			{ "GPU_VIEW_POSITION",        ValueKind::Builtin, Type::Vec3 },
+			{ "GPU_BARYCENTRIC_TEXCO",    ValueKind::Builtin, Type::Vec2 },
+			{ "GPU_BARYCENTRIC_DIST",     ValueKind::Builtin, Type::Vec3 },
+			{ "GPU_CAMERA_TEXCO_FACTORS", ValueKind::Builtin, Type::Vec4 },
+			{ "GPU_OBJECT_COLOR",         ValueKind::Builtin, Type::Vec4 },
+			{ "GPU_OBJECT_INFO",          ValueKind::Builtin, Type::Vec4 },
+			{ "GPU_OBJECT_MAT_INDEX",     ValueKind::Builtin, Type::Float },
+			{ "ramp_curve",               ValueKind::Builtin, Type::Sampler2D },
+		};
+
+		const char* type_name(const Type type)
+		{
+			switch (type) {
+			case Type::Float:
+				return "float";
+			case Type::Vec2:
+				return "vec2";
+			case Type::Vec3:
+				return "vec3";
+			case Type::Vec4:
+				return "vec4";
+			case Type::Mat3:
+				return "mat3";
+			case Type::Mat4:
+				return "mat4";
+			case Type::Sampler2D:
+				return "SAMPLER2D";
+			case Type::Closure:
+				return "Closure";
+			default:
+				assert(false);
+				return "[ERROR]";
+			}
+		}
+
+		Type slot_type(const SlotType type)
+		{
+			switch (type) {
+			case SlotType::CLOSURE:
+				return Type::Closure;
+			case SlotType::COLOR:
+				return Type::Vec4;
+			case SlotType::VECTOR:
+				return Type::Vec3;
+			case SlotType::IMAGE:
+				return Type::Sampler2D;
+			default:
+				return Type::Float;
+			}
+		}
+
+		Value Value::builtin(const std::string& name)
+		{
+			for (const BuiltinName& builtin : s_builtins) {
+				if (name == builtin.name) {
+					return Value{ builtin.kind, builtin.type, name };
+				}
+			}
+			return literal(Type::Float, name);
+		}
+
+		Operand convert_operand(const Value& value, const SlotType s_type, const SlotType d_type)
+		{
+			if (s_type == d_type) {
+				return Operand{ value };
+			}
+			const Type d_ir_type{ slot_type(d_type) };
+			switch (s_type) {
+			case SlotType::BOOL:
+			case SlotType::FLOAT:
+			case SlotType::INT:
+				switch (d_type) {
+				case SlotType::COLOR:
+				case SlotType::VECTOR:
+					return Operand{ value, Convert::Splat, d_ir_type };
+				case SlotType::FLOAT:
+				case SlotType::INT:
+				case SlotType::BOOL:
+					return Operand{ value };
+				default:
+					assert(false);
+					break;
+				}
+				break;
+			case SlotType::COLOR:
+				switch (d_type) {
+				case SlotType::FLOAT:
+				case SlotType::INT:
+				case SlotType::BOOL:
+					return Operand{ value, Convert::X, d_ir_type };
+				case SlotType::VECTOR:
+					return Operand{ value, Convert::XYZ, d_ir_type };
+				default:
+					assert(false);
+					break;
+				}
+				break;
+			case SlotType::VECTOR:
+				switch (d_type) {
+				case SlotType::FLOAT:
+				case SlotType::INT:
+				case SlotType::BOOL:
+					return Operand{ value, Convert::X, d_ir_type };
+				case SlotType::COLOR:
+					return Operand{ value, Convert::Extend, d_ir_type };
+				default:
+					break;
+				}
+				break;
+			default:
+				assert(false);
+				break;
+			}
+			return Operand{ value };
+		}
+
+		void collect_identifiers(const std::string& text, std::set<std::string>& names)
+		{
+			size_t i = 0;
+			while (i < text.size()) {
+				const unsigned char c = static_cast<unsigned char>(text[i]);
+				if (std::isalpha(c) || c == '_') {
+					const size_t begin = i;
+					while (i < text.size() && (std::isalnum(static_cast<unsigned char>(text[i])) || text[i] == '_')) {
+						i++;
+					}
+					names.insert(text.substr(begin, i - begin));
+				}
+				else if (std::isdigit(c) || c == '.') {
+					//skip numbers so suffixes like 1e5/1.0f are not taken as names
+					while (i < text.size() && (std::isalnum(static_cast<unsigned char>(text[i])) || text[i] == '.')) {
+						i++;
+					}
+				}
+				else {
+					i++;
+				}
+			}
+		}
+
+		static void mark_live(const Value& value, std::set<std::string>& live)
+		{
+			if (value.kind == ValueKind::Literal) {
+				collect_identifiers(value.name, live);
+			}
+			else {
+				live.insert(value.name);
+			}
+		}
+
+		static Value scratch_value(const Type type)
+		{
+			return Value{ ValueKind::Scratch, type, std::string{ "unused_" } + type_name(type) };
+		}
+
+		void eliminate_dead_code(Function& function, std::set<std::string>& live)
+		{
+			std::vector<bool> keep(function.ops.size(), false);
+			for (size_t i = function.ops.size(); i-- > 0;) {
+				const Op& op = function.ops[i];
+				bool needed = op.kind == OpKind::Output;
+				for (const Value& result : op.results) {
+					needed = needed || live.count(result.name) > 0;
+				}
+				if (!needed) {
+					continue;
+				}
+				keep[i] = true;
+				for (const Operand& arg : op.args) {
+					mark_live(arg.value, live);
+				}
+			}
+
+			std::vector<Op> ops;
+			std::vector<bool> has_scratch(static_cast<size_t>(Type::Count), false);
+			for (size_t i = 0; i < function.ops.size(); i++) {
+				if (!keep[i]) {
+					continue;
+				}
+				Op op = std::move(function.ops[i]);
+				if (op.kind == OpKind::Call) {
+					for (Value& result : op.results) {
+						if (live.count(result.name) > 0 || result.type == Type::Closure || result.type == Type::Sampler2D) {
+							continue;
+						}
+						has_scratch[static_cast<size_t>(result.type)] = true;
+						result = scratch_value(result.type);
+					}
+				}
+				ops.push_back(std::move(op));
+			}
+
+			std::vector<Op> scratch_ops;
+			for (size_t t = 0; t < has_scratch.size(); t++) {
+				if (has_scratch[t]) {
+					const Type type = static_cast<Type>(t);
+					scratch_ops.push_back(Op{ OpKind::Declare, -1, "", { Value::literal(type, std::string{ type_name(type) } + "(0.0)") }, { scratch_value(type) } });
+				}
+			}
+			ops.insert(ops.begin(), scratch_ops.begin(), scratch_ops.end());
+			function.ops = std::move(ops);
+		}
+
+		std::string to_glsl(const Operand& operand)
+		{
+			const std::string& name = operand.value.name;
+			switch (operand.convert) {
+			case Convert::None:
+				return name;
+			case Convert::Splat:
+				return std::string{ type_name(operand.type) } + "(" + name + ")";
+			case Convert::X:
+				return name + ".x";
+			case Convert::XYZ:
+				return name + ".xyz";
+			case Convert::Extend:
+				return std::string{ type_name(operand.type) } + "(" + name + ",1.0)";
+			}
+			return name;
+		}
+
+		void emit_glsl(const Op& op, std::ostream& out)
+		{
+			switch (op.kind) {
+			case OpKind::Declare:
+				out << type_name(op.results[0].type) << " " << op.results[0].name << "=" << to_glsl(op.args[0]) << ";\n";
+				break;
+			case OpKind::Call:
+				{
+					//out params are declared right before the call that writes them
+					for (const Value& result : op.results) {
+						if (result.kind != ValueKind::Scratch) {
+							out << " " << type_name(result.type) << " " << result.name << ";\n";
+						}
+					}
+					out << " " << op.fun << "(";
+					bool first = true;
+					for (const Operand& arg : op.args) {
+						out << (first ? "" : ",") << to_glsl(arg);
+						first = false;
+					}
+					for (const Value& result : op.results) {
+						out << (first ? "" : ",") << result.name;
+						first = false;
+					}
+					out << ");\n";
+				}
+				break;
+			case OpKind::Output:
+				out << " gl_FragColor = " << to_glsl(op.args[0]) << ".radiance;\n";
+				break;
+			}
+		}
+
+		void emit_glsl(const Function& function, std::ostream& out)
+		{
+			for (const Op& op : function.ops) {
+				emit_glsl(op, out);
+			}
+		}
+	}
+}
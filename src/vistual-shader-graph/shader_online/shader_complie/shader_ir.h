@@ -0,0 +1,137 @@
+/*
+* Copyright 2021-2021 Zhouwei. All rights reserved.
+* License: https://github.com/zwluoqi/mobile-visual-shader-editor#license-bsd-2-clause
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Typed intermediate representation the fragment code is lowered to before GLSL is printed.
+ *
+ * Every node becomes one or more Ops. Each temporary Value is defined by exactly one Op
+ * (a Call defines its out params, a Declare defines its target), so passes can rewrite
+ * or drop ops by looking at values alone before any text exists.
+ */
+
+#include <cstdint>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "node_id.h"
+#include "slot.h"
+
+namespace csg {
+	namespace ir {
+
+		enum class Type {
+			Float,
+			Vec2,
+			Vec3,
+			Vec4,
+			Mat3,
+			Mat4,
+			Sampler2D,
+			Closure,
+			Count,
+		};
+
+		const char* type_name(Type type);
+
+		//the type a slot is stored as in the generated code
+		Type slot_type(SlotType type);
+
+		enum class ValueKind {
+			Temp,    //defined by an op in the function
+			Uniform, //material parameter, declared in the shader head
+			Varying, //interpolated from the vertex shader
+			Builtin, //defined by the generator prelude (lightDir, GPU_VIEW_POSITION, ramp_curve...)
+			Literal, //constant text, e.g. a ramp row index
+			Scratch, //out param nobody reads, declared once per type at the top of main()
+		};
+
+		struct Value {
+			ValueKind kind;
+			Type type;
+			std::string name;
+
+			static Value temp(Type type, const std::string& name) { return Value{ ValueKind::Temp, type, name }; }
+			static Value uniform(Type type, const std::string& name) { return Value{ ValueKind::Uniform, type, name }; }
+			static Value varying(Type type, const std::string& name) { return Value{ ValueKind::Varying, type, name }; }
+			static Value literal(Type type, const std::string& text) { return Value{ ValueKind::Literal, type, text }; }
+
+			//prelude names and varyings are looked up, anything else is treated as a float literal
+			static Value builtin(const std::string& name);
+		};
+
+		//implicit conversion applied where a slot is connected to a slot of another type
+		enum class Convert {
+			None,
+			Splat,  //float -> vec3/vec4
+			X,      //vec -> float
+			XYZ,    //vec4 -> vec3
+			Extend, //vec3 -> vec4, w = 1
+		};
+
+		struct Operand {
+			Value value;
+			Convert convert;
+			Type type;//type after the conversion
+
+			Operand(const Value& _value) : value{ _value }, convert{ Convert::None }, type{ _value.type } {}
+			Operand(const Value& _value, Convert _convert, Type _type) : value{ _value }, convert{ _convert }, type{ _type } {}
+		};
+
+		//conversion the generator applies between two slot types
+		Operand convert_operand(const Value& value, SlotType s_type, SlotType d_type);
+
+		enum class OpKind {
+			Declare, //results[0] = args[0]
+			Call,    //fun(args..., out results...)
+			Output,  //gl_FragColor = args[0].radiance
+		};
+
+		struct Op {
+			OpKind kind;
+			NodeId node;//node the op was generated for, -1 for the prelude
+			std::string fun;
+			std::vector<Operand> args;
+			std::vector<Value> results;
+		};
+
+		class Function {
+		public:
+			std::vector<Op> ops;
+
+			void declare(NodeId node, const Value& result, const Operand& init)
+			{
+				ops.push_back(Op{ OpKind::Declare, node, "", { init }, { result } });
+			}
+
+			void call(NodeId node, const std::string& fun, std::vector<Operand>&& args, std::vector<Value>&& results)
+			{
+				ops.push_back(Op{ OpKind::Call, node, fun, std::move(args), std::move(results) });
+			}
+
+			void output(NodeId node, const Operand& surface)
+			{
+				ops.push_back(Op{ OpKind::Output, node, "", { surface }, {} });
+			}
+		};
+
+		//identifiers appearing in a piece of GLSL text, e.g. the varyings a prelude expression reads
+		void collect_identifiers(const std::string& text, std::set<std::string>& names);
+
+		//Liveness pass, walks the ops backwards from the Output op.
+		//Ops none of whose results are read are dropped, unread out params of the remaining calls
+		//are pointed at one scratch variable per type. Every name the remaining ops read is added to live.
+		void eliminate_dead_code(Function& function, std::set<std::string>& live);
+
+		//GLSL backend
+		std::string to_glsl(const Operand& operand);
+		void emit_glsl(const Op& op, std::ostream& out);
+		void emit_glsl(const Function& function, std::ostream& out);
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace csc {
+
+	// Content hashes are 64-bit FNV-1a so they are stable between runs and platforms
+	constexpr uint64_t HASH_SEED{ 0xcbf29ce484222325ULL };
+
+	inline uint64_t hash_bytes(const void* const data, const size_t size, uint64_t hash = HASH_SEED)
+	{
+		const unsigned char* const bytes{ static_cast<const unsigned char*>(data) };
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ULL;
+		}
+		return hash;
+	}
+
+	// Only use with types that have no padding, otherwise the padding bytes leak into the hash
+	template <typename T> uint64_t hash_value(const T& value, const uint64_t hash = HASH_SEED)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "hash_value requires a trivially copyable type");
+		return hash_bytes(&value, sizeof(T), hash);
+	}
+
+	// Scrambles a hash so that it can be summed with others into an order-independent aggregate
+	inline uint64_t hash_mix(uint64_t hash)
+	{
+		hash ^= hash >> 30;
+		hash *= 0xbf58476d1ce4e5b9ULL;
+		hash ^= hash >> 27;
+		hash *= 0x94d049bb133111ebULL;
+		hash ^= hash >> 31;
+		return hash;
+	}
+}
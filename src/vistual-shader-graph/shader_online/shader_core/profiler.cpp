@@ -0,0 +1,104 @@
+#include "profiler.h"
+
+#include <chrono>
+#include <sstream>
+
+namespace {
+	uint32_t this_thread_index()
+	{
+		static std::atomic<uint32_t> next_index{ 0 };
+		thread_local const uint32_t index{ next_index++ };
+		return index;
+	}
+}
+
+void csc::ProfileRing::push(const ProfileEvent& event)
+{
+	const uint64_t index{ head.fetch_add(1, std::memory_order_relaxed) };
+	Slot& slot{ slots[index % CAPACITY] };
+	slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.name.store(event.name, std::memory_order_relaxed);
+	slot.thread.store(event.thread, std::memory_order_relaxed);
+	slot.begin_ns.store(event.begin_ns, std::memory_order_relaxed);
+	slot.end_ns.store(event.end_ns, std::memory_order_relaxed);
+	slot.sequence.store(2 * index + 2, std::memory_order_release);
+}
+
+std::vector<csc::ProfileEvent> csc::ProfileRing::snapshot() const
+{
+	const uint64_t end{ head.load(std::memory_order_acquire) };
+	uint64_t begin{ tail.load(std::memory_order_relaxed) };
+	if (end - begin > CAPACITY) {
+		begin = end - CAPACITY;
+	}
+
+	std::vector<ProfileEvent> events;
+	events.reserve(static_cast<size_t>(end - begin));
+	for (uint64_t index = begin; index < end; index++) {
+		const Slot& slot{ slots[index % CAPACITY] };
+		const uint64_t expected{ 2 * index + 2 };
+		if (slot.sequence.load(std::memory_order_acquire) != expected) {
+			// still being written, or already overwritten by a newer event
+			continue;
+		}
+		ProfileEvent event;
+		event.name = slot.name.load(std::memory_order_relaxed);
+		event.thread = slot.thread.load(std::memory_order_relaxed);
+		event.begin_ns = slot.begin_ns.load(std::memory_order_relaxed);
+		event.end_ns = slot.end_ns.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) == expected) {
+			events.push_back(event);
+		}
+	}
+	return events;
+}
+
+void csc::ProfileRing::clear()
+{
+	tail.store(head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+csc::ProfileRing& csc::profile_ring()
+{
+	static ProfileRing ring;
+	return ring;
+}
+
+int64_t csc::profile_now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void csc::profile_record(const char* const name, const int64_t begin_ns, const int64_t end_ns)
+{
+	profile_ring().push(ProfileEvent{ name, this_thread_index(), begin_ns, end_ns });
+}
+
+std::string csc::profile_chrome_trace(const std::vector<ProfileEvent>& events)
+{
+	int64_t origin_ns{ 0 };
+	for (const ProfileEvent& event : events) {
+		if (origin_ns == 0 || event.begin_ns < origin_ns) {
+			origin_ns = event.begin_ns;
+		}
+	}
+
+	std::stringstream out;
+	out.setf(std::ios::fixed);
+	out.precision(3);
+	out << "{\"traceEvents\":[";
+	bool first{ true };
+	for (const ProfileEvent& event : events) {
+		// names are literals without quotes or backslashes, no escaping needed
+		out << (first ? "\n" : ",\n");
+		out << "{\"name\":\"" << event.name << "\",\"cat\":\"vsg\",\"ph\":\"X\",\"pid\":1"
+			<< ",\"tid\":" << event.thread
+			<< ",\"ts\":" << (event.begin_ns - origin_ns) / 1000.0
+			<< ",\"dur\":" << (event.end_ns - event.begin_ns) / 1000.0 << "}";
+		first = false;
+	}
+	out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	return out.str();
+}
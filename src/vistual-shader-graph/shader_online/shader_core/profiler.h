@@ -0,0 +1,88 @@
+#pragma once
+
+/**
+ * @file
+ * @brief Defines the compile pipeline profiler: scoped phase timers recorded into a lock-free ring.
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace csc {
+
+	struct ProfileEvent {
+		const char* name; // must be a string literal, only the pointer is stored
+		uint32_t thread;  // small per-thread index, 0 is the first thread that recorded
+		int64_t begin_ns; // steady_clock
+		int64_t end_ns;
+	};
+
+	/**
+	 * @brief Fixed size ring of the most recent events.
+	 *
+	 * Any number of threads may push at once and never block or allocate, the oldest events are overwritten.
+	 * Each slot carries a sequence number, so a snapshot taken while a slot is being rewritten skips it
+	 * instead of returning a torn event.
+	 */
+	class ProfileRing {
+	public:
+		static constexpr size_t CAPACITY{ 4096 };
+
+		void push(const ProfileEvent& event);
+
+		// Events still in the ring, oldest first
+		std::vector<ProfileEvent> snapshot() const;
+
+		void clear();
+
+	private:
+		struct Slot {
+			std::atomic<uint64_t> sequence{ 0 }; // 2 * (index + 1) once written, odd while being written
+			std::atomic<const char*> name{ nullptr };
+			std::atomic<uint32_t> thread{ 0 };
+			std::atomic<int64_t> begin_ns{ 0 };
+			std::atomic<int64_t> end_ns{ 0 };
+		};
+
+		std::atomic<uint64_t> head{ 0 };
+		std::atomic<uint64_t> tail{ 0 }; // first index clear() left visible
+		Slot slots[CAPACITY];
+	};
+
+	// The ring every phase timer records into
+	ProfileRing& profile_ring();
+
+	int64_t profile_now_ns();
+
+	void profile_record(const char* name, int64_t begin_ns, int64_t end_ns);
+
+	/**
+	 * @brief Records the time between construction and stop() or destruction.
+	 */
+	class ProfileScope {
+	public:
+		explicit ProfileScope(const char* name) : name{ name }, begin_ns{ profile_now_ns() } {}
+		~ProfileScope() { stop(); }
+
+		ProfileScope(const ProfileScope&) = delete;
+		ProfileScope& operator=(const ProfileScope&) = delete;
+
+		void stop()
+		{
+			if (name != nullptr) {
+				profile_record(name, begin_ns, profile_now_ns());
+				name = nullptr;
+			}
+		}
+
+	private:
+		const char* name;
+		int64_t begin_ns;
+	};
+
+	// Chrome trace event JSON ("X" complete events), opens in chrome://tracing or ui.perfetto.dev
+	std::string profile_chrome_trace(const std::vector<ProfileEvent>& events);
+}
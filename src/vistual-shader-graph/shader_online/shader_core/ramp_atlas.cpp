@@ -0,0 +1,158 @@
+#include "ramp_atlas.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "hash.h"
+
+csc::RampAtlas::RampAtlas(const uint32_t initial_rows, const uint32_t max_rows) :
+	max_rows{ std::max(max_rows, 1u) },
+	row_count{ std::min(std::max(initial_rows, 1u), this->max_rows) },
+	pixels(size_t(row_count) * WIDTH, 0),
+	row_info(row_count, Row{ 0, 0 })
+{
+	for (uint32_t row = row_count; row > 0; row--) {
+		free_rows.push_back(row - 1);
+	}
+}
+
+size_t csc::RampAtlas::OwnerIdHash::operator()(const OwnerId& owner) const
+{
+	return static_cast<size_t>(hash_value(owner.index, hash_value(owner.node)));
+}
+
+int32_t csc::RampAtlas::assign(const OwnerId& owner, const uint32_t* const content)
+{
+	const uint64_t hash{ hash_bytes(content, WIDTH * sizeof(uint32_t)) };
+	const auto current{ owners.find(owner) };
+	if (current != owners.end()) {
+		Owner& owned{ current->second };
+		owned.sweep = sweep;
+		if (same_content(owned.row, content)) {
+			return static_cast<int32_t>(owned.row);
+		}
+		const int32_t shared{ find_row(hash, content) };
+		if (shared < 0 && row_info[owned.row].refs == 1) {
+			// only this owner uses the row, edit it in place so the row index stays the same
+			write_row(owned.row, hash, content);
+			return static_cast<int32_t>(owned.row);
+		}
+		unref_row(owned.row);
+		owners.erase(current);
+	}
+
+	int32_t row{ find_row(hash, content) };
+	if (row < 0) {
+		row = alloc_row();
+		if (row < 0) {
+			return -1;
+		}
+		write_row(static_cast<uint32_t>(row), hash, content);
+	}
+	row_info[row].refs++;
+	owners[owner] = Owner{ static_cast<uint32_t>(row), sweep };
+	return row;
+}
+
+void csc::RampAtlas::release(const OwnerId& owner)
+{
+	const auto found{ owners.find(owner) };
+	if (found == owners.end()) {
+		return;
+	}
+	unref_row(found->second.row);
+	owners.erase(found);
+}
+
+void csc::RampAtlas::begin_sweep()
+{
+	sweep++;
+}
+
+void csc::RampAtlas::end_sweep()
+{
+	for (auto it = owners.begin(); it != owners.end();) {
+		if (it->second.sweep != sweep) {
+			unref_row(it->second.row);
+			it = owners.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+}
+
+void csc::RampAtlas::clear_dirty()
+{
+	dirty_begin = 0;
+	dirty_end = 0;
+}
+
+bool csc::RampAtlas::same_content(const uint32_t row, const uint32_t* const content) const
+{
+	return std::memcmp(&pixels[size_t(row) * WIDTH], content, WIDTH * sizeof(uint32_t)) == 0;
+}
+
+int32_t csc::RampAtlas::find_row(const uint64_t hash, const uint32_t* const content) const
+{
+	const auto found{ rows_by_hash.find(hash) };
+	if (found == rows_by_hash.end() || row_info[found->second].refs == 0 || !same_content(found->second, content)) {
+		return -1;
+	}
+	return static_cast<int32_t>(found->second);
+}
+
+int32_t csc::RampAtlas::alloc_row()
+{
+	if (free_rows.empty()) {
+		if (row_count >= max_rows) {
+			return -1;
+		}
+		const uint32_t new_count{ std::min(row_count * 2, max_rows) };
+		pixels.resize(size_t(new_count) * WIDTH, 0);
+		row_info.resize(new_count, Row{ 0, 0 });
+		for (uint32_t row = new_count; row > row_count; row--) {
+			free_rows.push_back(row - 1);
+		}
+		row_count = new_count;
+	}
+	const uint32_t row{ free_rows.back() };
+	free_rows.pop_back();
+	return static_cast<int32_t>(row);
+}
+
+void csc::RampAtlas::write_row(const uint32_t row, const uint64_t hash, const uint32_t* const content)
+{
+	const auto previous{ rows_by_hash.find(row_info[row].hash) };
+	if (previous != rows_by_hash.end() && previous->second == row) {
+		rows_by_hash.erase(previous);
+	}
+	std::memcpy(&pixels[size_t(row) * WIDTH], content, WIDTH * sizeof(uint32_t));
+	row_info[row].hash = hash;
+	// a hash collision keeps the first row, the second one just is not shared
+	rows_by_hash.emplace(hash, row);
+	mark_dirty(row);
+}
+
+void csc::RampAtlas::unref_row(const uint32_t row)
+{
+	if (--row_info[row].refs > 0) {
+		return;
+	}
+	const auto indexed{ rows_by_hash.find(row_info[row].hash) };
+	if (indexed != rows_by_hash.end() && indexed->second == row) {
+		rows_by_hash.erase(indexed);
+	}
+	free_rows.push_back(row);
+}
+
+void csc::RampAtlas::mark_dirty(const uint32_t row)
+{
+	if (!dirty()) {
+		dirty_begin = row;
+		dirty_end = row + 1;
+		return;
+	}
+	dirty_begin = std::min(dirty_begin, row);
+	dirty_end = std::max(dirty_end, row + 1);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+/**
+ * @file
+ * @brief Defines RampAtlas, the CPU side of the ramp_curve texture shared by curve, ramp and wavelength slots.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace csc {
+
+	/**
+	 * @brief Growable table of RGBA8 rows, WIDTH texels each, one row per distinct content.
+	 *
+	 * Every row is owned by one or more slots. Owners with identical content share a row, found through a
+	 * content hash. A row returns to the free list once its last owner moves to other content or is swept.
+	 * When no row is free the table doubles, up to max_rows. The caller re-creates the texture when rows()
+	 * changes and otherwise uploads the dirty range.
+	 */
+	class RampAtlas {
+	public:
+		static constexpr uint32_t WIDTH{ 256 };
+
+		// Slot holding a row, the full node id and slot index so that no two slots share a key
+		struct OwnerId {
+			int64_t node;
+			uint64_t index;
+
+			bool operator==(const OwnerId& other) const { return node == other.node && index == other.index; }
+		};
+
+		explicit RampAtlas(uint32_t initial_rows = 32, uint32_t max_rows = 4096);
+
+		// Row now holding pixels (WIDTH texels) for owner, -1 if all max_rows rows hold other content
+		int32_t assign(const OwnerId& owner, const uint32_t* pixels);
+		void release(const OwnerId& owner);
+
+		// Owners not assigned between begin_sweep() and end_sweep() are released, one sweep per compile
+		void begin_sweep();
+		void end_sweep();
+
+		uint32_t rows() const { return row_count; }
+		uint32_t used_rows() const { return row_count - static_cast<uint32_t>(free_rows.size()); }
+		const uint32_t* data() const { return pixels.data(); }
+
+		bool dirty() const { return dirty_begin < dirty_end; }
+		uint32_t dirty_first_row() const { return dirty_begin; }
+		uint32_t dirty_row_count() const { return dirty_end - dirty_begin; }
+		void clear_dirty();
+
+	private:
+		struct Row {
+			uint64_t hash;
+			uint32_t refs;
+		};
+		struct Owner {
+			uint32_t row;
+			uint32_t sweep;
+		};
+		struct OwnerIdHash {
+			size_t operator()(const OwnerId& owner) const;
+		};
+
+		bool same_content(uint32_t row, const uint32_t* content) const;
+		int32_t find_row(uint64_t hash, const uint32_t* content) const;
+		int32_t alloc_row();
+		void write_row(uint32_t row, uint64_t hash, const uint32_t* content);
+		void unref_row(uint32_t row);
+		void mark_dirty(uint32_t row);
+
+		const uint32_t max_rows;
+		uint32_t row_count;
+		std::vector<uint32_t> pixels;
+		std::vector<Row> row_info;
+		std::vector<uint32_t> free_rows; // rows without owners, popped from the back
+		std::unordered_map<uint64_t, uint32_t> rows_by_hash;
+		std::unordered_map<OwnerId, Owner, OwnerIdHash> owners;
+		uint32_t sweep{ 0 };
+		uint32_t dirty_begin{ 0 };
+		uint32_t dirty_end{ 0 };
+	};
+}
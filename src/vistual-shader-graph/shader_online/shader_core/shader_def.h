@@ -5,20 +5,28 @@
  * @brief Defines Float2, Float3, and Int2.
  */
 
+#include <algorithm>
 #include <array>
 #include <cmath>
 #include <cstddef>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "vector.h"
 #include "bgfx_utils.h"
+#include "texture_decode_pool.h"
+#include "ramp_atlas.h"
 
 namespace csc {
 
 
     #define MAX_COLOR_BAND 256
-    #define CM_TABLE 32
+    #define CM_TABLE 32//ramp_curve初始行数, 不够时翻倍
+    static_assert(MAX_COLOR_BAND == RampAtlas::WIDTH, "ramp rows are MAX_COLOR_BAND texels wide");
+    
+    //图片贴图默认最多占用的显存, 超出时淘汰最久没用的
+    constexpr uint64_t DEFAULT_TEXTURE_BUDGET = 256ull << 20;
 
     struct ShaderDataType{
         enum  Enum{
@@ -84,18 +92,39 @@ namespace csc {
           UniformUnionData(const TextureData& f4):defaultTextureData{f4}{}
           //mat3 mat4 暂时不支持
    };
+    //打包模式下float/vec2/vec3/vec4参数共用的uniform数组, 不叫u_params免得和nanovg的同名uniform混在一起
+    static const char* const PACKED_PARAMS_NAME = "u_graphParams";
+    //参数表最前面两项固定是ramp贴图和它的行数, 不属于哪个槽, 换贴图时按下标直接改
+    static const char* const RAMP_CURVE_SIZE_NAME = "u_rampCurveSize";
+    constexpr uint16_t RAMP_CURVE_UNIFORM_INDEX = 0;
+    constexpr uint16_t RAMP_CURVE_SIZE_UNIFORM_INDEX = 1;
+    
+    //参数打包时占几个float, 其他类型不打包返回0
+    inline uint8_t packed_component_count(UniformType::Enum type){
+        switch (type) {
+            case UniformType::Float: return 1;
+            case UniformType::Vec2: return 2;
+            case UniformType::Vec3: return 3;
+            case UniformType::Vec4: return 4;
+            default: return 0;
+        }
+    }
+    
     struct UniformData {
-        uint64_t uniformId;
+        uint16_t uniformIndex;//在这次生成的参数表里的下标, 改值时按它直接定位
         UniformType::Enum uniformType;
         UniformUnionData uniformUnionData;
         char uniformName[64];
+        uint16_t num = 1;//数组长度, 只有PACKED_PARAMS_NAME会大于1
+        int32_t packedOffset = -1;//>=0时没有自己的uniform, 值在打包数组的第packedOffset个float开始
     };
 
     struct UniformChangeData{
-        uint64_t uniformId;
+        uint16_t uniformIndex;
+        uint32_t layoutVersion;//下标属于哪一次生成的参数表, 和当前program不是同一次的不能直接用
         UniformUnionData uniformUnionData;
-        UniformChangeData(uint64_t _id,const Float4 f4):uniformId{_id},uniformUnionData{f4}{}
-        UniformChangeData(uint64_t _id,const TextureData f4):uniformId{_id},uniformUnionData{f4}{}
+        UniformChangeData(uint16_t _index,uint32_t _version,const Float4 f4):uniformIndex{_index},layoutVersion{_version},uniformUnionData{f4}{}
+        UniformChangeData(uint16_t _index,uint32_t _version,const TextureData f4):uniformIndex{_index},layoutVersion{_version},uniformUnionData{f4}{}
         UniformChangeData(){
             
         }
@@ -104,101 +133,255 @@ namespace csc {
     struct GraphMaterialTextureData{
         bgfx::TextureHandle handle;//本地存储的全局采样ID
         bgfx::TextureInfo textureInfo;
+        bool loading = false;//还在后台解码, handle和textureInfo是占位图的
+        bool owned = false;//handle是解码后建的, 淘汰时要销毁, 占位图不算
+        uint32_t refs = 0;//还可能被Scene用到的参数表引用了几次, 不为0时不淘汰
+        uint64_t lastUsedFrame = 0;
     };
 
     struct MaterialShaderContext{
         
-        MaterialShaderContext(){
-            m_curveRampTexture.handle =
-                        bgfx::createTexture2D(
-              MAX_COLOR_BAND
-            , CM_TABLE + 1
-            , false
-            , 1
-            , bgfx::TextureFormat::RGBA8
-            , BGFX_TEXTURE_NONE
-                                  );
+        MaterialShaderContext():rampAtlas{CM_TABLE}{
+            CreateRampTexture();
 
             auto _info = &m_curveRampTexture.textureInfo;
             _info->format  = bgfx::TextureFormat::RGBA8;
             _info->width   = MAX_COLOR_BAND;
-            _info->height  = CM_TABLE + 1;
+            _info->height  = rampAtlas.rows();
             
-            m_curveRampUniformId = 1;
 //            _info->depth   = _depth;
 //            _info->numMips = numMips;
 //            _info->numLayers = _numLayers;
 //            _info->cubeMap   = _cubeMap;
 //            _info->storageSize  = size;
 //            _info->bitsPerPixel = bpp;
+            
+            //图片解码完之前先用灰色占位
+            const uint32_t placeholderPixels[4] = {0xff808080,0xff808080,0xff808080,0xff808080};
+            m_placeholderTexture.handle = bgfx::createTexture2D(2, 2, false, 1, bgfx::TextureFormat::RGBA8, BGFX_TEXTURE_NONE|BGFX_SAMPLER_NONE, bgfx::copy(placeholderPixels, sizeof(placeholderPixels)));
+            m_placeholderTexture.textureInfo = m_curveRampTexture.textureInfo;
+            m_placeholderTexture.textureInfo.width = 2;
+            m_placeholderTexture.textureInfo.height = 2;
         }
         
-        void UpdateLayerRampBuffer(uint32_t* source,int layer){
-            uint32_t* dest = m_curveRampBuffer[layer];
-            memcpy(dest, source, sizeof(uint32_t) * (MAX_COLOR_BAND));
-
-            bgfx::updateTexture2D(
-                                 m_curveRampTexture.handle
-                               , 0
-                               , 0
-                               , 0
-                               , 0
-                               , MAX_COLOR_BAND
-                               , CM_TABLE + 1
-                               , bgfx::makeRef(m_curveRampBuffer, (MAX_COLOR_BAND)*(CM_TABLE + 1)*sizeof(uint32_t))
-                               );
-            
+        //owner是用这一行的槽, 内容相同的槽共用一行, 返回行号, 满了返回-1
+        int32_t AssignRampRow(const RampAtlas::OwnerId& owner,const uint32_t* pixels){
+            return rampAtlas.assign(owner, pixels);
+        }
+        
+        //每次生成代码前后各调用一次, 这次没再用到的槽的行回收
+        void BeginRampRows(){
+            rampAtlas.begin_sweep();
+        }
+        
+        void EndRampRows(){
+            rampAtlas.end_sweep();
+        }
+        
+        //改过的行传给贴图, 行数变了就换一张新贴图, 返回true
+        //旧贴图可能还在Scene的参数表里, layoutVersion之后的参数表换上后再销毁
+        bool SyncRampTexture(uint32_t layoutVersion){
+            if(rampAtlas.rows() != rampTextureRows){
+                retiredRampTextures.push_back(std::make_pair(layoutVersion, m_curveRampTexture.handle));
+                CreateRampTexture();
+                m_curveRampTexture.textureInfo.height = rampAtlas.rows();
+                return true;
+            }
+            if(rampAtlas.dirty()){
+                const uint32_t first = rampAtlas.dirty_first_row();
+                const uint32_t count = rampAtlas.dirty_row_count();
+                bgfx::updateTexture2D(
+                                     m_curveRampTexture.handle
+                                   , 0
+                                   , 0
+                                   , 0
+                                   , first
+                                   , MAX_COLOR_BAND
+                                   , count
+                                   , bgfx::copy(rampAtlas.data() + first * MAX_COLOR_BAND, count * MAX_COLOR_BAND * sizeof(uint32_t))
+                                   );
+                rampAtlas.clear_dirty();
+            }
+            return false;
+        }
+        
+        //x: 行数, y: 1/行数, shader里用RAMP_CURVE_ROW把行号换成纹理坐标
+        Float4 GetRampCurveSize(){
+            return Float4(float(rampTextureRows), 1.0f / float(rampTextureRows), 0.0f, 0.0f);
+        }
+        
+        void DestroyRetiredRampTextures(uint32_t appliedLayoutVersion){
+            while(!retiredRampTextures.empty() && retiredRampTextures.front().first < appliedLayoutVersion){
+                bgfx::destroy(retiredRampTextures.front().second);
+                retiredRampTextures.erase(retiredRampTextures.begin());
+            }
+        }
+        
+        void CreateRampTexture(){
+            rampTextureRows = rampAtlas.rows();
+            m_curveRampTexture.handle =
+                        bgfx::createTexture2D(
+              MAX_COLOR_BAND
+            , uint16_t(rampTextureRows)
+            , false
+            , 1
+            , bgfx::TextureFormat::RGBA8
+            , BGFX_TEXTURE_NONE
+            , bgfx::copy(rampAtlas.data(), rampTextureRows * MAX_COLOR_BAND * sizeof(uint32_t))
+                                  );
+            rampAtlas.clear_dirty();
         }
         
         //图片映射采样UID
         std::map<std::string,std::shared_ptr<GraphMaterialTextureData>> fileImage2SamplerUids;
+        //编辑器预览用的小图, 和材质用的原图分开
+        std::map<std::string,std::shared_ptr<GraphMaterialTextureData>> fileImage2PreviewUids;
         //默认贴图
         GraphMaterialTextureData m_curveRampTexture;
-        uint64_t m_curveRampUniformId;
-        uint32_t m_curveRampBuffer[CM_TABLE + 1 ][MAX_COLOR_BAND];
+        GraphMaterialTextureData m_placeholderTexture;
+        TextureDecodePool decodePool;
+        RampAtlas rampAtlas;
+        uint32_t rampTextureRows = 0;
+        std::vector<std::pair<uint32_t,bgfx::TextureHandle>> retiredRampTextures;
         
-        std::map<uint64_t,uint16_t> slot2Layers;
+        std::vector<DecodedImage> decodedImages;
         
-        void SetSlotLayer(uint64_t slotId,uint16_t layer){
-            slot2Layers[slotId] = layer;
-        }
+        uint64_t frameIndex = 0;
+        uint64_t residentBytes = 0;//所有owned贴图的storageSize
+        uint64_t textureBudget = DEFAULT_TEXTURE_BUDGET;
         
-        uint16_t GetSlotLayer(uint64_t slotId){
-            if(slot2Layers.count(slotId) ==0){
-                return 0;
-            }else{
-                return slot2Layers.at(slotId);
+        struct EvictCandidate{
+            uint64_t lastUsedFrame;
+            bool preview;
+            std::string path;
+        };
+        std::vector<EvictCandidate> evictCandidates;
+        
+        //超出预算时从最久没用的开始销毁没有引用的贴图, 上一帧还画过的不动
+        //被淘汰的图片再用到时重新解码
+        void evictTextures(){
+            if(residentBytes <= textureBudget){
+                return;
+            }
+            evictCandidates.clear();
+            for (const auto& entry : fileImage2SamplerUids) {
+                const auto& tex = entry.second;
+                if(tex->owned && tex->refs == 0 && tex->lastUsedFrame + 1 < frameIndex){
+                    evictCandidates.push_back(EvictCandidate{tex->lastUsedFrame,false,entry.first});
+                }
+            }
+            for (const auto& entry : fileImage2PreviewUids) {
+                const auto& tex = entry.second;
+                if(tex->owned && tex->lastUsedFrame + 1 < frameIndex){
+                    evictCandidates.push_back(EvictCandidate{tex->lastUsedFrame,true,entry.first});
+                }
+            }
+            std::sort(evictCandidates.begin(), evictCandidates.end(), [](const EvictCandidate& a,const EvictCandidate& b){
+                return a.lastUsedFrame < b.lastUsedFrame;
+            });
+            for (const auto& candidate : evictCandidates) {
+                if(residentBytes <= textureBudget){
+                    break;
+                }
+                auto& uids = candidate.preview ? fileImage2PreviewUids : fileImage2SamplerUids;
+                const auto found = uids.find(candidate.path);
+                bgfx::destroy(found->second->handle);
+                residentBytes -= found->second->textureInfo.storageSize;
+                uids.erase(found);
             }
         }
         
-        
         bgfx::TextureHandle  GetRampTextureHandler(){
             return m_curveRampTexture.handle;
         }
         
-        uint64_t GetRampTextureUniformId(){
-            return m_curveRampUniformId;
-        }
 
-        bgfx::TextureHandle addTextureHandle(const char* image_path,bgfx::TextureInfo** textureInfo = nullptr){
+        //不等解码, 第一次用到的图片先返回占位图, 解码完由pollTextureLoads换上
+        bgfx::TextureHandle addTextureHandle(const char* image_path,bgfx::TextureInfo** textureInfo = nullptr,bool* loading = nullptr){
             std::shared_ptr<GraphMaterialTextureData> tex;
              if(fileImage2SamplerUids.count(image_path) == 0)
              {
-                tex = std::make_shared<GraphMaterialTextureData>();
-                tex->handle = loadTexture(image_path,BGFX_TEXTURE_NONE|BGFX_SAMPLER_NONE,0,&tex->textureInfo);
+                tex = std::make_shared<GraphMaterialTextureData>(m_placeholderTexture);
+                tex->loading = true;
                 fileImage2SamplerUids[image_path] = tex;
+                decodePool.request(image_path);
              }else{
                 tex = fileImage2SamplerUids.at(image_path);
-                if (!bgfx::isValid(tex->handle)){
-                   tex->handle = loadTexture(image_path,BGFX_TEXTURE_NONE|BGFX_SAMPLER_NONE,0,&tex->textureInfo);
-                }
              }
+            tex->lastUsedFrame = frameIndex;
             if(textureInfo != nullptr){
                 *textureInfo = &tex->textureInfo;
             }
+            if(loading != nullptr){
+                *loading = tex->loading;
+            }
             return tex->handle;
         }
         
+        //节点和参数面板里画的图, 最长边不超过PREVIEW_SIZE, 原图只给材质用
+        bgfx::TextureHandle addPreviewHandle(const char* image_path,bgfx::TextureInfo** textureInfo){
+            std::shared_ptr<GraphMaterialTextureData> tex;
+            if(fileImage2PreviewUids.count(image_path) == 0){
+                tex = std::make_shared<GraphMaterialTextureData>(m_placeholderTexture);
+                tex->loading = true;
+                fileImage2PreviewUids[image_path] = tex;
+                decodePool.request(image_path,true);
+            }else{
+                tex = fileImage2PreviewUids.at(image_path);
+            }
+            //预览图只在画的那一帧算在用
+            tex->lastUsedFrame = frameIndex;
+            *textureInfo = &tex->textureInfo;
+            return tex->handle;
+        }
+        
+        //参数表引用材质贴图, 引用期间贴图不会被淘汰
+        void retainTexture(const std::string& image_path){
+            const auto found = fileImage2SamplerUids.find(image_path);
+            if(found != fileImage2SamplerUids.end()){
+                found->second->refs++;
+            }
+        }
+        
+        void releaseTexture(const std::string& image_path){
+            const auto found = fileImage2SamplerUids.find(image_path);
+            if(found != fileImage2SamplerUids.end() && found->second->refs > 0){
+                found->second->refs--;
+            }
+        }
+        
+        void setTextureBudget(uint64_t bytes){
+            textureBudget = bytes;
+        }
+        
+        //主线程每帧调用, 解码完的图片在这里建贴图, loadedPaths返回这次换上真贴图的路径(不含预览图)
+        //读不出来的图片一直用占位图, 不会每帧重新解码, 路径放进failedPaths
+        void pollTextureLoads(std::vector<std::string>& loadedPaths,std::vector<std::string>& failedPaths){
+            frameIndex++;
+            evictTextures();
+            decodedImages.clear();
+            decodePool.take_finished(decodedImages);
+            for (const auto& decoded : decodedImages) {
+                auto tex = decoded.preview ? fileImage2PreviewUids.at(decoded.path) : fileImage2SamplerUids.at(decoded.path);
+                tex->loading = false;
+                bgfx::TextureInfo info;
+                auto handle = create_decoded_texture(decoded.image, decoded.path.c_str(), BGFX_TEXTURE_NONE|BGFX_SAMPLER_NONE, &info);
+                if (!bgfx::isValid(handle)){
+                    if(!decoded.preview){
+                        failedPaths.push_back(decoded.path);
+                    }
+                    continue;
+                }
+                tex->handle = handle;
+                tex->textureInfo = info;
+                tex->owned = true;
+                residentBytes += info.storageSize;
+                if(!decoded.preview){
+                    loadedPaths.push_back(decoded.path);
+                }
+            }
+        }
+        
   
     };
 }
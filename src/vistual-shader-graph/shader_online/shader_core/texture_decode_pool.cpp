@@ -0,0 +1,333 @@
+#include "texture_decode_pool.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <bimg/decode.h>
+#include <bx/allocator.h>
+#include <bx/file.h>
+
+#include "hash.h"
+#include "profiler.h"
+
+namespace {
+	// DefaultAllocator is plain malloc, safe to share between workers and bgfx's release callback
+	bx::AllocatorI* decode_allocator()
+	{
+		static bx::DefaultAllocator allocator;
+		return &allocator;
+	}
+
+	void image_release_cb(void* ptr, void* user_data)
+	{
+		BX_UNUSED(ptr);
+		bimg::imageFree(static_cast<bimg::ImageContainer*>(user_data));
+	}
+
+	// Each decode has its own reader, entry::getFileReader() is shared with the main thread
+	void* read_file(const std::string& path, uint32_t& size)
+	{
+		bx::FileReader reader;
+		if (!bx::open(&reader, path.c_str())) {
+			size = 0;
+			return nullptr;
+		}
+		size = static_cast<uint32_t>(bx::getSize(&reader));
+		void* data{ BX_ALLOC(decode_allocator(), size) };
+		bx::read(&reader, data, size);
+		bx::close(&reader);
+		return data;
+	}
+
+	// 2x2 box filter down to 1x1, an odd last row or column is clamped instead of dropped
+	void downsample_rgba8(const bimg::ImageMip& src, const bimg::ImageMip& dst)
+	{
+		const uint8_t* src_data{ src.m_data };
+		uint8_t* dst_data{ const_cast<uint8_t*>(dst.m_data) };
+		for (uint32_t y = 0; y < dst.m_height; y++) {
+			const uint32_t y0{ std::min(y * 2, src.m_height - 1) };
+			const uint32_t y1{ std::min(y * 2 + 1, src.m_height - 1) };
+			for (uint32_t x = 0; x < dst.m_width; x++) {
+				const uint32_t x0{ std::min(x * 2, src.m_width - 1) };
+				const uint32_t x1{ std::min(x * 2 + 1, src.m_width - 1) };
+				for (uint32_t c = 0; c < 4; c++) {
+					const uint32_t sum{ 2u
+						+ src_data[(y0 * src.m_width + x0) * 4 + c]
+						+ src_data[(y0 * src.m_width + x1) * 4 + c]
+						+ src_data[(y1 * src.m_width + x0) * 4 + c]
+						+ src_data[(y1 * src.m_width + x1) * 4 + c] };
+					dst_data[(y * dst.m_width + x) * 4 + c] = static_cast<uint8_t>(sum / 4);
+				}
+			}
+		}
+	}
+
+	// Only plain RGBA8 2D images without mips get a chain, which covers what stb decodes png/jpg/tga to.
+	// dds/ktx keep whatever the file has.
+	bimg::ImageContainer* with_mips(bimg::ImageContainer* image)
+	{
+		if (image->m_format != bimg::TextureFormat::RGBA8 || image->m_numMips > 1 || image->m_cubeMap
+			|| image->m_depth > 1 || image->m_numLayers > 1 || (image->m_width < 2 && image->m_height < 2)) {
+			return image;
+		}
+		bimg::ImageContainer* mipped{ bimg::imageAlloc(decode_allocator(), bimg::TextureFormat::RGBA8,
+			uint16_t(image->m_width), uint16_t(image->m_height), 1, 1, false, true) };
+		if (mipped == nullptr) {
+			return image;
+		}
+		mipped->m_orientation = image->m_orientation;
+
+		bimg::ImageMip top;
+		bimg::imageGetRawData(*mipped, 0, 0, mipped->m_data, mipped->m_size, top);
+		std::memcpy(const_cast<uint8_t*>(top.m_data), image->m_data, image->m_width * image->m_height * 4);
+		bimg::imageFree(image);
+
+		bimg::ImageMip prev{ top };
+		for (uint8_t lod = 1; lod < mipped->m_numMips; lod++) {
+			bimg::ImageMip mip;
+			bimg::imageGetRawData(*mipped, 0, lod, mipped->m_data, mipped->m_size, mip);
+			downsample_rgba8(prev, mip);
+			prev = mip;
+		}
+		return mipped;
+	}
+
+	struct PreviewHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t content_hash; // csc::hash_bytes of the whole image file
+		uint32_t width;
+		uint32_t height;
+	};
+
+	constexpr uint32_t PREVIEW_MAGIC{ 0x50475356 }; // "VSGP"
+	constexpr uint32_t PREVIEW_VERSION{ 1 };
+
+	bimg::ImageContainer* load_cached_preview(const std::string& cache_path, const uint64_t content_hash)
+	{
+		uint32_t size{ 0 };
+		void* const data{ read_file(cache_path, size) };
+		if (data == nullptr) {
+			return nullptr;
+		}
+		bimg::ImageContainer* image{ nullptr };
+		PreviewHeader header;
+		if (size >= sizeof(header)) {
+			std::memcpy(&header, data, sizeof(header));
+			const bool valid{ header.magic == PREVIEW_MAGIC && header.version == PREVIEW_VERSION && header.content_hash == content_hash
+				&& header.width > 0 && header.width <= csc::PREVIEW_SIZE && header.height > 0 && header.height <= csc::PREVIEW_SIZE
+				&& size == sizeof(header) + header.width * header.height * 4 };
+			if (valid) {
+				image = bimg::imageAlloc(decode_allocator(), bimg::TextureFormat::RGBA8, uint16_t(header.width), uint16_t(header.height), 1, 1, false, false,
+					static_cast<const uint8_t*>(data) + sizeof(header));
+			}
+		}
+		BX_FREE(decode_allocator(), data);
+		return image;
+	}
+
+	// Failing to write (read-only bundle directory) only means the next run decodes again
+	void save_cached_preview(const std::string& cache_path, const uint64_t content_hash, const bimg::ImageContainer& image)
+	{
+		bx::FileWriter writer;
+		if (!bx::open(&writer, cache_path.c_str())) {
+			return;
+		}
+		const PreviewHeader header{ PREVIEW_MAGIC, PREVIEW_VERSION, content_hash, image.m_width, image.m_height };
+		bx::write(&writer, &header, sizeof(header));
+		bx::write(&writer, image.m_data, image.m_width * image.m_height * 4);
+		bx::close(&writer);
+	}
+
+	// Box filter of the first face and layer, each preview pixel averages the source pixels it covers
+	bimg::ImageContainer* shrink_rgba8(const bimg::ImageContainer& source, const uint32_t dst_width, const uint32_t dst_height)
+	{
+		bimg::ImageContainer* const image{ bimg::imageAlloc(decode_allocator(), bimg::TextureFormat::RGBA8, uint16_t(dst_width), uint16_t(dst_height), 1, 1, false, false) };
+		if (image == nullptr) {
+			return nullptr;
+		}
+		const uint8_t* const src{ static_cast<const uint8_t*>(source.m_data) };
+		uint8_t* const dst{ static_cast<uint8_t*>(image->m_data) };
+		for (uint32_t y = 0; y < dst_height; y++) {
+			const uint32_t y_begin{ y * source.m_height / dst_height };
+			const uint32_t y_end{ std::max((y + 1) * source.m_height / dst_height, y_begin + 1) };
+			for (uint32_t x = 0; x < dst_width; x++) {
+				const uint32_t x_begin{ x * source.m_width / dst_width };
+				const uint32_t x_end{ std::max((x + 1) * source.m_width / dst_width, x_begin + 1) };
+				uint32_t sum[4]{};
+				for (uint32_t sy = y_begin; sy < y_end; sy++) {
+					for (uint32_t sx = x_begin; sx < x_end; sx++) {
+						for (uint32_t c = 0; c < 4; c++) {
+							sum[c] += src[(sy * source.m_width + sx) * 4 + c];
+						}
+					}
+				}
+				const uint32_t count{ (y_end - y_begin) * (x_end - x_begin) };
+				for (uint32_t c = 0; c < 4; c++) {
+					dst[(y * dst_width + x) * 4 + c] = static_cast<uint8_t>((sum[c] + count / 2) / count);
+				}
+			}
+		}
+		return image;
+	}
+
+	bimg::ImageContainer* decode_preview(const std::string& path)
+	{
+		uint32_t size{ 0 };
+		void* const data{ read_file(path, size) };
+		if (data == nullptr) {
+			return nullptr;
+		}
+		const uint64_t content_hash{ csc::hash_bytes(data, size) };
+		const std::string cache_path{ path + ".preview" };
+		bimg::ImageContainer* image{ load_cached_preview(cache_path, content_hash) };
+		if (image == nullptr) {
+			image = bimg::imageParse(decode_allocator(), data, size, bimg::TextureFormat::RGBA8);
+		}
+		BX_FREE(decode_allocator(), data);
+		if (image == nullptr) {
+			return nullptr;
+		}
+
+		const uint32_t longest{ std::max(image->m_width, image->m_height) };
+		if (longest <= csc::PREVIEW_SIZE && image->m_numMips == 1 && image->m_numLayers == 1 && !image->m_cubeMap && image->m_depth <= 1) {
+			return image;
+		}
+		const uint32_t width{ std::max(image->m_width * csc::PREVIEW_SIZE / longest, 1u) };
+		const uint32_t height{ std::max(image->m_height * csc::PREVIEW_SIZE / longest, 1u) };
+		bimg::ImageContainer* const preview{ shrink_rgba8(*image, width, height) };
+		bimg::imageFree(image);
+		if (preview != nullptr) {
+			save_cached_preview(cache_path, content_hash, *preview);
+		}
+		return preview;
+	}
+
+	bimg::ImageContainer* decode_full(const std::string& path, const bool generate_mips)
+	{
+		uint32_t size{ 0 };
+		void* const data{ read_file(path, size) };
+		if (data == nullptr) {
+			return nullptr;
+		}
+		bimg::ImageContainer* image{ bimg::imageParse(decode_allocator(), data, size) };
+		BX_FREE(decode_allocator(), data);
+		if (image != nullptr && generate_mips) {
+			image = with_mips(image);
+		}
+		return image;
+	}
+}
+
+csc::TextureDecodePool::TextureDecodePool(const uint32_t thread_count, const bool generate_mips) :
+	thread_count{ std::max(thread_count, 1u) },
+	generate_mips{ generate_mips }
+{
+
+}
+
+csc::TextureDecodePool::~TextureDecodePool()
+{
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		stopping = true;
+		jobs.clear();
+	}
+	work_cv.notify_all();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+	for (DecodedImage& decoded : finished) {
+		if (decoded.image != nullptr) {
+			bimg::imageFree(decoded.image);
+		}
+	}
+}
+
+void csc::TextureDecodePool::request(const std::string& path, const bool preview)
+{
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		jobs.push_back(Job{ path, preview });
+		while (workers.size() < thread_count) {
+			workers.emplace_back(&TextureDecodePool::worker_loop, this);
+		}
+	}
+	work_cv.notify_one();
+}
+
+void csc::TextureDecodePool::take_finished(std::vector<DecodedImage>& out)
+{
+	std::lock_guard<std::mutex> lock{ mutex };
+	out.insert(out.end(), finished.begin(), finished.end());
+	finished.clear();
+}
+
+void csc::TextureDecodePool::worker_loop()
+{
+	while (true) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock{ mutex };
+			work_cv.wait(lock, [this] { return stopping || !jobs.empty(); });
+			if (stopping) {
+				return;
+			}
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+
+		bimg::ImageContainer* image{ nullptr };
+		if (job.preview) {
+			const csc::ProfileScope decode_phase{ "decode preview" };
+			image = decode_preview(job.path);
+		}
+		else {
+			const csc::ProfileScope decode_phase{ "decode image" };
+			image = decode_full(job.path, generate_mips);
+		}
+
+		std::lock_guard<std::mutex> lock{ mutex };
+		if (stopping) {
+			if (image != nullptr) {
+				bimg::imageFree(image);
+			}
+			return;
+		}
+		finished.push_back(DecodedImage{ job.path, image, job.preview });
+	}
+}
+
+bgfx::TextureHandle csc::create_decoded_texture(bimg::ImageContainer* const image, const char* const name, const uint64_t flags, bgfx::TextureInfo* const info)
+{
+	bgfx::TextureHandle handle = BGFX_INVALID_HANDLE;
+	if (image == nullptr) {
+		return handle;
+	}
+	const bgfx::TextureFormat::Enum format{ bgfx::TextureFormat::Enum(image->m_format) };
+	const bool has_mips{ 1 < image->m_numMips };
+	if (!image->m_cubeMap && image->m_depth <= 1 && !bgfx::isTextureValid(0, false, image->m_numLayers, format, flags)) {
+		bimg::imageFree(image);
+		return handle;
+	}
+
+	if (info != nullptr) {
+		bgfx::calcTextureSize(*info, uint16_t(image->m_width), uint16_t(image->m_height), uint16_t(image->m_depth),
+			image->m_cubeMap, has_mips, image->m_numLayers, format);
+	}
+	// from here on the image is freed by bgfx once the texture is uploaded
+	const bgfx::Memory* mem{ bgfx::makeRef(image->m_data, image->m_size, image_release_cb, image) };
+	if (image->m_cubeMap) {
+		handle = bgfx::createTextureCube(uint16_t(image->m_width), has_mips, image->m_numLayers, format, flags, mem);
+	}
+	else if (1 < image->m_depth) {
+		handle = bgfx::createTexture3D(uint16_t(image->m_width), uint16_t(image->m_height), uint16_t(image->m_depth), has_mips, format, flags, mem);
+	}
+	else {
+		handle = bgfx::createTexture2D(uint16_t(image->m_width), uint16_t(image->m_height), has_mips, image->m_numLayers, format, flags, mem);
+	}
+	if (bgfx::isValid(handle)) {
+		bgfx::setName(handle, name);
+	}
+	return handle;
+}
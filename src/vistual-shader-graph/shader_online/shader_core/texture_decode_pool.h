@@ -0,0 +1,79 @@
+#pragma once
+
+/**
+ * @file
+ * @brief Defines TextureDecodePool: image files are read and decoded on worker threads, textures are created on the main thread.
+ */
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <bgfx/bgfx.h>
+#include <bimg/bimg.h>
+
+namespace csc {
+
+	// Longest side of editor preview images
+	constexpr uint16_t PREVIEW_SIZE{ 128 };
+
+	struct DecodedImage {
+		std::string path;
+		bimg::ImageContainer* image; // nullptr when the file could not be read or parsed
+		bool preview;                // RGBA8 copy no larger than PREVIEW_SIZE, only for the editor UI
+	};
+
+	/**
+	 * @brief Background decode pool for IMAGE_TEX files.
+	 *
+	 * request() and take_finished() are called from the main thread and never wait for a decode, workers
+	 * only touch their own file reader and the pool's allocator. Worker threads are started by the first
+	 * request, so a process that never loads an image (vsg_batch) never starts any.
+	 *
+	 * Previews are cached next to the image as "<image>.preview" together with a hash of the image file,
+	 * a cache hit only reads and hashes the file instead of decoding and shrinking it again. Images that
+	 * are already small enough are used as is and never cached.
+	 */
+	class TextureDecodePool {
+	public:
+		explicit TextureDecodePool(uint32_t thread_count = 2, bool generate_mips = true);
+		~TextureDecodePool();
+
+		TextureDecodePool(const TextureDecodePool&) = delete;
+		TextureDecodePool& operator=(const TextureDecodePool&) = delete;
+
+		void request(const std::string& path, bool preview = false);
+
+		// Moves out every decode finished since the last call, the caller owns the images
+		void take_finished(std::vector<DecodedImage>& out);
+
+	private:
+		struct Job {
+			std::string path;
+			bool preview;
+		};
+
+		void worker_loop();
+
+		const uint32_t thread_count;
+		const bool generate_mips;
+
+		std::mutex mutex;
+		std::condition_variable work_cv;
+		std::deque<Job> jobs;
+		std::vector<DecodedImage> finished;
+		bool stopping{ false };
+		std::vector<std::thread> workers;
+	};
+
+	/**
+	 * @brief Creates the texture for a decoded image, main thread only. Takes ownership of the image either way.
+	 *
+	 * Returns an invalid handle if the format is not supported, info is only filled in on success.
+	 */
+	bgfx::TextureHandle create_decoded_texture(bimg::ImageContainer* image, const char* name, uint64_t flags, bgfx::TextureInfo* info);
+}
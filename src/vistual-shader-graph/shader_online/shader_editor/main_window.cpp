@@ -36,7 +36,8 @@
 cse::MainWindow::MainWindow(const std::shared_ptr<SharedState>& shared_state) :
 	the_graph{ std::make_shared<csg::Graph>(csg::GraphType::MATERIAL) },
 	shared_state{ shared_state },
-	window_graph{ the_graph ,shared_state},
+	snippet_cache{ std::make_shared<csg::CodeSnippetCache>() },
+	window_graph{ the_graph ,shared_state,snippet_cache},
 	window_param_editor{ the_graph,shared_state },
 	undo_stack{ *the_graph }
 {
@@ -218,7 +219,7 @@ void cse::MainWindow::load_graph(const std::string serialized_graph)
 
 void cse::MainWindow::setGraph(const boost::optional<csg::Graph> opt_graph){
     *the_graph = *opt_graph;
-    csg::complie_graph(the_graph,shared_state,false);
+    csg::complie_graph(the_graph,shared_state,snippet_cache,false);
 }
 
 void cse::MainWindow::new_frame()
@@ -653,7 +654,7 @@ void cse::MainWindow::do_event(const InterfaceEvent& event)
 //                break;
 			case InterfaceEventType::SAVE_TO_MAX:
             {
-				csg::complie_graph(the_graph,shared_state,true);
+				csg::complie_graph(the_graph,shared_state,snippet_cache,true);
 				graph_unsaved = false;
             }
 				break;
@@ -741,8 +742,8 @@ void cse::MainWindow::do_event(const InterfaceEvent& event)
 				const boost::optional<csg::RGBCurveSlotValue> rgb_curve{ modal_curve_editor.take_rgb() };
 				if (rgb_curve) {
 					the_graph->set_curve_rgb(slot_id, *rgb_curve);
-                    auto layer = shared_state->getSlotLayer(slot_id.slot_id());
-                    SetRGBCurveSlotValue(shared_state,rgb_curve.get_ptr(),layer);
+                    const int row = SetRGBCurveSlotValue(shared_state,rgb_curve.get_ptr(),slot_id);
+                    shared_state->push_slot_ramp_change(slot_id, row);
 				}
 				const InterfaceEvent close_event{ InterfaceEventType::MODAL_CURVE_EDITOR_CLOSE };
 				do_event(close_event);
@@ -756,8 +757,8 @@ void cse::MainWindow::do_event(const InterfaceEvent& event)
 				const boost::optional<csg::VectorCurveSlotValue> vector_curve{ modal_curve_editor.take_vector() };
 				if (vector_curve) {
 					the_graph->set_curve_vec(slot_id, *vector_curve);
-                    auto layer = shared_state->getSlotLayer(slot_id.slot_id());
-                    SetVectorCurveSlotValue(shared_state,vector_curve.get_ptr(),layer);
+                    const int row = SetVectorCurveSlotValue(shared_state,vector_curve.get_ptr(),slot_id);
+                    shared_state->push_slot_ramp_change(slot_id, row);
 				}
 				const InterfaceEvent close_event{ InterfaceEventType::MODAL_CURVE_EDITOR_CLOSE };
 				do_event(close_event);
@@ -813,7 +814,8 @@ void cse::MainWindow::do_event(const InterfaceEvent& event)
 				const boost::optional<SetSlotBoolDetails> details{ event.details_as<SetSlotBoolDetails>() };
 				assert(details.has_value());
 				the_graph->set_bool(details->slot_id, details->new_value);
-                shared_state->push_slot_val_change(details->slot_id.slot_id(),details->new_value);
+                shared_state->push_slot_val_change(details->slot_id,details->new_value);
+                csg::refresh_folded_uniforms(the_graph, shared_state, details->slot_id.node_id());
 				should_do_undo_push = true;
 				break;
 			}
@@ -822,7 +824,8 @@ void cse::MainWindow::do_event(const InterfaceEvent& event)
 				const boost::optional<SetSlotColorDetails> details{ event.details_as<SetSlotColorDetails>() };
 				assert(details.has_value());
 				the_graph->set_color(details->slot_id, details->new_value);
-                shared_state->push_slot_val_change(details->slot_id.slot_id(),details->new_value);
+                shared_state->push_slot_val_change(details->slot_id,details->new_value);
+                csg::refresh_folded_uniforms(the_graph, shared_state, details->slot_id.node_id());
 				should_do_undo_push = true;
 				break;
 			}
@@ -833,7 +836,7 @@ void cse::MainWindow::do_event(const InterfaceEvent& event)
 				the_graph->set_enum(details->slot_id, details->new_value);
                 //re complie shader
                 if(shared_state->has_connect_nodes( details->slot_id.node_id())){
-                    csg::complie_graph(the_graph,shared_state,false);
+                    csg::complie_graph(the_graph,shared_state,snippet_cache,false);
                 }
 				should_do_undo_push = true;
 				break;
@@ -843,7 +846,8 @@ void cse::MainWindow::do_event(const InterfaceEvent& event)
 				const boost::optional<SetSlotFloatDetails> details{ event.details_as<SetSlotFloatDetails>() };
 				assert(details.has_value());
                 the_graph->set_float(details->slot_id, details->new_value);
-                shared_state->push_slot_val_change(details->slot_id.slot_id(),details->new_value);
+                shared_state->push_slot_val_change(details->slot_id,details->new_value);
+                csg::refresh_folded_uniforms(the_graph, shared_state, details->slot_id.node_id());
 				should_do_undo_push = true;
 				break;
 			}
@@ -852,7 +856,8 @@ void cse::MainWindow::do_event(const InterfaceEvent& event)
 				const boost::optional<SetSlotIntDetails> details{ event.details_as<SetSlotIntDetails>() };
 				assert(details.has_value());
 				the_graph->set_int(details->slot_id, details->new_value);
-                shared_state->push_slot_val_change(details->slot_id.slot_id(),details->new_value);
+                shared_state->push_slot_val_change(details->slot_id,details->new_value);
+                csg::refresh_folded_uniforms(the_graph, shared_state, details->slot_id.node_id());
 				should_do_undo_push = true;
 				break;
 			}
@@ -872,8 +877,8 @@ void cse::MainWindow::do_event(const InterfaceEvent& event)
 						mut_ramp.set(details->point_index, mut_point);
                         csg::ColorRampSlotValue mut_ramp_slot{mut_ramp};
 						the_graph->set_color_ramp(details->slot_id, mut_ramp_slot);
-                        auto layer = shared_state->getSlotLayer(details->slot_id.slot_id());
-                        SetColorRampSlotValue(shared_state,&mut_ramp_slot,layer);
+                        const int row = SetColorRampSlotValue(shared_state,&mut_ramp_slot,details->slot_id);
+                        shared_state->push_slot_ramp_change(details->slot_id, row);
 						should_do_undo_push = true;
 					}
 				}
@@ -894,9 +899,9 @@ void cse::MainWindow::do_event(const InterfaceEvent& event)
                         csg::ColorRampSlotValue mut_ramp_slot{mut_ramp};
 //                        mut_ramp_slot.setLayer(opt_ramp->getLayer());
 						the_graph->set_color_ramp(details->slot_id, mut_ramp_slot);
-                        auto layer = shared_state->getSlotLayer(details->slot_id.slot_id());
-                        SetColorRampSlotValue(shared_state,&mut_ramp_slot,layer);
-//                        shared_state->push_slot_val_change(details->slot_id.slot_id(),details->new_value);
+                        const int row = SetColorRampSlotValue(shared_state,&mut_ramp_slot,details->slot_id);
+                        shared_state->push_slot_ramp_change(details->slot_id, row);
+//                        shared_state->push_slot_val_change(details->slot_id,details->new_value);
 						should_do_undo_push = true;
 					}
 				}
@@ -916,11 +921,10 @@ void cse::MainWindow::do_event(const InterfaceEvent& event)
 //                    mut_ramp_slot.setLayer(opt_ramp->getLayer());
 //                    the_graph->set_color_ramp(details->slot_id, mut_ramp_slot);
 					the_graph->set_color_ramp(details->value, mut_ramp_slot);
-                    auto layer = shared_state->getSlotLayer(details->value.slot_id());
+                    const int row = SetColorRampSlotValue(shared_state,&mut_ramp_slot,details->value);
+                    shared_state->push_slot_ramp_change(details->value, row);
 
-                    SetColorRampSlotValue(shared_state,&mut_ramp_slot,layer);
-
-//                    shared_state->push_slot_val_change(details->slot_id.slot_id(),details->new_value);
+//                    shared_state->push_slot_val_change(details->slot_id,details->new_value);
 					should_do_undo_push = true;
 				}
 				break;
@@ -936,10 +940,9 @@ void cse::MainWindow::do_event(const InterfaceEvent& event)
                     csg::ColorRampSlotValue mut_ramp_slot{mut_ramp};
 //                    mut_ramp_slot.setLayer(opt_ramp->getLayer());
                     the_graph->set_color_ramp(details->slot_id, mut_ramp_slot);
-                    auto layer = shared_state->getSlotLayer(details->slot_id.slot_id());
-
-                    SetColorRampSlotValue(shared_state,&mut_ramp_slot,layer);
-//                    shared_state->push_slot_val_change(details->slot_id.slot_id(),details->new_value);
+                    const int row = SetColorRampSlotValue(shared_state,&mut_ramp_slot,details->slot_id);
+                    shared_state->push_slot_ramp_change(details->slot_id, row);
+//                    shared_state->push_slot_val_change(details->slot_id,details->new_value);
 					should_do_undo_push = true;
 				}
 				break;
@@ -949,7 +952,8 @@ void cse::MainWindow::do_event(const InterfaceEvent& event)
 				const boost::optional<SetSlotVectorDetails> details{ event.details_as<SetSlotVectorDetails>() };
 				assert(details.has_value());
 				the_graph->set_vector(details->slot_id, details->new_value);
-                shared_state->push_slot_val_change(details->slot_id.slot_id(),details->new_value);
+                shared_state->push_slot_val_change(details->slot_id,details->new_value);
+                csg::refresh_folded_uniforms(the_graph, shared_state, details->slot_id.node_id());
 				should_do_undo_push = true;
 				break;
 			}
@@ -958,7 +962,7 @@ void cse::MainWindow::do_event(const InterfaceEvent& event)
                 const boost::optional<SetSlotImageDetails> details{ event.details_as<SetSlotImageDetails>() };
                 assert(details.has_value());
                 the_graph->set_image_value(details->slot_id, details->new_value);
-                shared_state->push_slot_sampler_change(details->slot_id.slot_id(),shared_state->AddTextureHandler(details->new_value));
+                shared_state->push_slot_sampler_change(details->slot_id,shared_state->AddSlotTextureHandler(details->slot_id,details->new_value));
                 should_do_undo_push = true;
                 break;
             }
@@ -28,6 +28,7 @@
 struct ImGuiContext;
 
 namespace csg {
+	class CodeSnippetCache;
 	class Graph;
 	class SlotId;
 }
@@ -79,6 +80,8 @@ namespace cse {
 		bool graph_unsaved{ false };
 
 		std::shared_ptr<SharedState> shared_state;
+		// Per-node generated code kept between compiles of this editor's graph
+		std::shared_ptr<csg::CodeSnippetCache> snippet_cache;
 
 		//std::unique_ptr<GlfwWindow> glfw_window;
 //		ImGuiContext* imgui_context{ nullptr };
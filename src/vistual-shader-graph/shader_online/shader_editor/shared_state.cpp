@@ -1,4 +1,5 @@
 #include "shared_state.h"
+#include <algorithm>
 #include <sstream>
 
 bool cse::SharedState::input_reload()
@@ -24,19 +25,12 @@ bool cse::SharedState::output_updated()
 }
 
 bool cse::SharedState::uniform_updated(){
-    std::lock_guard<std::mutex> lock(uniform_change_mutex);
-    const bool result = uniform_change_counter>0;
-    return result;
+    return !uniform_changes.empty();
 }
 
-bool cse::SharedState::get_uniform_updated(void*& outputData,uint32_t& size){
-    std::lock_guard<std::mutex> lock(uniform_change_mutex);
-    size = sizeof(csc::UniformChangeData)*uniform_change_counter;
-    outputData = realloc(outputData, size);
-    memcpy(outputData, uniformChangeData, size);
-    uniform_change_counter = 0;
-    uniformChangeIndex.clear();
-    return true;
+bool cse::SharedState::get_uniform_updated(std::vector<csc::UniformChangeData>& changes){
+    changes.clear();
+    return uniform_changes.pop_all(changes) > 0;
 }
 
 
@@ -51,12 +45,16 @@ std::string cse::SharedState::get_output_graph()
 
 void cse::SharedState::set_output_graph(const std::string& new_graph)
 {
-	std::lock_guard<std::mutex> lock(output_mutex);
-	output_graph = new_graph;
-	_output_updated = true;
+	{
+		std::lock_guard<std::mutex> lock(output_mutex);
+		output_graph = new_graph;
+		_output_updated = true;
+		output_time = std::chrono::steady_clock::now();
+	}
+	notify_work();
 }
 
-void cse::SharedState::get_output_code(std::string& new_graph,std::string& vertexCode,std::string& fragmentCode, std::string& vardefineCode,void*& outputData,uint32_t& outputSize) {
+void cse::SharedState::get_output_code(std::string& new_graph,std::string& vertexCode,std::string& fragmentCode, std::string& vardefineCode,void*& outputData,uint32_t& outputSize,uint32_t& layoutVersion,uint64_t& programKey) {
 	std::lock_guard<std::mutex> lock(output_mutex);
     new_graph = std::string{ output_graph };
 	vertexCode = std::string{ output_vertex };
@@ -65,20 +63,63 @@ void cse::SharedState::get_output_code(std::string& new_graph,std::string& verte
     outputSize = streamUniformSize;
     outputData = realloc(outputData, streamUniformSize);
     memcpy(outputData, streamUniformData, streamUniformSize);
+    layoutVersion = output_layout_version;
+    programKey = output_program_key;
 	_output_updated = false;
 }
 
-void cse::SharedState::set_output_code(const std::string& new_graph,const std::string& vertexCode, const std::string& fragmentCode, const std::string& vardefineCode,const void* data,const uint32_t size)
+void cse::SharedState::set_output_code(const std::string& new_graph,const std::string& vertexCode, const std::string& fragmentCode, const std::string& vardefineCode,const void* data,const uint32_t size,const uint64_t programKey)
 {
-	std::lock_guard<std::mutex> lock(output_mutex);
-    output_graph = new_graph;
-	output_vertex = vertexCode;
-	output_fragment = fragmentCode;
-    output_varing = vardefineCode;
-    streamUniformData = realloc(streamUniformData, size);
-    memcpy(streamUniformData, data, size);
-    streamUniformSize = size;
-	_output_updated = true;
+	{
+		std::lock_guard<std::mutex> lock(output_mutex);
+		output_graph = new_graph;
+		output_vertex = vertexCode;
+		output_fragment = fragmentCode;
+		output_varing = vardefineCode;
+		streamUniformData = realloc(streamUniformData, size);
+		memcpy(streamUniformData, data, size);
+		streamUniformSize = size;
+		output_layout_version = uniform_layout_version;
+		output_program_key = programKey;
+		_output_updated = true;
+		output_time = std::chrono::steady_clock::now();
+	}
+	notify_work();
+}
+
+void cse::SharedState::notify_work()
+{
+	//taking the lock orders the notify after a waiter's last check, so the wakeup is not lost
+	{
+		std::lock_guard<std::mutex> lock(work_mutex);
+	}
+	work_cv.notify_one();
+}
+
+bool cse::SharedState::wait_for_work(std::chrono::milliseconds debounce)
+{
+	std::unique_lock<std::mutex> lock(work_mutex);
+	while (true) {
+		if (should_stop() || uniform_updated()) {
+			return false;
+		}
+		std::chrono::steady_clock::time_point settle_time;
+		bool pending;
+		{
+			std::lock_guard<std::mutex> output_lock(output_mutex);
+			pending = _output_updated;
+			settle_time = output_time + debounce;
+		}
+		if (!pending) {
+			work_cv.wait(lock);
+		}
+		else if (std::chrono::steady_clock::now() < settle_time) {
+			work_cv.wait_until(lock, settle_time);
+		}
+		else {
+			return true;
+		}
+	}
 }
 
 uint32_t cse::SharedState::getStreamDataSize(){
@@ -111,78 +152,46 @@ std::string cse::SharedState::getNodeDataFilePathWithPrefix(){
 
 
 
-void cse::SharedState::push_slot_val_change(uint64_t uniformId,float val){
-    if(uniformId ==0){
-        return;
-    }
-    csc::UniformChangeData data{uniformId,csc::Float4(val,0.0,0.0,0.0)};
-
-    std::lock_guard<std::mutex> lock(uniform_change_mutex);
-    if(uniformChangeIndex.count(uniformId)>0){
-        auto uniformIndex = uniformChangeIndex.at(uniformId);
-        uniformChangeData[uniformIndex] = data;
-    }else{
-        uniformChangeIndex[uniformId] = uniform_change_counter;
-        uniformChangeData[uniform_change_counter++] = data;
-    }
+void cse::SharedState::set_uniform_layout(std::unordered_map<csg::SlotId,uint16_t>&& slotIndices){
+    uniform_slot_indices = std::move(slotIndices);
+    uniform_layout_version++;
+    //引用已经在AddSlotTextureHandler里加过了
+    layout_texture_paths[uniform_layout_version] = std::move(next_layout_texture_paths);
+    next_layout_texture_paths.clear();
 }
-void cse::SharedState::push_slot_val_change(uint64_t uniformId,csc::Float2 val){
-    if(uniformId ==0){
+
+template <typename T> void cse::SharedState::push_uniform_change(const csg::SlotId& slotId,const T& value){
+    const auto found = uniform_slot_indices.find(slotId);
+    if(found == uniform_slot_indices.end()){
         return;
     }
-    csc::UniformChangeData data{uniformId,csc::Float4(val.x,val.y,0.0,0.0)};
-    std::lock_guard<std::mutex> lock(uniform_change_mutex);
-    if(uniformChangeIndex.count(uniformId)>0){
-        auto uniformIndex = uniformChangeIndex.at(uniformId);
-        uniformChangeData[uniformIndex] = data;
-    }else{
-        uniformChangeIndex[uniformId] = uniform_change_counter;
-        uniformChangeData[uniform_change_counter++] = data;
-    }
+    push_uniform_index_change(found->second,value);
 }
-void cse::SharedState::push_slot_val_change(uint64_t uniformId,csc::Float3 val){
-    if(uniformId ==0){
-        return;
-    }
-    csc::UniformChangeData data{uniformId,csc::Float4(val.x,val.y,val.z,0.0)};
-    std::lock_guard<std::mutex> lock(uniform_change_mutex);
-    if(uniformChangeIndex.count(uniformId)>0){
-        auto uniformIndex = uniformChangeIndex.at(uniformId);
-        uniformChangeData[uniformIndex] = data;
-    }else{
-        uniformChangeIndex[uniformId] = uniform_change_counter;
-        uniformChangeData[uniform_change_counter++] = data;
+
+template <typename T> void cse::SharedState::push_uniform_index_change(uint16_t uniformIndex,const T& value){
+    //拖动滑条时同一个参数只在第一次进队列时唤醒编译线程, 之后只是覆盖值, 不碰任何锁
+    //满了说明下标超出了队列的槽数, 这次改动丢掉
+    const csc::UniformChangeData data{uniformIndex,uniform_layout_version,value};
+    if(uniform_changes.push(data) == UniformChangeQueue::PushResult::QUEUED){
+        notify_work();
     }
 }
-void cse::SharedState::push_slot_val_change(uint64_t uniformId,csc::Float4 val){
-    if(uniformId ==0){
-        return;
-    }
-    csc::UniformChangeData data{uniformId,val};
-    std::lock_guard<std::mutex> lock(uniform_change_mutex);
-    if(uniformChangeIndex.count(uniformId)>0){
-        auto uniformIndex = uniformChangeIndex.at(uniformId);
-        uniformChangeData[uniformIndex] = data;
-    }else{
-        uniformChangeIndex[uniformId] = uniform_change_counter;
-        uniformChangeData[uniform_change_counter++] = data;
-    }
+
+void cse::SharedState::push_slot_val_change(const csg::SlotId& slotId,float val){
+    push_uniform_change(slotId,csc::Float4(val,0.0,0.0,0.0));
+}
+void cse::SharedState::push_slot_val_change(const csg::SlotId& slotId,csc::Float2 val){
+    push_uniform_change(slotId,csc::Float4(val.x,val.y,0.0,0.0));
+}
+void cse::SharedState::push_slot_val_change(const csg::SlotId& slotId,csc::Float3 val){
+    push_uniform_change(slotId,csc::Float4(val.x,val.y,val.z,0.0));
+}
+void cse::SharedState::push_slot_val_change(const csg::SlotId& slotId,csc::Float4 val){
+    push_uniform_change(slotId,val);
 }
 
-void cse::SharedState::push_slot_sampler_change(uint64_t uniformId,bgfx::TextureHandle samplerUid){
-    if(uniformId ==0){
-        return;
-    }
-    csc::UniformChangeData data{uniformId,csc::TextureData{samplerUid}};
-
-    std::lock_guard<std::mutex> lock(uniform_change_mutex);
-    if(uniformChangeIndex.count(uniformId)>0){
-        auto uniformIndex = uniformChangeIndex.at(uniformId);
-        uniformChangeData[uniformIndex] = data;
-    }else{
-        uniformChangeIndex[uniformId] = uniform_change_counter;
-        uniformChangeData[uniform_change_counter++] = data;
-    }
+void cse::SharedState::push_slot_sampler_change(const csg::SlotId& slotId,bgfx::TextureHandle samplerUid){
+    push_uniform_change(slotId,csc::TextureData{samplerUid});
 }
 
 void cse::SharedState::push_slot_enum_change(){
@@ -193,24 +202,101 @@ bgfx::TextureHandle cse::SharedState::AddTextureHandler(const char* filePth,bgfx
     return materialShaderContext.addTextureHandle(filePth,textureInfo);
 }
 
+bgfx::TextureHandle cse::SharedState::AddPreviewTextureHandler(const char* filePth,bgfx::TextureInfo** textureInfo){
+    return materialShaderContext.addPreviewHandle(filePth,textureInfo);
+}
+
+bgfx::TextureHandle cse::SharedState::AddSlotTextureHandler(const csg::SlotId& slotId,const char* filePth){
+    //槽换了别的图, 之前那张图解码完时不能再把它换回去
+    for (auto& loading_slots : loading_texture_slots) {
+        if(loading_slots.first != filePth){
+            auto& slots = loading_slots.second;
+            slots.erase(std::remove(slots.begin(), slots.end(), slotId), slots.end());
+        }
+    }
+    bool loading = false;
+    const auto handle = materialShaderContext.addTextureHandle(filePth,nullptr,&loading);
+    //GetUniformData里调用时属于下一版参数表, 换图时属于当前版本, 两边都记上
+    retain_layout_texture(layout_texture_paths[uniform_layout_version],filePth);
+    retain_layout_texture(next_layout_texture_paths,filePth);
+    if(loading){
+        auto& slots = loading_texture_slots[filePth];
+        if(std::find(slots.begin(), slots.end(), slotId) == slots.end()){
+            slots.push_back(slotId);
+        }
+    }
+    return handle;
+}
+
+void cse::SharedState::retain_layout_texture(std::vector<std::string>& paths,const std::string& path){
+    if(std::find(paths.begin(), paths.end(), path) == paths.end()){
+        paths.push_back(path);
+        materialShaderContext.retainTexture(path);
+    }
+}
+
+void cse::SharedState::set_texture_budget(uint64_t bytes){
+    materialShaderContext.setTextureBudget(bytes);
+}
+
+void cse::SharedState::poll_texture_loads(uint32_t applied_layout_version){
+    materialShaderContext.DestroyRetiredRampTextures(applied_layout_version);
+    //Scene不会再回到旧的参数表, 最新一版即使还没换上也留着
+    for (auto it = layout_texture_paths.begin(); it != layout_texture_paths.end() && it->first < applied_layout_version && it->first != uniform_layout_version;) {
+        for (const auto& path : it->second) {
+            materialShaderContext.releaseTexture(path);
+        }
+        it = layout_texture_paths.erase(it);
+    }
+    loaded_texture_paths.clear();
+    failed_texture_paths.clear();
+    materialShaderContext.pollTextureLoads(loaded_texture_paths,failed_texture_paths);
+    //读不出来的图片不会再有解码结果, 等着的槽继续用占位图
+    for (const auto& path : failed_texture_paths) {
+        loading_texture_slots.erase(path);
+    }
+    for (const auto& path : loaded_texture_paths) {
+        const auto found = loading_texture_slots.find(path);
+        if(found == loading_texture_slots.end()){
+            continue;
+        }
+        const auto handle = materialShaderContext.addTextureHandle(path.c_str());
+        for (const auto& slotId : found->second) {
+            push_slot_sampler_change(slotId,handle);
+        }
+        loading_texture_slots.erase(found);
+    }
+}
+
 bgfx::TextureHandle cse::SharedState::GetRampTextureHandler(){
+    materialShaderContext.SyncRampTexture(uniform_layout_version);
     return materialShaderContext.GetRampTextureHandler();
 }
 
-uint64_t cse::SharedState::GetRampTextureUniformId(){
-    return materialShaderContext.GetRampTextureUniformId();
+csc::Float4 cse::SharedState::GetRampCurveSize(){
+    return materialShaderContext.GetRampCurveSize();
 }
 
-void cse::SharedState::UpdateLayerRampBuffer(uint32_t* source,int layer){
-    materialShaderContext.UpdateLayerRampBuffer(source,layer);
+int cse::SharedState::AssignRampRow(const csg::SlotId& owner,const uint32_t* pixels){
+    return materialShaderContext.AssignRampRow(csc::RampAtlas::OwnerId{ owner.node_id(), owner.index() },pixels);
 }
 
+void cse::SharedState::begin_ramp_rows(){
+    materialShaderContext.BeginRampRows();
+}
 
-uint16_t cse::SharedState::getSlotLayer(uint64_t slotId){
-    return materialShaderContext.GetSlotLayer(slotId);
+void cse::SharedState::end_ramp_rows(){
+    materialShaderContext.EndRampRows();
 }
-void cse::SharedState::setSlotLayer(uint64_t slotId,uint16_t layer){
-    materialShaderContext.SetSlotLayer(slotId, layer);
+
+void cse::SharedState::push_slot_ramp_change(const csg::SlotId& slotId,int row){
+    if(materialShaderContext.SyncRampTexture(uniform_layout_version)){
+        push_uniform_index_change(csc::RAMP_CURVE_UNIFORM_INDEX,csc::TextureData{materialShaderContext.GetRampTextureHandler()});
+        push_uniform_index_change(csc::RAMP_CURVE_SIZE_UNIFORM_INDEX,materialShaderContext.GetRampCurveSize());
+    }
+    if(row >= 0){
+        push_slot_val_change(slotId,float(row));
+    }
 }
 
 void cse::SharedState::record_connect_nodes(std::vector<uint64_t> nodes){
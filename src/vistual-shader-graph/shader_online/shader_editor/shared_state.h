@@ -6,13 +6,18 @@
  */
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <mutex>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <bx/file.h>
 #include "shader_def.h"
+#include "uniform_change_queue.h"
 #include "vector.h"
+#include "../shader_graph/slot_id.h"
 
 /**
  * @brief Thread-safe class to allow the main window thread to send out a serialized graph to another thread
@@ -28,11 +33,16 @@ namespace cse {
 		std::string get_output_graph();
 		void set_output_graph(const std::string& new_graph);
 
-		void set_output_code(const std::string& nodeContent,const std::string& vertexCode, const std::string& fragmentCode, const std::string& vardefineCode,const void* data,const uint32_t size);
-		void get_output_code(std::string& new_graph,std::string& vertexCode,std::string& fragmentCode, std::string& vardefineCode,void*& outputData,uint32_t& outputSize);
+		void set_output_code(const std::string& nodeContent,const std::string& vertexCode, const std::string& fragmentCode, const std::string& vardefineCode,const void* data,const uint32_t size,const uint64_t programKey);
+		void get_output_code(std::string& new_graph,std::string& vertexCode,std::string& fragmentCode, std::string& vardefineCode,void*& outputData,uint32_t& outputSize,uint32_t& layoutVersion,uint64_t& programKey);
 
-		void request_stop() { return stop.store(true); }
+		void request_stop() { stop.store(true); notify_work(); }
 		bool should_stop() { return stop.load(); }
+
+		//Blocks the compile thread until there is something to do.
+		//Returns true once the latest output code has gone unchanged for debounce, so a burst of edits compiles once.
+		//Returns false on uniform changes or stop, pending output is then left for the next call.
+		bool wait_for_work(std::chrono::milliseconds debounce);
         
         
         void setStatePath(const bx::FilePath& bxFilePath,bool _documentPath){
@@ -69,32 +79,53 @@ namespace cse {
         
         uint32_t getStreamDataSize();
         
-        void push_slot_val_change(uint64_t uniformId,float val);
-        void push_slot_val_change(uint64_t uniformId,csc::Float2 val);
-        void push_slot_val_change(uint64_t uniformId,csc::Float3 val);
-        void push_slot_val_change(uint64_t uniformId,csc::Float4 val);
-        void push_slot_sampler_change(uint64_t uniformId,bgfx::TextureHandle textureData);
+        //UI thread: 新生成的代码里每个可编辑槽对应的参数下标, 在set_output_code之前换上
+        void set_uniform_layout(std::unordered_map<csg::SlotId,uint16_t>&& slotIndices);
+        
+        //槽不在当前参数表里(比如被连线了)时什么也不做
+        void push_slot_val_change(const csg::SlotId& slotId,float val);
+        void push_slot_val_change(const csg::SlotId& slotId,csc::Float2 val);
+        void push_slot_val_change(const csg::SlotId& slotId,csc::Float3 val);
+        void push_slot_val_change(const csg::SlotId& slotId,csc::Float4 val);
+        void push_slot_sampler_change(const csg::SlotId& slotId,bgfx::TextureHandle textureData);
         void holdWaitInputFile(){waitInputFile = true;}
         void releaseWaitInputFile(){waitInputFile = false;}
         bool getWaitInputFile(){return waitInputFile;}
         
         void push_slot_enum_change();
         
+        //compile thread only, the UI thread is the only one pushing changes
         bool uniform_updated();
-        bool get_uniform_updated(void*& outputData,uint32_t& size);
+        bool get_uniform_updated(std::vector<csc::UniformChangeData>& changes);
         
 
         bgfx::TextureHandle AddTextureHandler(const char* filePath,bgfx::TextureInfo** textureInfo = nullptr);
+        //给槽用的贴图, 还在解码的话记下这个槽, 解码完通过参数改动换成真的贴图
+        bgfx::TextureHandle AddSlotTextureHandler(const csg::SlotId& slotId,const char* filePath);
+        //编辑器里预览图片用的小图
+        bgfx::TextureHandle AddPreviewTextureHandler(const char* filePath,bgfx::TextureInfo** textureInfo);
+        //UI thread, 每帧一次: 解码完的贴图建好, 推给还在用占位图的槽
+        //applied_layout_version是Scene正在用的参数表版本, 更旧的参数表引用的贴图可以淘汰了
+        void poll_texture_loads(uint32_t applied_layout_version);
+        //图片贴图的显存预算, 字节
+        void set_texture_budget(uint64_t bytes);
+        //生成代码时调用, 先把改过的行传上去, 行数变了会是新贴图
         bgfx::TextureHandle GetRampTextureHandler();
-        uint64_t GetRampTextureUniformId();
-        void UpdateLayerRampBuffer(uint32_t* source,int layer);
-        
-        uint16_t getSlotLayer(uint64_t slotId);
-        void setSlotLayer(uint64_t slotId,uint16_t layer);
+        csc::Float4 GetRampCurveSize();
+        //owner是用这一行的槽, 返回ramp_curve里的行号, 满了返回-1
+        int AssignRampRow(const csg::SlotId& owner,const uint32_t* pixels);
+        void begin_ramp_rows();
+        void end_ramp_rows();
+        //编辑器里改了曲线/渐变后调用: 传上改过的行, 槽换了行或者贴图变大时通过改值通知Scene
+        void push_slot_ramp_change(const csg::SlotId& slotId,int row);
         
         void record_connect_nodes(std::vector<uint64_t> nodes);
         bool has_connect_nodes(uint64_t nodeId){return connect_nodes_map.count(nodeId)>0;}
 	private:
+		void notify_work();
+		template <typename T> void push_uniform_change(const csg::SlotId& slotId,const T& value);
+		template <typename T> void push_uniform_index_change(uint16_t uniformIndex,const T& value);
+		void retain_layout_texture(std::vector<std::string>& paths,const std::string& path);
 
 		std::mutex input_mutex;
 		bool _input_updated{ true };
@@ -106,8 +137,14 @@ namespace cse {
 		std::string output_varing;
         void* streamUniformData = nullptr;
         uint32_t streamUniformSize;
+        uint32_t output_layout_version{ 0 };
+        uint64_t output_program_key{ 0 };//csg::structural_hash
         
 		bool _output_updated{ false };
+		std::chrono::steady_clock::time_point output_time;
+
+		std::mutex work_mutex;
+		std::condition_variable work_cv;
 
 		std::atomic<bool> stop{ false };
         
@@ -116,13 +153,20 @@ namespace cse {
         bool documentPath{false};
         bool waitInputFile{false};
         
-        csc::UniformChangeData uniformChangeData[64];
-        std::map<uint64_t,uint8_t> uniformChangeIndex;
-        uint8_t uniform_change_counter;
-        std::mutex uniform_change_mutex;
+        UniformChangeQueue uniform_changes;
+        //只在UI线程上读写
+        std::unordered_map<csg::SlotId,uint16_t> uniform_slot_indices;
+        uint32_t uniform_layout_version{ 0 };
         
         
         csc::MaterialShaderContext materialShaderContext;
+        std::map<std::string,std::vector<csg::SlotId>> loading_texture_slots;
+        std::vector<std::string> loaded_texture_paths;
+        std::vector<std::string> failed_texture_paths;
+        //每个参数表版本引用的贴图, 各持有一次引用, Scene换到更新的版本后释放
+        std::map<uint32_t,std::vector<std::string>> layout_texture_paths;
+        //正在生成的下一版参数表引用的贴图, set_uniform_layout时归到新版本下
+        std::vector<std::string> next_layout_texture_paths;
         
         std::map<uint64_t,bool> connect_nodes_map;
 	};
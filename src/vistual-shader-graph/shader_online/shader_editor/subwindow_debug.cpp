@@ -1,15 +1,21 @@
 #include "subwindow_debug.h"
 
+#include <algorithm>
 #include <atomic>
 #include <cstddef>
+#include <cstring>
+#include <fstream>
 #include <set>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include <boost/optional.hpp>
+#include <bx/filepath.h>
 #include "imgui/imgui.h"
 
 #include "../shader_core/lerp.h"
+#include "../shader_core/profiler.h"
 #include "../shader_core/util_enum.h"
 #include "../shader_core/vector.h"
 #include "../shader_graph/graph.h"
@@ -21,6 +27,35 @@
 #include "enum.h"
 #include "event.h"
 
+namespace {
+	struct PhaseStats {
+		const char* name;
+		size_t count;
+		double last_ms;
+		double total_ms;
+		double max_ms;
+	};
+
+	// Per phase totals of the events still in the ring, in the order each phase first appears
+	std::vector<PhaseStats> collect_phase_stats(const std::vector<csc::ProfileEvent>& events)
+	{
+		std::vector<PhaseStats> stats;
+		for (const csc::ProfileEvent& event : events) {
+			const double ms{ (event.end_ns - event.begin_ns) / 1000000.0 };
+			auto it{ std::find_if(stats.begin(), stats.end(), [&event](const PhaseStats& s) { return std::strcmp(s.name, event.name) == 0; }) };
+			if (it == stats.end()) {
+				stats.push_back(PhaseStats{ event.name, 0, 0.0, 0.0, 0.0 });
+				it = stats.end() - 1;
+			}
+			it->count++;
+			it->last_ms = ms;
+			it->total_ms += ms;
+			it->max_ms = std::max(it->max_ms, ms);
+		}
+		return stats;
+	}
+}
+
 cse::DebugSubwindow::DebugSubwindow() : message("Pres butan to run validation.")
 {
 
@@ -61,6 +96,45 @@ cse::InterfaceEventArray cse::DebugSubwindow::run() const
 		if (ImGui::BeginTabItem("Runtime")) {
 			auto m = cse::InterfaceEventArray::max_used.load();
 			ImGui::Text("cse::InterfaceEventArray max size: %ld", m);
+			ImGui::Separator();
+
+			const std::vector<csc::ProfileEvent> events_in_ring{ csc::profile_ring().snapshot() };
+			ImGui::Text("Compile pipeline phases, last %ld events:", events_in_ring.size());
+			ImGui::Columns(5, "ProfilePhases", false);
+			ImGui::Text("phase");
+			ImGui::NextColumn();
+			ImGui::Text("count");
+			ImGui::NextColumn();
+			ImGui::Text("last ms");
+			ImGui::NextColumn();
+			ImGui::Text("avg ms");
+			ImGui::NextColumn();
+			ImGui::Text("max ms");
+			ImGui::NextColumn();
+			for (const PhaseStats& stats : collect_phase_stats(events_in_ring)) {
+				ImGui::Text("%s", stats.name);
+				ImGui::NextColumn();
+				ImGui::Text("%ld", stats.count);
+				ImGui::NextColumn();
+				ImGui::Text("%.2f", stats.last_ms);
+				ImGui::NextColumn();
+				ImGui::Text("%.2f", stats.total_ms / stats.count);
+				ImGui::NextColumn();
+				ImGui::Text("%.2f", stats.max_ms);
+				ImGui::NextColumn();
+			}
+			ImGui::Columns(1);
+
+			if (ImGui::Button("Clear")) {
+				csc::profile_ring().clear();
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Export Chrome Trace")) {
+				events.push(InterfaceEvent{ InterfaceEventType::PROFILE_SET_MESSAGE, SubwindowId::DEBUG, export_profile_trace() });
+			}
+			if (profile_message.empty() == false) {
+				ImGui::TextWrapped("%s", profile_message.c_str());
+			}
 			ImGui::EndTabItem();
 		}
 		ImGui::EndTabBar();
@@ -78,6 +152,21 @@ void cse::DebugSubwindow::do_event(const InterfaceEvent& event)
 	if (event.type() == InterfaceEventType::VALIDATE_SET_MESSAGE && event.message()) {
 		message = event.message().get();
 	}
+	else if (event.type() == InterfaceEventType::PROFILE_SET_MESSAGE && event.message()) {
+		profile_message = event.message().get();
+	}
+}
+
+std::string cse::DebugSubwindow::export_profile_trace() const
+{
+	bx::FilePath trace_path{ bx::Dir::Temp };
+	trace_path.join("vsg_trace.json");
+	std::ofstream out{ trace_path.getCPtr(), std::ios::binary };
+	if (!out) {
+		return std::string{ "Failed to write " } + trace_path.getCPtr();
+	}
+	out << csc::profile_chrome_trace(csc::profile_ring().snapshot());
+	return std::string{ "Wrote " } + trace_path.getCPtr() + ", open it in chrome://tracing or ui.perfetto.dev";
 }
 
 std::string cse::DebugSubwindow::run_validation() const
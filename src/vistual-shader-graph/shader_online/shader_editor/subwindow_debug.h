@@ -20,7 +20,9 @@ namespace cse {
 
 	private:
 		std::string run_validation() const;
+		std::string export_profile_trace() const;
 
 		std::string message;
+		std::string profile_message;
 	};
 }
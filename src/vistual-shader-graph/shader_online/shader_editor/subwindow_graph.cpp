@@ -222,7 +222,7 @@ bool cse::GraphSubwindow::do_event(const InterfaceEvent& event)
                     }
                 }
                 if(hasDeleteShaderNode){
-                    csg::complie_graph(the_graph, the_state, false);
+                    csg::complie_graph(the_graph, the_state, snippet_cache, false);
                 }
 				graph_altered = true;
             }
@@ -276,7 +276,7 @@ bool cse::GraphSubwindow::do_event(const InterfaceEvent& event)
 					bool success = the_graph->add_connection(*pending_connection_begin, *pin);
                     if(success){
                         if(the_state->has_connect_nodes( (*pin).node_id())){
-                            csg::complie_graph(the_graph, the_state, false);
+                            csg::complie_graph(the_graph, the_state, snippet_cache, false);
                         }
                     }
 					graph_altered = true;
@@ -291,7 +291,7 @@ bool cse::GraphSubwindow::do_event(const InterfaceEvent& event)
 				const csg::SlotId slot_id{ details->value };
 				const auto old_conn{ the_graph->remove_connection(slot_id) };
                 if(the_state->has_connect_nodes( slot_id.node_id())){
-                    csg::complie_graph(the_graph, the_state, false);
+                    csg::complie_graph(the_graph, the_state, snippet_cache, false);
                 }
 				if (old_conn) {
 					pending_connection_begin = old_conn->source();
@@ -464,7 +464,7 @@ cse::InterfaceEventArray cse::GraphSubwindow::process_event(const InputEvent& ev
 						if (slot) {
 							// Check if the slot has a value
 							// Slots with no value are unselectable
-							if (the_graph->get_slot_value(*slot)) {
+							if (the_graph->find_slot_value(*slot)) {
 								// Select the slot
 								const InterfaceEvent slot_event{ InterfaceEventType::SELECT_SLOT, *slot, boost::none };
 								new_events.push(slot_event);
@@ -695,8 +695,8 @@ void cse::GraphSubwindow::draw_nodes(ImDrawList* const draw_list) const
 					label_text.fill('\0');
 					if (slot.value) {
 						if (slot.type() == csg::SlotType::BOOL) {
-							const auto bool_value{ slot.value->as<csg::BoolSlotValue>() };
-							assert(bool_value.has_value());
+							const csg::BoolSlotValue* const bool_value{ slot.value->as_ptr<csg::BoolSlotValue>() };
+							assert(bool_value != nullptr);
 							if (bool_value->get()) {
 								snprintf(label_text.data(), label_text.size() - 1, "%s: True", slot_disp_name);
 							}
@@ -705,8 +705,8 @@ void cse::GraphSubwindow::draw_nodes(ImDrawList* const draw_list) const
 							}
 						}
 						else if (slot.type() == csg::SlotType::COLOR) {
-							const auto color_value = slot.value->as<csg::ColorSlotValue>();
-							assert(color_value.has_value());
+							const csg::ColorSlotValue* const color_value{ slot.value->as_ptr<csg::ColorSlotValue>() };
+							assert(color_value != nullptr);
 							snprintf(label_text.data(), label_text.size() - 1, "%s: ", slot_disp_name);
 							const ImVec2 text_size{ ImGui::CalcTextSize(label_text.data()) };
 							const csc::Float2 color_rect_offset{ label_pos + csc::Float2{ text_size.x, 0.0f } };
@@ -720,12 +720,12 @@ void cse::GraphSubwindow::draw_nodes(ImDrawList* const draw_list) const
 							ImGui::DrawList::AddRectFilled(draw_list, inner_rect, inner_color);
 						}
 						else if (slot.type() == csg::SlotType::ENUM) {
-                            const auto enum_value{ slot.value->as<csg::EnumSlotValue>() };
-							snprintf(label_text.data(), label_text.size() - 1, "%s:%s", slot_disp_name,enum_value.get().internal_name());
+                            const csg::EnumSlotValue* const enum_value{ slot.value->as_ptr<csg::EnumSlotValue>() };
+							snprintf(label_text.data(), label_text.size() - 1, "%s:%s", slot_disp_name,enum_value->internal_name());
 						}
 						else if (slot.type() == csg::SlotType::FLOAT) {
-							const auto float_value = slot.value->as<csg::FloatSlotValue>();
-							assert(float_value.has_value());
+							const csg::FloatSlotValue* const float_value{ slot.value->as_ptr<csg::FloatSlotValue>() };
+							assert(float_value != nullptr);
 							// Use snprintf to generate a pattern for another snprintf to get the label
 							// This is so the precision held by the slot is respected
 							std::array<char, 24> pattern_text;
@@ -735,13 +735,13 @@ void cse::GraphSubwindow::draw_nodes(ImDrawList* const draw_list) const
 							snprintf(label_text.data(), label_text.size() - 1, pattern_text.data(), slot_disp_name, float_value->get());
 						}
 						else if (slot.type() == csg::SlotType::INT) {
-							const auto int_value{ slot.value->as<csg::IntSlotValue>() };
-							assert(int_value.has_value());
+							const csg::IntSlotValue* const int_value{ slot.value->as_ptr<csg::IntSlotValue>() };
+							assert(int_value != nullptr);
 							snprintf(label_text.data(), label_text.size() - 1, "%s: %d", slot_disp_name, int_value->get());
 						}
 						else if (slot.type() == csg::SlotType::VECTOR) {
-                            const auto vec_value{ slot.value->as<csg::VectorSlotValue>() };
-                            const auto vec = vec_value.get().get();
+                            const csg::VectorSlotValue* const vec_value{ slot.value->as_ptr<csg::VectorSlotValue>() };
+                            const auto vec = vec_value->get();
 							snprintf(label_text.data(), label_text.size() - 1, "%s: [%f,%f,%f]", slot_disp_name,vec.x,vec.y,vec.z);
 						}
 						else if (slot.type() == csg::SlotType::CURVE_RGB) {
@@ -754,8 +754,8 @@ void cse::GraphSubwindow::draw_nodes(ImDrawList* const draw_list) const
 							snprintf(label_text.data(), label_text.size() - 1, "%s: [Ramp]", slot_disp_name);
 						}
                         else if (slot.type() == csg::SlotType::IMAGE) {
-                            const auto image_value{ slot.value->as<csg::ImageSlotValue>() };
-                            const auto imagePath = image_value.get().get();
+                            const csg::ImageSlotValue* const image_value{ slot.value->as_ptr<csg::ImageSlotValue>() };
+                            const auto imagePath = image_value->get();
                             auto bxFilePath = bx::FilePath(imagePath);
                             auto fileNam = bxFilePath.getFileName();
                             snprintf(label_text.data(), label_text.size() - 1, "%s: %s", slot_disp_name,fileNam.getPtr());
@@ -770,10 +770,10 @@ void cse::GraphSubwindow::draw_nodes(ImDrawList* const draw_list) const
                     ImGui::DrawList::AddText(draw_list, label_pos, COLOR_NODE_TEXT, label_text.data());
 
                     if(slot.type() == csg::SlotType::IMAGE){
-                        const auto image_value{ slot.value->as<csg::ImageSlotValue>() };
-                        const auto imagePath = image_value.get().get();
+                        const csg::ImageSlotValue* const image_value{ slot.value->as_ptr<csg::ImageSlotValue>() };
+                        const auto imagePath = image_value->get();
                         bgfx::TextureInfo* textureInfo;
-                        bgfx::TextureHandle uth = the_state->AddTextureHandler(imagePath,&textureInfo);
+                        bgfx::TextureHandle uth = the_state->AddPreviewTextureHandler(imagePath,&textureInfo);
                         Float2 showTextSize = Float2(50*(float(textureInfo->width)/float(textureInfo->height)),50);
                         ImGui::DrawList::AddImage(draw_list, label_pos+csc::Float2(0.0f, NODE_ROW_HEIGHT),showTextSize, COLOR_NODE_TEXT,uth);
                         next_slot_begin = next_slot_begin + showTextSize;
@@ -905,7 +905,7 @@ boost::optional<csg::SlotId> cse::GraphSubwindow::get_slot_at_pos(const csc::Flo
 		if (node_geom.rect().contains(world_pos)) {
 			const boost::optional<size_t> slot_id{ node_geom.slot_at_pos(world_pos) };
 			if (slot_id) {
-				const boost::optional<csg::Slot> slot{ node->slot(*slot_id) };
+				const csg::Slot* const slot{ node->slot_ptr(*slot_id) };
 				if (slot) {
 					// We have found a real slot, check that the direction matches before returning
 					if (direction) {
@@ -22,6 +22,7 @@
 struct ImDrawList;
 
 namespace csg {
+	class CodeSnippetCache;
 	class Graph;
 	class SlotId;
 }
@@ -30,7 +31,7 @@ namespace cse {
     class SharedState;
 	class GraphSubwindow {
 	public:
-        GraphSubwindow(std::shared_ptr<csg::Graph> the_graph,std::shared_ptr<cse::SharedState> state) : the_graph{ the_graph },the_state {state}{}
+        GraphSubwindow(std::shared_ptr<csg::Graph> the_graph,std::shared_ptr<cse::SharedState> state,std::shared_ptr<csg::CodeSnippetCache> snippet_cache) : the_graph{ the_graph },the_state {state},snippet_cache{ snippet_cache }{}
 
 		InterfaceEventArray run(InteractionMode mode, bool graph_unsaved) const;
 
@@ -65,6 +66,7 @@ namespace cse {
 
 		std::shared_ptr<csg::Graph> the_graph;
         std::shared_ptr<cse::SharedState> the_state;
+        std::shared_ptr<csg::CodeSnippetCache> snippet_cache;
         
 		NodeSelection node_selection;
 
@@ -36,16 +36,16 @@ cse::InterfaceEventArray cse::ParamEditorSubwindow::run() const
 	assert(opt_type_info.has_value());
 	const csg::NodeTypeInfo type_info{ opt_type_info.value() };
 
-	const auto opt_slot{ selected_node->slot(selected_slot->index()) };
-	if (opt_slot.has_value() == false) {
+	const csg::Slot* const slot{ selected_node->slot_ptr(selected_slot->index()) };
+	if (slot == nullptr) {
 		return result;
 	}
 
-//    if(opt_slot->type() == csg::SlotType::BOOL){
+//    if(slot->type() == csg::SlotType::BOOL){
 //        return result;
 //    }
 //
-//    if(opt_slot->type() == csg::SlotType::FLOAT){
+//    if(slot->type() == csg::SlotType::FLOAT){
 //        return result;
 //    }
     
@@ -56,19 +56,19 @@ cse::InterfaceEventArray cse::ParamEditorSubwindow::run() const
 		//namestream << NodeTypeInfo::from(dest_node->type())->name();
 		//namestream << nodeOrder;
 		//namestream << "_";
-		//namestream << type_prefixname_str(opt_slot->type());
+		//namestream << type_prefixname_str(slot->type());
 		//namestream << slotId.index();
 		//return namestream.str();
 
 		ImGui::Text("Node Type: %s", type_info.disp_name());
 		ImGui::Text("Param Name: %s", the_graph->GetSlotName(selected_slot.value()).c_str());
-		ImGui::Text("Param Type: %s", csg::Slot::type_name_str(opt_slot->type()));
+		ImGui::Text("Param Type: %s", csg::Slot::type_name_str(slot->type()));
 		ImGui::Dummy(ImVec2{ 230.0f, 1.0f });
 		ImGui::Separator();
-		if (opt_slot->dir() == csg::SlotDirection::INPUT) {
-			if (opt_slot->value.has_value()) {
-				if (opt_slot->type() == csg::SlotType::BOOL) {
-					const auto opt_bool_val{ opt_slot->value->as<csg::BoolSlotValue>() };
+		if (slot->dir() == csg::SlotDirection::INPUT) {
+			if (slot->value.has_value()) {
+				if (slot->type() == csg::SlotType::BOOL) {
+					const auto opt_bool_val{ slot->value->as_ptr<csg::BoolSlotValue>() };
 					if (opt_bool_val) {
 						const InterfaceEventArray bool_event{ run_bool(*selected_slot, *opt_bool_val) };
 						result.push(bool_event);
@@ -77,8 +77,8 @@ cse::InterfaceEventArray cse::ParamEditorSubwindow::run() const
 						ImGui::Text("Error: Failed to find editable bool.");
 					}
 				}
-				else if (opt_slot->type() == csg::SlotType::COLOR) {
-					const auto opt_color_val{ opt_slot->value->as<csg::ColorSlotValue>() };
+				else if (slot->type() == csg::SlotType::COLOR) {
+					const auto opt_color_val{ slot->value->as_ptr<csg::ColorSlotValue>() };
 					if (opt_color_val) {
 						const InterfaceEventArray color_event{ run_color(*selected_slot, *opt_color_val) };
 						result.push(color_event);
@@ -87,8 +87,8 @@ cse::InterfaceEventArray cse::ParamEditorSubwindow::run() const
 						ImGui::Text("Error: Failed to find editable color.");
 					}
 				}
-				else if (opt_slot->type() == csg::SlotType::ENUM) {
-					const auto opt_enum_val{ opt_slot->value.value().as<csg::EnumSlotValue>() };
+				else if (slot->type() == csg::SlotType::ENUM) {
+					const auto opt_enum_val{ slot->value->as_ptr<csg::EnumSlotValue>() };
 					if (opt_enum_val) {
 						const InterfaceEventArray enum_event{ run_enum(*selected_slot, *opt_enum_val) };
 						result.push(enum_event);
@@ -97,8 +97,8 @@ cse::InterfaceEventArray cse::ParamEditorSubwindow::run() const
 						ImGui::Text("Error: Failed to find editable enum.");
 					}
 				}
-				else if (opt_slot->type() == csg::SlotType::FLOAT) {
-					const auto opt_float_val{ opt_slot->value.value().as<csg::FloatSlotValue>() };
+				else if (slot->type() == csg::SlotType::FLOAT) {
+					const auto opt_float_val{ slot->value->as_ptr<csg::FloatSlotValue>() };
 					if (opt_float_val) {
 						const InterfaceEventArray float_event{ run_float(*selected_slot, *opt_float_val) };
 						result.push(float_event);
@@ -107,8 +107,8 @@ cse::InterfaceEventArray cse::ParamEditorSubwindow::run() const
 						ImGui::Text("Error: Failed to find editable float.");
 					}
 				}
-				else if (opt_slot->type() == csg::SlotType::INT) {
-					const auto opt_int_val{ opt_slot->value.value().as<csg::IntSlotValue>() };
+				else if (slot->type() == csg::SlotType::INT) {
+					const auto opt_int_val{ slot->value->as_ptr<csg::IntSlotValue>() };
 					if (opt_int_val) {
 						const InterfaceEventArray int_event{ run_int(*selected_slot, *opt_int_val) };
 						result.push(int_event);
@@ -117,8 +117,8 @@ cse::InterfaceEventArray cse::ParamEditorSubwindow::run() const
 						ImGui::Text("Error: Failed to find editable float.");
 					}
 				}
-				else if (opt_slot->type() == csg::SlotType::VECTOR) {
-					const auto opt_vec_val{ opt_slot->value.value().as<csg::VectorSlotValue>() };
+				else if (slot->type() == csg::SlotType::VECTOR) {
+					const auto opt_vec_val{ slot->value->as_ptr<csg::VectorSlotValue>() };
 					if (opt_vec_val) {
 						const InterfaceEventArray vec_event{ run_vector(*selected_slot, *opt_vec_val) };
 						result.push(vec_event);
@@ -127,20 +127,20 @@ cse::InterfaceEventArray cse::ParamEditorSubwindow::run() const
 						ImGui::Text("Error: Failed to find editable vector.");
 					}
 				}
-				else if (opt_slot->type() == csg::SlotType::CURVE_RGB) {
+				else if (slot->type() == csg::SlotType::CURVE_RGB) {
 					if (ImGui::Button("Open RGB Curve Editor")) {
 						const InterfaceEvent new_event{ InterfaceEventType::MODAL_CURVE_EDITOR_SHOW  };
 						result.push(new_event);
 					}
 				}
-				else if (opt_slot->type() == csg::SlotType::CURVE_VECTOR) {
+				else if (slot->type() == csg::SlotType::CURVE_VECTOR) {
 					if (ImGui::Button("Open Vector Curve Editor")) {
 						const InterfaceEvent new_event{ InterfaceEventType::MODAL_CURVE_EDITOR_SHOW };
 						result.push(new_event);
 					}
 				}
-				else if (opt_slot->type() == csg::SlotType::COLOR_RAMP) {
-					const auto opt_ramp_val{ opt_slot->value.value().as<csg::ColorRampSlotValue>() };
+				else if (slot->type() == csg::SlotType::COLOR_RAMP) {
+					const auto opt_ramp_val{ slot->value->as_ptr<csg::ColorRampSlotValue>() };
 					if (opt_ramp_val) {
 						const InterfaceEventArray enum_events{ run_color_ramp(*selected_slot, *opt_ramp_val) };
 						result.push(enum_events);
@@ -149,8 +149,8 @@ cse::InterfaceEventArray cse::ParamEditorSubwindow::run() const
 						ImGui::Text("Error: Failed to find editable ramp.");
 					}
 				}
-                else if (opt_slot->type() == csg::SlotType::IMAGE) {
-                    const auto opt_image_val{ opt_slot->value.value().as<csg::ImageSlotValue>() };
+                else if (slot->type() == csg::SlotType::IMAGE) {
+                    const auto opt_image_val{ slot->value->as_ptr<csg::ImageSlotValue>() };
                     if (opt_image_val) {
                         const InterfaceEventArray enum_events{ run_image(*selected_slot, *opt_image_val) };
                         result.push(enum_events);
@@ -362,7 +362,7 @@ cse::InterfaceEventArray cse::ParamEditorSubwindow::run_vector(const csg::SlotId
 	return result;
 }
 
-cse::InterfaceEventArray cse::ParamEditorSubwindow::run_color_ramp(csg::SlotId slot_id, csg::ColorRampSlotValue slot_value) const
+cse::InterfaceEventArray cse::ParamEditorSubwindow::run_color_ramp(csg::SlotId slot_id, const csg::ColorRampSlotValue& slot_value) const
 {
 	InterfaceEventArray result;
 
@@ -414,7 +414,7 @@ cse::InterfaceEventArray cse::ParamEditorSubwindow::run_color_ramp(csg::SlotId s
 }
 
 
-cse::InterfaceEventArray cse::ParamEditorSubwindow::run_image(csg::SlotId slot_id, csg::ImageSlotValue slot_value) const
+cse::InterfaceEventArray cse::ParamEditorSubwindow::run_image(csg::SlotId slot_id, const csg::ImageSlotValue& slot_value) const
 {
 
     
@@ -425,7 +425,7 @@ cse::InterfaceEventArray cse::ParamEditorSubwindow::run_image(csg::SlotId slot_i
         auto fileNam = bxFilePath.getFileName();
         ImGui::Text("image:%s",fileNam.getPtr());
         bgfx::TextureInfo* textureInfo;
-        bgfx::TextureHandle uth = the_state->AddTextureHandler(filePath,&textureInfo);
+        bgfx::TextureHandle uth = the_state->AddPreviewTextureHandler(filePath,&textureInfo);
         ImVec2 _size = ImVec2(128*(float(textureInfo->width)/float(textureInfo->height)),128);
         ImGui::Image(uth, _size);
         ImGui::Separator();
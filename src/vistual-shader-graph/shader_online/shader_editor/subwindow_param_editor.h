@@ -36,8 +36,8 @@ namespace cse {
 		InterfaceEventArray run_float(csg::SlotId slot_id, csg::FloatSlotValue slot_value) const;
 		InterfaceEventArray run_int(csg::SlotId slot_id, csg::IntSlotValue slot_value) const;
 		InterfaceEventArray run_vector(csg::SlotId slot_id, csg::VectorSlotValue slot_value) const;
-		InterfaceEventArray run_color_ramp(csg::SlotId slot_id, csg::ColorRampSlotValue slot_value) const;
-        InterfaceEventArray run_image(csg::SlotId slot_id, csg::ImageSlotValue slot_value) const;
+		InterfaceEventArray run_color_ramp(csg::SlotId slot_id, const csg::ColorRampSlotValue& slot_value) const;
+        InterfaceEventArray run_image(csg::SlotId slot_id, const csg::ImageSlotValue& slot_value) const;
 
 		void do_event(const InterfaceEvent& event);
 
@@ -2,30 +2,44 @@
 
 #include <cstddef>
 
-static constexpr size_t UNDO_LIMIT = 50;
+constexpr size_t cse::UndoStack::DEFAULT_STEP_LIMIT;
+constexpr size_t cse::UndoStack::DEFAULT_BYTE_LIMIT;
 
-cse::UndoStack::UndoStack(const csg::Graph& graph) :
-	next_undo_graph{ graph }
+cse::UndoStack::UndoStack(const csg::Graph& graph, const size_t step_limit, const size_t byte_limit) :
+	next_undo_graph{ graph },
+	total_bytes{ 0 },
+	step_limit{ step_limit },
+	byte_limit{ byte_limit }
 {
 
 }
 
+void cse::UndoStack::set_limits(const size_t new_step_limit, const size_t new_byte_limit)
+{
+	step_limit = new_step_limit;
+	byte_limit = new_byte_limit;
+	enforce_limits();
+}
+
 void cse::UndoStack::clear(const csg::Graph& graph)
 {
 	undo_state.clear();
 	redo_state.clear();
+	total_bytes = 0;
 	next_undo_graph = graph;
 }
 
 bool cse::UndoStack::push_undo(const csg::Graph& graph)
 {
+	// Unchanged nodes are shared with next_undo_graph, so this only looks inside nodes that were edited
 	if (next_undo_graph != graph) {
+		for (const UndoEntry& entry : redo_state) {
+			total_bytes -= entry.bytes;
+		}
 		redo_state.clear();
-		undo_state.push_front(next_undo_graph);
+		push_entry(undo_state, next_undo_graph, graph);
 		next_undo_graph = graph;
-		while (undo_state.size() > UNDO_LIMIT) {
-			undo_state.pop_back();
-		}
+		enforce_limits();
 		return true;
 	}
 	else {
@@ -38,10 +52,10 @@ csg::Graph cse::UndoStack::pop_undo(const csg::Graph& for_redo)
 	if (undo_state.size() == 0) {
 		return for_redo;
 	}
-	redo_state.push_front(for_redo);
-	csg::Graph result = undo_state.front();
-	undo_state.pop_front();
+	const csg::Graph result{ pop_entry(undo_state) };
+	push_entry(redo_state, for_redo, result);
 	next_undo_graph = result;
+	enforce_limits();
 	return result;
 }
 
@@ -50,9 +64,37 @@ csg::Graph cse::UndoStack::pop_redo(const csg::Graph& for_undo)
 	if (redo_state.size() == 0) {
 		return for_undo;
 	}
-	undo_state.push_front(for_undo);
-	csg::Graph result = redo_state.front();
-	redo_state.pop_front();
+	const csg::Graph result{ pop_entry(redo_state) };
+	push_entry(undo_state, for_undo, result);
 	next_undo_graph = result;
+	enforce_limits();
 	return result;
 }
+
+void cse::UndoStack::push_entry(std::list<UndoEntry>& state, const csg::Graph& graph, const csg::Graph& newer)
+{
+	const size_t bytes{ graph.unshared_memory_size(newer) };
+	state.push_front(UndoEntry{ graph, bytes });
+	total_bytes += bytes;
+}
+
+csg::Graph cse::UndoStack::pop_entry(std::list<UndoEntry>& state)
+{
+	const csg::Graph result{ state.front().graph };
+	total_bytes -= state.front().bytes;
+	state.pop_front();
+	return result;
+}
+
+void cse::UndoStack::enforce_limits()
+{
+	// Drop the oldest states first, but always keep the most recent step in each direction
+	while (undo_state.size() > 1 && (undo_state.size() > step_limit || total_bytes > byte_limit)) {
+		total_bytes -= undo_state.back().bytes;
+		undo_state.pop_back();
+	}
+	while (redo_state.size() > 1 && (redo_state.size() > step_limit || total_bytes > byte_limit)) {
+		total_bytes -= redo_state.back().bytes;
+		redo_state.pop_back();
+	}
+}
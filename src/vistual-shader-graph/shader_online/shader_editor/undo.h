@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <list>
 
 #include "../shader_graph/graph.h"
@@ -7,7 +8,10 @@
 namespace cse {
 	class UndoStack {
 	public:
-		UndoStack(const csg::Graph& graph);
+		static constexpr size_t DEFAULT_STEP_LIMIT{ 50 };
+		static constexpr size_t DEFAULT_BYTE_LIMIT{ 4 * 1024 * 1024 };
+
+		UndoStack(const csg::Graph& graph, size_t step_limit = DEFAULT_STEP_LIMIT, size_t byte_limit = DEFAULT_BYTE_LIMIT);
 
 		void clear(const csg::Graph& graph);
 
@@ -19,10 +23,33 @@ namespace cse {
 		bool undo_available() const { return undo_state.size() > 0; }
 		bool redo_available() const { return redo_state.size() > 0; }
 
+		// Approximate bytes held by all undo and redo states, nodes shared between states are counted once
+		// Each state is measured against its neighbour when it is pushed and never remeasured, so after
+		// states are dropped or popped the total can be off by the nodes those neighbours shared
+		size_t memory_size() const { return total_bytes; }
+
+		// Limits apply to undo and redo separately, the most recent step in each direction is always kept
+		void set_limits(size_t step_limit, size_t byte_limit);
+
 	private:
+		struct UndoEntry {
+			UndoEntry(const csg::Graph& graph, size_t bytes) : graph{ graph }, bytes{ bytes } {}
+
+			csg::Graph graph;
+			// Bytes this state holds that are not shared with the state that replaced it
+			size_t bytes;
+		};
+
+		void push_entry(std::list<UndoEntry>& state, const csg::Graph& graph, const csg::Graph& newer);
+		csg::Graph pop_entry(std::list<UndoEntry>& state);
+		void enforce_limits();
+
 		csg::Graph next_undo_graph;
 
-		std::list<csg::Graph> undo_state;
-		std::list<csg::Graph> redo_state;
+		std::list<UndoEntry> undo_state;
+		std::list<UndoEntry> redo_state;
+		size_t total_bytes;
+		size_t step_limit;
+		size_t byte_limit;
 	};
 }
@@ -0,0 +1,142 @@
+#pragma once
+
+/**
+ * @file
+ * @brief Defines UniformChangeQueue.
+ */
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "shader_def.h"
+
+namespace cse {
+
+	/**
+	 * @brief Lock-free single-producer/single-consumer queue of uniform changes, merged per uniform index.
+	 *
+	 * Each uniform index owns one slot of a dense table, a push only overwrites that slot, so dragging a
+	 * slider for a second still leaves one change to apply. A slot's index goes into the ring the first
+	 * time it changes after being consumed, the ring has one entry per slot and cannot overflow.
+	 * push() must only be called from one thread (the UI thread) and pop_all()/empty() from one other.
+	 */
+	class UniformChangeQueue {
+	public:
+		static constexpr size_t CAPACITY{ 1024 };
+
+		enum class PushResult {
+			MERGED, // the uniform was already waiting, only its value changed
+			QUEUED, // the consumer has to be told there is something new
+			FULL,   // dropped
+		};
+
+		UniformChangeQueue()
+		{
+			for (Slot& slot : slots) {
+				slot.sequence.store(0, std::memory_order_relaxed);
+				slot.pending.store(false, std::memory_order_relaxed);
+				for (auto& word : slot.words) {
+					word.store(0, std::memory_order_relaxed);
+				}
+			}
+		}
+
+		/**
+		 * @brief Producer side. Only FULL if the uniform index does not fit in the table.
+		 */
+		PushResult push(const csc::UniformChangeData& data)
+		{
+			const size_t slot_index{ data.uniformIndex };
+			if (slot_index >= CAPACITY) {
+				return PushResult::FULL;
+			}
+
+			Slot& slot{ slots[slot_index] };
+			write_slot(slot, data);
+			if (slot.pending.exchange(true)) {
+				return PushResult::MERGED;
+			}
+			const uint64_t write_index{ ring_head.load(std::memory_order_relaxed) };
+			ring[write_index % CAPACITY].store(static_cast<uint32_t>(slot_index), std::memory_order_relaxed);
+			ring_head.store(write_index + 1, std::memory_order_release);
+			return PushResult::QUEUED;
+		}
+
+		/**
+		 * @brief Consumer side. Appends the latest value of every uniform changed since the last call.
+		 */
+		size_t pop_all(std::vector<csc::UniformChangeData>& out)
+		{
+			const uint64_t head{ ring_head.load(std::memory_order_acquire) };
+			uint64_t tail{ ring_tail.load(std::memory_order_relaxed) };
+			const size_t begin_size{ out.size() };
+			for (; tail < head; tail++) {
+				Slot& slot{ slots[ring[tail % CAPACITY].load(std::memory_order_relaxed)] };
+				// cleared before reading, a push from now on queues the slot again instead of being lost
+				slot.pending.store(false);
+				out.push_back(read_slot(slot));
+			}
+			ring_tail.store(tail, std::memory_order_release);
+			return out.size() - begin_size;
+		}
+
+		bool empty() const
+		{
+			return ring_head.load(std::memory_order_acquire) == ring_tail.load(std::memory_order_relaxed);
+		}
+
+	private:
+		static_assert(std::is_trivially_copyable<csc::UniformChangeData>::value, "UniformChangeData is copied as raw words");
+		static constexpr size_t WORD_COUNT{ (sizeof(csc::UniformChangeData) + sizeof(uint64_t) - 1) / sizeof(uint64_t) };
+
+		struct Slot {
+			std::atomic<uint32_t> sequence; // odd while the producer is writing
+			std::atomic<bool> pending;      // index is in the ring and not consumed yet
+			std::array<std::atomic<uint64_t>, WORD_COUNT> words;
+		};
+
+		static void write_slot(Slot& slot, const csc::UniformChangeData& data)
+		{
+			uint64_t words[WORD_COUNT]{};
+			std::memcpy(words, &data, sizeof(data));
+			const uint32_t sequence{ slot.sequence.load(std::memory_order_relaxed) };
+			slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			for (size_t i = 0; i < WORD_COUNT; i++) {
+				slot.words[i].store(words[i], std::memory_order_relaxed);
+			}
+			slot.sequence.store(sequence + 2);
+		}
+
+		static csc::UniformChangeData read_slot(const Slot& slot)
+		{
+			uint64_t words[WORD_COUNT];
+			while (true) {
+				const uint32_t sequence{ slot.sequence.load() };
+				if (sequence & 1) {
+					continue;
+				}
+				for (size_t i = 0; i < WORD_COUNT; i++) {
+					words[i] = slot.words[i].load(std::memory_order_relaxed);
+				}
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+					break;
+				}
+			}
+			csc::UniformChangeData data;
+			std::memcpy(&data, words, sizeof(data));
+			return data;
+		}
+
+		std::array<Slot, CAPACITY> slots;
+		std::array<std::atomic<uint32_t>, CAPACITY> ring;
+		std::atomic<uint64_t> ring_head{ 0 };
+		std::atomic<uint64_t> ring_tail{ 0 };
+	};
+}
@@ -1,11 +1,14 @@
 #include "graph.h"
 
+#include <algorithm>
 #include <cassert>
+#include <iterator>
 #include <list>
 #include <set>
 
 #include <boost/optional.hpp>
 
+#include "../shader_core/hash.h"
 #include "../shader_core/vector.h"
 
 #include "node.h"
@@ -14,41 +17,50 @@
 #include "slot.h"
 
 
-template <typename TSlot, typename TRaw> bool set_graph_value(
-	const std::map<csg::NodeId, std::shared_ptr<csg::Node>>& nodes_by_id,
-	const csg::SlotId slot_id,
-	const TRaw new_value)
+// Source of Graph::_generation values, copies can be made on any thread
+static std::atomic<uint64_t> graph_generations{ 0 };
+
+static uint64_t next_graph_generation()
 {
-	if (nodes_by_id.count(slot_id.node_id()) == 0) {
-		return false;
-	}
+	return ++graph_generations;
+}
 
-	const std::shared_ptr<csg::Node> node{ nodes_by_id.at(slot_id.node_id()) };
-	if (node.use_count() == 0) {
-		return false;
-	}
+// Graph hashes are sums of these so that nodes and connections can be added or removed in any order
+static uint64_t node_hash_term(const csg::NodeId id, const uint64_t node_hash)
+{
+	return csc::hash_mix(csc::hash_value(id, node_hash));
+}
 
-	const auto opt_slot{ node->slot(slot_id.index()) };
-	if (opt_slot.has_value() == false) {
-		return false;
-	}
+static uint64_t connection_hash_term(const csg::Connection& connection)
+{
+	uint64_t hash{ csc::hash_value(connection.source().node_id()) };
+	hash = csc::hash_value(connection.source().index(), hash);
+	hash = csc::hash_value(connection.dest().node_id(), hash);
+	hash = csc::hash_value(connection.dest().index(), hash);
+	return csc::hash_mix(hash);
+}
 
-	csg::Slot& slot = node->slot_ref(slot_id.index());
-	if (slot.value.has_value() == false) {
+template <typename TSlot, typename TRaw> bool csg::Graph::set_slot_value(const SlotId slot_id, const TRaw new_value)
+{
+	const auto node_iter{ nodes_by_id.find(slot_id.node_id()) };
+	if (node_iter == nodes_by_id.end()) {
 		return false;
 	}
 
-	const boost::optional<TSlot> opt_old_value = slot.value->as<TSlot>();
-	if (opt_old_value.has_value() == false) {
+	const TSlot* const old_value{ node_iter->second->slot_value_as_ptr<TSlot>(slot_id.index()) };
+	if (old_value == nullptr) {
 		return false;
 	}
 
-	const TSlot old_value = opt_old_value.value();
-	TSlot maybe_new_value{ old_value };
+	TSlot maybe_new_value{ *old_value };
 	maybe_new_value.set(new_value);
 
-	if (maybe_new_value != old_value) {
-		slot.value = maybe_new_value;
+	if (maybe_new_value != *old_value) {
+		// Only unshare the node once we know the value actually changes
+		const std::shared_ptr<Node> node{ mutable_node(slot_id.node_id()) };
+		const uint64_t old_node_hash{ node->hash() };
+		node->slot_ref(slot_id.index()).value = maybe_new_value;
+		update_node_hash(*node, old_node_hash);
 		return true;
 	}
 	else {
@@ -72,7 +84,8 @@ boost::optional<csg::Graph> csg::Graph::from(const std::string& graph_string)
 	return deserialize_graph(graph_string);
 }
 
-csg::Graph::Graph(const GraphType type)
+csg::Graph::Graph(const GraphType type) :
+	_hash{ 0 }
 {
 	if (type == GraphType::MATERIAL) {
 		add(NodeType::MATERIAL_OUTPUT, csc::Int2{});
@@ -81,18 +94,18 @@ csg::Graph::Graph(const GraphType type)
 
 csg::Graph& csg::Graph::operator=(const Graph& other)
 {
-	// Destroy all shared_ptrs, the objects they point to do not belong to the this graph anymore
-	_nodes.clear();
-	nodes_by_id.clear();
-
-	for (const std::shared_ptr<Node>& node : other.nodes()) {
-		// Make a new shared_ptr with an equivalent but distinct object
-		const std::shared_ptr<Node> new_node{ std::make_shared<Node>(*node) };
-		_nodes.push_back(new_node);
-		nodes_by_id[new_node->id()] = new_node;
-	}
+	// Nodes are shared with the other graph, whichever graph modifies a node first makes its own copy
+	_nodes = other._nodes;
+	nodes_by_id = other.nodes_by_id;
+	// Neither graph owns the shared nodes any more
+	other._generation = next_graph_generation();
+	_generation = next_graph_generation();
+	owned_nodes.clear();
+	owned_generation = _generation;
 
 	_connections = other._connections;
+	rebuild_connection_index();
+	_hash = other._hash;
 
 	return *this;
 }
@@ -100,7 +113,7 @@ csg::Graph& csg::Graph::operator=(const Graph& other)
 std::shared_ptr<const csg::Node> csg::Graph::get(const NodeId id) const
 {
 	if (nodes_by_id.count(id)) {
-		return std::const_pointer_cast<const Node>(nodes_by_id.at(id));
+		return nodes_by_id.at(id);
 	}
 	else {
 		return std::shared_ptr<const csg::Node>{};
@@ -109,13 +122,22 @@ std::shared_ptr<const csg::Node> csg::Graph::get(const NodeId id) const
 
 boost::optional<csg::SlotValue> csg::Graph::get_slot_value(SlotId slot_id) const
 {
-	const auto opt_node{ get(slot_id.node_id()) };
-	if (opt_node) {
-		return opt_node->slot_value(slot_id.index());
+	const SlotValue* const value_ptr{ find_slot_value(slot_id) };
+	if (value_ptr) {
+		return *value_ptr;
 	}
 	return boost::none;
 }
 
+const csg::SlotValue* csg::Graph::find_slot_value(SlotId slot_id) const
+{
+	const auto node_iter{ nodes_by_id.find(slot_id.node_id()) };
+	if (node_iter != nodes_by_id.end()) {
+		return node_iter->second->slot_value_ptr(slot_id.index());
+	}
+	return nullptr;
+}
+
 csg::NodeId csg::Graph::add(const NodeType type, const csc::Int2 pos)
 {
 	while (true) {
@@ -123,6 +145,8 @@ csg::NodeId csg::Graph::add(const NodeType type, const csc::Int2 pos)
 		if (contains(new_node->id()) == false) {
 			_nodes.push_front(new_node);
 			nodes_by_id[new_node->id()] = new_node;
+			own_node(new_node->id());
+			_hash += node_hash_term(new_node->id(), new_node->hash());
 			return new_node->id();
 		}
 	}
@@ -134,6 +158,8 @@ bool csg::Graph::add(const NodeType type, const csc::Int2 pos, const NodeId node
 	if (contains(new_node->id()) == false) {
 		_nodes.push_front(new_node);
 		nodes_by_id[new_node->id()] = new_node;
+		own_node(new_node->id());
+		_hash += node_hash_term(new_node->id(), new_node->hash());
 		return true;
 	}
 	else {
@@ -147,7 +173,17 @@ void csg::Graph::remove(const std::set<NodeId>& ids)
 		const auto this_node{ *iter };
 		const bool is_deletable{ csg::NodeTypeInfo::from(this_node->type())->category() != csg::NodeCategory::OUTPUT };
 		if (is_deletable && ids.count(this_node->id())) {
+			// Drop every connection touching this node so the indexes never point at a missing node
+			const std::vector<SlotId> outgoing{ connections_from(this_node->id()) };
+			for (const SlotId dest : outgoing) {
+				remove_connection(dest);
+			}
+			for (size_t i = 0; i < this_node->slots().size(); i++) {
+				remove_connection(SlotId{ this_node->id(), i });
+			}
+			_hash -= node_hash_term(this_node->id(), this_node->hash());
 			nodes_by_id.erase(this_node->id());
+			owned_nodes.erase(this_node->id());
 			iter = _nodes.erase(iter);
 		}
 		else {
@@ -168,7 +204,7 @@ boost::optional<csg::NodeId> csg::Graph::duplicate(const NodeId node_id)
 		return boost::none;
 	}
 
-	const std::shared_ptr<Node> old_node{ nodes_by_id[node_id] };
+	const std::shared_ptr<const Node> old_node{ nodes_by_id[node_id] };
 	const boost::optional<NodeTypeInfo> old_type_info{ NodeTypeInfo::from(old_node->type()) };
 	assert(old_type_info.has_value());
 	if (old_type_info->allow_creation() == false) {
@@ -177,8 +213,10 @@ boost::optional<csg::NodeId> csg::Graph::duplicate(const NodeId node_id)
 	}
 
 	const NodeId new_node_id{ add(old_node->type(), old_node->position + duplicate_offset) };
-	const std::shared_ptr<Node> new_node{ nodes_by_id[new_node_id] };
+	const std::shared_ptr<Node> new_node{ mutable_node(new_node_id) };
+	const uint64_t old_node_hash{ new_node->hash() };
 	new_node->copy_from(*old_node);
+	update_node_hash(*new_node, old_node_hash);
 	return new_node_id;
 }
 
@@ -199,8 +237,8 @@ bool csg::Graph::add_connection(const SlotId source, const SlotId dest)
 		return false;
 	}
 
-	const auto source_slot{ source_node->slot(source.index()) };
-	const auto dest_slot{ dest_node->slot(dest.index()) };
+	const Slot* const source_slot{ source_node->slot_ptr(source.index()) };
+	const Slot* const dest_slot{ dest_node->slot_ptr(dest.index()) };
 	auto sType = source_slot->type();
 	auto dType = dest_slot->type();
     if(!csg::Slot::type_match(sType, dType)){
@@ -214,90 +252,145 @@ bool csg::Graph::add_connection(const SlotId source, const SlotId dest)
 	// Add new connection
 	boost::optional<Connection> removed_connection{ remove_connection(dest) };
 	_connections.push_back(Connection{ source, dest });
+	_hash += connection_hash_term(_connections.back());
+	index_connection(std::prev(_connections.end()));
 
 	return true;
 }
 
 boost::optional<csg::Connection> csg::Graph::remove_connection(const SlotId dest)
 {
-	for (auto conn_iter{ _connections.begin() }; conn_iter != _connections.end(); conn_iter++) {
-		if (conn_iter->dest() == dest) {
-			Connection result = *conn_iter;
-			_connections.erase(conn_iter);
-			return result;
-		}
+	const auto index_iter{ connections_by_dest.find(dest) };
+	if (index_iter == connections_by_dest.end()) {
+		return boost::none;
 	}
-	return boost::none;
+	const Connection result{ *index_iter->second };
+	erase_connection(index_iter->second);
+	return result;
 }
 
 boost::optional<csg::Connection> csg::Graph::get_connection(const SlotId dest) const
 {
-	for (auto conn_iter{ _connections.begin() }; conn_iter != _connections.end(); conn_iter++) {
-		if (conn_iter->dest() == dest) {
-			Connection result = *conn_iter;
-			return result;
+	const Connection* const conn{ find_connection(dest) };
+	if (conn == nullptr) {
+		return boost::none;
+	}
+	return *conn;
+}
+
+const csg::Connection* csg::Graph::find_connection(const SlotId dest) const
+{
+	const auto index_iter{ connections_by_dest.find(dest) };
+	if (index_iter == connections_by_dest.end()) {
+		return nullptr;
+	}
+	return &*index_iter->second;
+}
+
+const std::vector<csg::SlotId>& csg::Graph::connections_from(const NodeId source_node) const
+{
+	static const std::vector<SlotId> NO_CONNECTIONS;
+	const auto index_iter{ dests_by_source.find(source_node) };
+	if (index_iter == dests_by_source.end()) {
+		return NO_CONNECTIONS;
+	}
+	return index_iter->second;
+}
+
+void csg::Graph::index_connection(const std::list<Connection>::iterator conn_iter)
+{
+	connections_by_dest[conn_iter->dest()] = conn_iter;
+	dests_by_source[conn_iter->source().node_id()].push_back(conn_iter->dest());
+}
+
+void csg::Graph::erase_connection(const std::list<Connection>::iterator conn_iter)
+{
+	const NodeId source_node{ conn_iter->source().node_id() };
+	const auto source_iter{ dests_by_source.find(source_node) };
+	if (source_iter != dests_by_source.end()) {
+		std::vector<SlotId>& dests{ source_iter->second };
+		const auto dest_iter{ std::find(dests.begin(), dests.end(), conn_iter->dest()) };
+		if (dest_iter != dests.end()) {
+			*dest_iter = dests.back();
+			dests.pop_back();
+		}
+		if (dests.empty()) {
+			dests_by_source.erase(source_iter);
 		}
 	}
-	return boost::none;
+	connections_by_dest.erase(conn_iter->dest());
+	_hash -= connection_hash_term(*conn_iter);
+	_connections.erase(conn_iter);
+}
+
+void csg::Graph::rebuild_connection_index()
+{
+	connections_by_dest.clear();
+	dests_by_source.clear();
+	for (auto conn_iter{ _connections.begin() }; conn_iter != _connections.end(); conn_iter++) {
+		index_connection(conn_iter);
+	}
 }
 
 bool csg::Graph::set_bool(const SlotId slot_id, const bool new_value)
 {
-	return set_graph_value<BoolSlotValue>(nodes_by_id, slot_id, new_value);
+	return set_slot_value<BoolSlotValue>(slot_id, new_value);
 }
 
 bool csg::Graph::set_color(const SlotId slot_id, const csc::Float3 new_value)
 {
-	return set_graph_value<ColorSlotValue>(nodes_by_id, slot_id, new_value);
+	return set_slot_value<ColorSlotValue>(slot_id, new_value);
 }
 
 bool csg::Graph::set_enum(const SlotId slot_id, const size_t new_value)
 {
-	return set_graph_value<EnumSlotValue>(nodes_by_id, slot_id, new_value);
+	return set_slot_value<EnumSlotValue>(slot_id, new_value);
 }
 
 bool csg::Graph::set_float(const SlotId slot_id, const float new_value)
 {
-	return set_graph_value<FloatSlotValue>(nodes_by_id, slot_id, new_value);
+	return set_slot_value<FloatSlotValue>(slot_id, new_value);
 }
 
 bool csg::Graph::set_int(const SlotId slot_id, const int new_value)
 {
-	return set_graph_value<IntSlotValue>(nodes_by_id, slot_id, new_value);
+	return set_slot_value<IntSlotValue>(slot_id, new_value);
 }
 
 bool csg::Graph::set_vector(const SlotId slot_id, const csc::Float3 new_value)
 {
-	return set_graph_value<VectorSlotValue>(nodes_by_id, slot_id, new_value);
+	return set_slot_value<VectorSlotValue>(slot_id, new_value);
 }
 
 bool csg::Graph::set_color_ramp(const SlotId slot_id, const ColorRampSlotValue& new_value)
 {
-	return set_graph_value<ColorRampSlotValue>(nodes_by_id, slot_id, new_value);
+	return set_slot_value<ColorRampSlotValue>(slot_id, new_value);
 }
 
 bool csg::Graph::set_curve_rgb(const SlotId slot_id, const RGBCurveSlotValue& new_value)
 {
-	return set_graph_value<RGBCurveSlotValue>(nodes_by_id, slot_id, new_value);
+	return set_slot_value<RGBCurveSlotValue>(slot_id, new_value);
 }
 
 bool csg::Graph::set_curve_vec(const SlotId slot_id, const VectorCurveSlotValue& new_value)
 {
-	return set_graph_value<VectorCurveSlotValue>(nodes_by_id, slot_id, new_value);
+	return set_slot_value<VectorCurveSlotValue>(slot_id, new_value);
 }
 
 bool csg::Graph::set_image_value(const SlotId slot_id, const ImageSlotValue& new_value){
-    return set_graph_value<ImageSlotValue>(nodes_by_id, slot_id, new_value);
+    return set_slot_value<ImageSlotValue>(slot_id, new_value);
 }
 
 void csg::Graph::move(const std::set<NodeId>& ids, const csc::Float2 delta)
 {
 	for (const NodeId id : ids) {
 		if (nodes_by_id.count(id)) {
-			const auto ptr{ nodes_by_id[id] };
+			const auto ptr{ mutable_node(id) };
+			const uint64_t old_node_hash{ ptr->hash() };
 			const csc::Float2 current_pos{ ptr->position };
 			const csc::Float2 new_pos{ current_pos + delta };
 			ptr->position = csc::Int2{ new_pos };
+			update_node_hash(*ptr, old_node_hash);
 		}
 	}
 }
@@ -307,7 +400,7 @@ void csg::Graph::raise(const NodeId id)
 	if (contains(id) == false) {
 		return;
 	}
-	std::shared_ptr<Node> the_node;
+	std::shared_ptr<const Node> the_node;
 	for (auto iter{ _nodes.begin() }; iter != _nodes.end(); iter++) {
 		const NodeId this_id{ (*iter)->id() };
 		if (this_id == id) {
@@ -326,6 +419,54 @@ bool csg::Graph::contains(const NodeId id) const
 	return (nodes_by_id.count(id) > 0);
 }
 
+size_t csg::Graph::unshared_memory_size(const Graph& base) const
+{
+	size_t result{ sizeof(Graph) };
+	result += _connections.size() * (sizeof(Connection) + sizeof(std::pair<SlotId, std::list<Connection>::iterator>) + sizeof(SlotId));
+	for (const std::shared_ptr<const Node>& this_node : _nodes) {
+		// Every node costs a list entry and a map entry even when the node itself is shared
+		result += 2 * sizeof(std::shared_ptr<const Node>) + sizeof(NodeId);
+		const auto base_iter{ base.nodes_by_id.find(this_node->id()) };
+		if (base_iter == base.nodes_by_id.end() || base_iter->second != this_node) {
+			result += this_node->memory_size();
+		}
+	}
+	return result;
+}
+
+void csg::Graph::update_node_hash(Node& node, const uint64_t old_node_hash)
+{
+	node.update_hash();
+	_hash -= node_hash_term(node.id(), old_node_hash);
+	_hash += node_hash_term(node.id(), node.hash());
+}
+
+std::shared_ptr<csg::Node> csg::Graph::mutable_node(const NodeId id)
+{
+	const auto node_iter{ nodes_by_id.find(id) };
+	if (node_iter == nodes_by_id.end()) {
+		return std::shared_ptr<Node>{};
+	}
+	// A node this graph has not created or cloned since its last copy may be shared with that copy
+	if (owned_generation != _generation || owned_nodes.count(id) == 0) {
+		const std::shared_ptr<const Node> old_node{ node_iter->second };
+		const std::shared_ptr<const Node> new_node{ std::make_shared<Node>(*old_node) };
+		node_iter->second = new_node;
+		std::replace(_nodes.begin(), _nodes.end(), old_node, new_node);
+		own_node(id);
+	}
+	return std::const_pointer_cast<Node>(node_iter->second);
+}
+
+void csg::Graph::own_node(const NodeId id)
+{
+	if (owned_generation != _generation) {
+		owned_nodes.clear();
+		owned_generation = _generation;
+	}
+	owned_nodes.insert(id);
+}
+
 std::string csg::Graph::serialize() const
 {
 	return csg::serialize_graph(*this);
@@ -333,6 +474,10 @@ std::string csg::Graph::serialize() const
 
 bool csg::Graph::operator==(const Graph& other) const
 {
+	// The hash cannot decide either way: it is a sum of per-node and per-connection terms that can collide,
+	// and slot values compare with a tolerance that the hash cannot see. Always compare the contents,
+	// nodes shared between undo snapshots keep this cheap
+
 	const bool size_match_nodes{ _nodes.size() == other._nodes.size() };
 	const bool size_match_conns{ _connections.size() == other._connections.size() };
 	if (!size_match_nodes || !size_match_conns) {
@@ -340,11 +485,11 @@ bool csg::Graph::operator==(const Graph& other) const
 	}
 
 	// Check that all connections match (order does not matter)
+	// Each input slot has at most one connection, so looking up by dest is enough
 	{
-		const std::set<Connection> source_connections{ _connections.cbegin(), _connections.cend() };
-		// For each connection in other, make sure it exists in the source set
 		for (const Connection& this_conn : other._connections) {
-			if (source_connections.count(this_conn) == 0) {
+			const Connection* const source_conn{ find_connection(this_conn.dest()) };
+			if (source_conn == nullptr || source_conn->source() != this_conn.source()) {
 				return false;
 			}
 		}
@@ -352,12 +497,13 @@ bool csg::Graph::operator==(const Graph& other) const
 
 	// Check that all nodes match (order does not matter)
 	{
-		for (const std::shared_ptr<Node>& this_node : _nodes) {
-			const std::shared_ptr<const Node> other_node{ other.get(this_node->id()) };
-			if (other_node.use_count() == 0) {
+		for (const std::shared_ptr<const Node>& this_node : _nodes) {
+			const auto other_iter{ other.nodes_by_id.find(this_node->id()) };
+			if (other_iter == other.nodes_by_id.end()) {
 				return false;
 			}
-			if (*this_node != *other_node) {
+			// Nodes shared between snapshots are equal without looking inside them
+			if (other_iter->second != this_node && *this_node != *other_iter->second) {
 				return false;
 			}
 		}
@@ -390,7 +536,7 @@ bool csg::Graph::hasOrderByNodeId(const NodeId node_id){
 
 std::string csg::Graph::GetSlotName(const SlotId& slotId) {
 	const auto dest_node{ get(slotId.node_id()) };
-	const auto opt_slot{ dest_node->slot(slotId.index()) };
+	const Slot* const opt_slot{ dest_node->slot_ptr(slotId.index()) };
 	auto nodeOrder = getOrderByNodeId(slotId.node_id());
 	std::stringstream namestream;
 	namestream << NodeTypeInfo::from(dest_node->type())->name();
@@ -5,12 +5,16 @@
  * @brief Defines Connection and Graph.
  */
 
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <list>
 #include <map>
 #include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <boost/optional.hpp>
 
@@ -62,6 +66,7 @@ namespace csg {
 		Graph(GraphType type);
 
 		// Copy constructor and copy assignment operator, constructor defers to assignment
+		// Copies are cheap, nodes are shared between graphs and only cloned when one side modifies them
 		Graph(const Graph& other) { this->operator=(other); }
 		Graph& operator=(const Graph& other);
 
@@ -69,14 +74,21 @@ namespace csg {
 		boost::optional<SlotValue> get_slot_value(SlotId slot_id) const;
 		template <typename T> boost::optional<T> get_slot_value_as(SlotId slot_id) const
 		{
-			const boost::optional<SlotValue> opt_value{ get_slot_value(slot_id) };
-			if (opt_value) {
-				return opt_value->as<T>();
+			const T* const value_ptr{ find_slot_value_as<T>(slot_id) };
+			if (value_ptr) {
+				return *value_ptr;
 			}
 			else {
 				return boost::none;
 			}
 		}
+		// Returns the slot's value without copying it, nullptr if the node or value does not exist
+		const SlotValue* find_slot_value(SlotId slot_id) const;
+		template <typename T> const T* find_slot_value_as(SlotId slot_id) const
+		{
+			const SlotValue* const value_ptr{ find_slot_value(slot_id) };
+			return value_ptr ? value_ptr->as_ptr<T>() : nullptr;
+		}
 
 		NodeId add(NodeType type, csc::Int2 pos);
 		bool add(NodeType type, csc::Int2 pos, NodeId id);
@@ -86,6 +98,10 @@ namespace csg {
 		bool add_connection(SlotId source, SlotId dest);
 		boost::optional<Connection> remove_connection(SlotId dest);
 		boost::optional<Connection> get_connection(SlotId dest) const;
+		// Returns the connection feeding the given input slot without copying it, nullptr if there is none
+		const Connection* find_connection(SlotId dest) const;
+		// Returns the input slots that are connected to any output of the given node
+		const std::vector<SlotId>& connections_from(NodeId source_node) const;
 
 		bool set_bool(SlotId slot_id, bool new_value);
 		bool set_color(SlotId slot_id, csc::Float3 new_value);
@@ -103,8 +119,16 @@ namespace csg {
 
 		bool contains(NodeId id) const;
 
-		const std::list<std::shared_ptr<Node>>& nodes() const { return _nodes; }
-		const std::list<Connection> connections() const { return _connections; }
+		// Approximate bytes held by this graph that are not shared with base
+		size_t unshared_memory_size(const Graph& base) const;
+
+		// Hash of all nodes and connections, updated incrementally by every mutator
+		// Graphs with the same content have the same hash regardless of node or connection order,
+		// the reverse does not hold, so operator== never trusts it
+		uint64_t hash() const { return _hash; }
+
+		const std::list<std::shared_ptr<const Node>>& nodes() const { return _nodes; }
+		const std::list<Connection>& connections() const { return _connections; }
 
 		std::string serialize() const;
 		std::shared_ptr<csg::CodeGenerateData> generate_code();
@@ -119,10 +143,36 @@ namespace csg {
 		std::string GetSlotName(const SlotId& slotId);
 
 	private:
-		std::list<std::shared_ptr<Node>> _nodes;
+		// Returns a node that is safe to modify, cloning it first if it is shared with another graph
+		std::shared_ptr<Node> mutable_node(NodeId id);
+		// Marks a node this graph just created or cloned as safe to modify in place
+		void own_node(NodeId id);
+		template <typename TSlot, typename TRaw> bool set_slot_value(SlotId slot_id, TRaw new_value);
+		// Refreshes a node's hash after it was modified and folds the change into the graph hash
+		void update_node_hash(Node& node, uint64_t old_node_hash);
+
+		void index_connection(std::list<Connection>::iterator conn_iter);
+		void erase_connection(std::list<Connection>::iterator conn_iter);
+		void rebuild_connection_index();
+
+		std::list<std::shared_ptr<const Node>> _nodes;
 		std::list<Connection> _connections;
 
-		std::map<NodeId, std::shared_ptr<Node>> nodes_by_id;
+		// Indexes into _connections, must be kept in sync whenever a connection is added or removed
+		std::unordered_map<SlotId, std::list<Connection>::iterator> connections_by_dest;
+		std::unordered_map<NodeId, std::vector<SlotId>> dests_by_source;
+
+		std::map<NodeId, std::shared_ptr<const Node>> nodes_by_id;
+
+		// Nodes this graph created or cloned since it was last copied, only these are modified in place
+		// Sharing is tracked here rather than read from use_count(), extra holders of get() results must not force a clone
+		std::set<NodeId> owned_nodes;
+		// owned_nodes is only valid while owned_generation matches _generation
+		// Copying gives both graphs a new generation, so whatever they share is cloned before the next write
+		uint64_t owned_generation{ 0 };
+		mutable std::atomic<uint64_t> _generation{ 0 };
+
+		uint64_t _hash;
         
         //add info to process code
 		std::map<NodeId, int> nodes_by_order;
@@ -8,6 +8,8 @@
 #include <mutex>
 #include <random>
 
+#include "../shader_core/hash.h"
+
 #include "node_enums.h"
 
 static std::mutex node_id_rng_mutex;
@@ -665,6 +667,7 @@ csg::Node::Node(const NodeType type, const csc::Int2 position) : position{ posit
 		assert(false);
 	}
 	roll_id();
+	update_hash();
 }
 
 csg::Node::Node(const NodeType type, const csc::Int2 position, const NodeId id) :
@@ -691,10 +694,11 @@ boost::optional<size_t> csg::Node::slot_index(const SlotDirection dir, const boo
 
 boost::optional<csg::Slot> csg::Node::slot(const size_t index) const
 {
-	if (index >= _slots.size()) {
+	const Slot* const the_slot{ slot_ptr(index) };
+	if (the_slot == nullptr) {
 		return boost::none;
 	}
-	return _slots.at(index);
+	return *the_slot;
 }
 
 boost::optional<csg::Slot> csg::Node::slot(const SlotDirection dir, const boost::string_view& slot_name) const
@@ -710,15 +714,33 @@ boost::optional<csg::Slot> csg::Node::slot(const SlotDirection dir, const boost:
 
 boost::optional<csg::SlotValue> csg::Node::slot_value(const size_t index) const
 {
-	const boost::optional<csg::Slot> the_slot{ slot(index) };
-	if (the_slot) {
-		return the_slot->value;
+	const SlotValue* const the_value{ slot_value_ptr(index) };
+	if (the_value) {
+		return *the_value;
 	}
 	else {
 		return boost::none;
 	}
 }
 
+const csg::SlotValue* csg::Node::slot_value_ptr(const size_t index) const
+{
+	const Slot* const the_slot{ slot_ptr(index) };
+	if (the_slot && the_slot->value) {
+		return &the_slot->value.get();
+	}
+	return nullptr;
+}
+
+const csg::SlotValue* csg::Node::slot_value_ptr(const boost::string_view& slot_name) const
+{
+	const boost::optional<size_t> opt_index{ slot_index(csg::SlotDirection::INPUT, slot_name) };
+	if (opt_index) {
+		return slot_value_ptr(*opt_index);
+	}
+	return nullptr;
+}
+
 boost::optional <csg::SlotValue> csg::Node::slot_value(const boost::string_view& slot_name) const
 {
 	const boost::optional<size_t> opt_index{ slot_index(csg::SlotDirection::INPUT, slot_name) };
@@ -735,6 +757,36 @@ void csg::Node::copy_from(const Node& other)
 	// Copy everything except id
 	_type = other._type;
 	_slots = other._slots;
+	update_hash();
+}
+
+void csg::Node::update_hash()
+{
+	uint64_t result{ csc::hash_value(_type) };
+	for (const Slot& this_slot : _slots) {
+		if (this_slot.value) {
+			result = this_slot.value->hash(result);
+		}
+	}
+	_content_hash = result;
+	result = csc::hash_value(position.x, result);
+	result = csc::hash_value(position.y, result);
+	_hash = result;
+}
+
+size_t csg::Node::memory_size() const
+{
+	size_t result{ sizeof(Node) };
+	result += (_slots.capacity() - _slots.size()) * sizeof(Slot);
+	for (const Slot& this_slot : _slots) {
+		result += sizeof(Slot);
+		if (this_slot.value) {
+			// The value is stored inline in the slot, only count what it owns on the heap
+			result += this_slot.value->memory_size() - sizeof(SlotValue);
+		}
+	}
+	result += _slot_aliases.capacity() * sizeof(std::pair<const char*, const char*>);
+	return result;
 }
 
 bool csg::Node::operator==(const Node& other) const
@@ -6,6 +6,7 @@
  */
 
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <utility>
@@ -41,11 +42,29 @@ namespace csg {
 		boost::optional<SlotValue> slot_value(const boost::string_view& slot_name) const;
 		Slot& slot_ref(size_t index) { return _slots[index]; }
 
+		// Non-copying accessors, the returned pointers are nullptr when the slot or value does not exist
+		// They stay valid until this node is modified or destroyed
+		const Slot* slot_ptr(size_t index) const { return index < _slots.size() ? &_slots[index] : nullptr; }
+		const SlotValue* slot_value_ptr(size_t index) const;
+		const SlotValue* slot_value_ptr(const boost::string_view& slot_name) const;
+
+		template <typename T> const T* slot_value_as_ptr(size_t index) const
+		{
+			const SlotValue* const value_ptr{ slot_value_ptr(index) };
+			return value_ptr ? value_ptr->as_ptr<T>() : nullptr;
+		}
+
+		template <typename T> const T* slot_value_as_ptr(const boost::string_view& slot_name) const
+		{
+			const SlotValue* const value_ptr{ slot_value_ptr(slot_name) };
+			return value_ptr ? value_ptr->as_ptr<T>() : nullptr;
+		}
+
 		template <typename T> boost::optional<T> slot_value_as(size_t index) const
 		{
-			const boost::optional<SlotValue> opt_value{ slot_value(index) };
-			if (opt_value) {
-				return opt_value->as<T>();
+			const T* const value_ptr{ slot_value_as_ptr<T>(index) };
+			if (value_ptr) {
+				return *value_ptr;
 			}
 			else {
 				return boost::none;
@@ -54,9 +73,9 @@ namespace csg {
 
 		template <typename T> boost::optional<T> slot_value_as(const std::string& slot_name) const
 		{
-			const boost::optional<SlotValue> opt_value{ slot_value(slot_name) };
-			if (opt_value) {
-				return opt_value->as<T>();
+			const T* const value_ptr{ slot_value_as_ptr<T>(boost::string_view{ slot_name }) };
+			if (value_ptr) {
+				return *value_ptr;
 			}
 			else {
 				return boost::none;
@@ -65,6 +84,16 @@ namespace csg {
 
 		void copy_from(const Node& other);
 
+		// Approximate number of bytes owned by this node, used to budget undo history
+		size_t memory_size() const;
+
+		// Hash of the node's type, position and slot values, the id is not included
+		// Must be refreshed with update_hash() after the node is modified
+		uint64_t hash() const { return _hash; }
+		// Same as hash() without the position, which does not affect generated code
+		uint64_t content_hash() const { return _content_hash; }
+		void update_hash();
+
 		bool has_pin(size_t index, SlotDirection direction) const { return index < _slots.size() && _slots[index].dir() == direction; }
 
 		bool operator==(const Node& other) const;
@@ -83,5 +112,7 @@ namespace csg {
 		NodeType _type;
 		std::vector<Slot> _slots;
 		std::vector<std::pair<const char*, const char*>> _slot_aliases;
+		uint64_t _hash;
+		uint64_t _content_hash;
 	};
 }
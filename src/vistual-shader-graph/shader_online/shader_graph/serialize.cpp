@@ -86,8 +86,8 @@ static std::string serialize_slot_value(const csg::SlotValue& slot_value)
 {
 	switch (slot_value.type()) {
 	case csg::SlotType::BOOL:
-		if (slot_value.as<csg::BoolSlotValue>().has_value()) {
-			const csg::BoolSlotValue bool_slot_value{ slot_value.as<csg::BoolSlotValue>().value() };
+		if (const csg::BoolSlotValue* const value_ptr = slot_value.as_ptr<csg::BoolSlotValue>()) {
+			const csg::BoolSlotValue& bool_slot_value{ *value_ptr };
 			if (bool_slot_value.get()) {
 				return "1";
 			}
@@ -97,8 +97,8 @@ static std::string serialize_slot_value(const csg::SlotValue& slot_value)
 		}
 		break;
 	case csg::SlotType::COLOR:
-		if (slot_value.as<csg::ColorSlotValue>().has_value()) {
-			const csg::ColorSlotValue color_slot_value{ slot_value.as<csg::ColorSlotValue>().value() };
+		if (const csg::ColorSlotValue* const value_ptr = slot_value.as_ptr<csg::ColorSlotValue>()) {
+			const csg::ColorSlotValue& color_slot_value{ *value_ptr };
 			const csc::Float3 color{ color_slot_value.get() };
 			std::stringstream sstream;
 			sstream << std::fixed << std::setprecision(SERIALIZED_GRAPH_PRECISION) << color.x << ',' << color.y << ',' << color.z;
@@ -106,30 +106,30 @@ static std::string serialize_slot_value(const csg::SlotValue& slot_value)
 		}
 		break;
 	case csg::SlotType::ENUM:
-		if (slot_value.as<csg::EnumSlotValue>().has_value()) {
-			const csg::EnumSlotValue enum_slot_value{ slot_value.as<csg::EnumSlotValue>().value() };
+		if (const csg::EnumSlotValue* const value_ptr = slot_value.as_ptr<csg::EnumSlotValue>()) {
+			const csg::EnumSlotValue& enum_slot_value{ *value_ptr };
 			return std::string{ enum_slot_value.internal_name() };
 		}
 		break;
 	case csg::SlotType::FLOAT:
-		if (slot_value.as<csg::FloatSlotValue>().has_value()) {
-			const csg::FloatSlotValue float_slot_value{ slot_value.as<csg::FloatSlotValue>().value() };
+		if (const csg::FloatSlotValue* const value_ptr = slot_value.as_ptr<csg::FloatSlotValue>()) {
+			const csg::FloatSlotValue& float_slot_value{ *value_ptr };
 			std::stringstream sstream;
 			sstream << std::fixed << std::setprecision(SERIALIZED_GRAPH_PRECISION) << float_slot_value.get();
 			return sstream.str();
 		}
 		break;
 	case csg::SlotType::INT:
-		if (slot_value.as<csg::IntSlotValue>().has_value()) {
-			const csg::IntSlotValue int_slot_value{ slot_value.as<csg::IntSlotValue>().value() };
+		if (const csg::IntSlotValue* const value_ptr = slot_value.as_ptr<csg::IntSlotValue>()) {
+			const csg::IntSlotValue& int_slot_value{ *value_ptr };
 			std::stringstream sstream;
 			sstream << int_slot_value.get();
 			return sstream.str();
 		}
 		break;
 	case csg::SlotType::VECTOR:
-		if (slot_value.as<csg::VectorSlotValue>().has_value()) {
-			const csg::VectorSlotValue vec_slot_value{ slot_value.as<csg::VectorSlotValue>().value() };
+		if (const csg::VectorSlotValue* const value_ptr = slot_value.as_ptr<csg::VectorSlotValue>()) {
+			const csg::VectorSlotValue& vec_slot_value{ *value_ptr };
 			const csc::Float3 color{ vec_slot_value.get() };
 			std::stringstream sstream;
 			sstream << std::fixed << std::setprecision(SERIALIZED_GRAPH_PRECISION) << color.x << ',' << color.y << ',' << color.z;
@@ -137,9 +137,9 @@ static std::string serialize_slot_value(const csg::SlotValue& slot_value)
 		}
 		break;
 	case csg::SlotType::CURVE_RGB:
-		if (slot_value.as<csg::RGBCurveSlotValue>().has_value()) {
+		if (const csg::RGBCurveSlotValue* const value_ptr = slot_value.as_ptr<csg::RGBCurveSlotValue>()) {
 			constexpr char CURVE_SEPARATOR{ '/' };
-			const csg::RGBCurveSlotValue rgb_slot_value{ slot_value.as<csg::RGBCurveSlotValue>().value() };
+			const csg::RGBCurveSlotValue& rgb_slot_value{ *value_ptr };
 			std::stringstream sstream;
 			sstream << std::fixed << std::setprecision(SERIALIZED_GRAPH_PRECISION);
 			sstream << "curve_rgb_00" << CURVE_SEPARATOR << "00" << CURVE_SEPARATOR;
@@ -151,9 +151,9 @@ static std::string serialize_slot_value(const csg::SlotValue& slot_value)
 		}
 		break;
 	case csg::SlotType::CURVE_VECTOR:
-		if (slot_value.as<csg::VectorCurveSlotValue>().has_value()) {
+		if (const csg::VectorCurveSlotValue* const value_ptr = slot_value.as_ptr<csg::VectorCurveSlotValue>()) {
 			constexpr char CURVE_SEPARATOR{ '/' };
-			const csg::VectorCurveSlotValue curve_slot_value{ slot_value.as<csg::VectorCurveSlotValue>().value() };
+			const csg::VectorCurveSlotValue& curve_slot_value{ *value_ptr };
 			std::stringstream sstream;
 			sstream << std::fixed << std::setprecision(SERIALIZED_GRAPH_PRECISION);
 			sstream << "curve_vec_00" << CURVE_SEPARATOR << "00" << CURVE_SEPARATOR;
@@ -166,9 +166,9 @@ static std::string serialize_slot_value(const csg::SlotValue& slot_value)
 		}
 		break;
 	case csg::SlotType::COLOR_RAMP:
-		if (slot_value.as<csg::ColorRampSlotValue>().has_value()) {
+		if (const csg::ColorRampSlotValue* const value_ptr = slot_value.as_ptr<csg::ColorRampSlotValue>()) {
 			constexpr char RAMP_SEPARATOR{ ',' };
-			const csg::ColorRampSlotValue ramp_slot_value{ slot_value.as<csg::ColorRampSlotValue>().value() };
+			const csg::ColorRampSlotValue& ramp_slot_value{ *value_ptr };
 			std::stringstream sstream;
 			sstream << std::fixed << std::setprecision(SERIALIZED_GRAPH_PRECISION);
 			sstream << "ramp00";
@@ -184,8 +184,8 @@ static std::string serialize_slot_value(const csg::SlotValue& slot_value)
 		}
 		break;
     case csg::SlotType::IMAGE:
-        if (slot_value.as<csg::ImageSlotValue>().has_value()) {
-            const csg::ImageSlotValue image_slot_value{ slot_value.as<csg::ImageSlotValue>().value() };
+        if (const csg::ImageSlotValue* const value_ptr = slot_value.as_ptr<csg::ImageSlotValue>()) {
+            const csg::ImageSlotValue& image_slot_value{ *value_ptr };
             std::stringstream sstream;
             sstream << image_slot_value.get();
             return sstream.str();
@@ -263,9 +263,9 @@ std::string csg::serialize_graph(const Graph& graph)
 		assert(opt_node_dest.use_count() > 0);
 
 		// Now we need to get the slots to find the slot names
-		const auto opt_slot_src{ opt_node_src->slot(connection.source().index()) };
-		const auto opt_slot_dest{ opt_node_dest->slot(connection.dest().index()) };
-		if (opt_slot_src.has_value() == false || opt_slot_dest.has_value() == false) {
+		const Slot* const opt_slot_src{ opt_node_src->slot_ptr(connection.source().index()) };
+		const Slot* const opt_slot_dest{ opt_node_dest->slot_ptr(connection.dest().index()) };
+		if (opt_slot_src == nullptr || opt_slot_dest == nullptr) {
 			// One of the slots is not real, ignore this connection
 			continue;
 		}
@@ -684,12 +684,12 @@ boost::optional<csg::Graph> csg::deserialize_graph(const std::string& graph_stri
 
 			const boost::optional<size_t> opt_slot_index{ node->slot_index(SlotDirection::INPUT, input_name) };
 			if (opt_slot_index.has_value()) {
-				const boost::optional<Slot> opt_slot = node->slot(*opt_slot_index);
-				assert(opt_slot.has_value());
+				const Slot* const opt_slot{ node->slot_ptr(*opt_slot_index) };
+				assert(opt_slot != nullptr);
 				if (opt_slot->value.has_value()) {
 					const SlotId slot_id{ node->id(), *opt_slot_index };
 					// Choose how we interpret 'input_value' based on the slot type
-					switch (opt_slot.value().type()) {
+					switch (opt_slot->type()) {
 					case SlotType::BOOL:
 					{
 						const bool bool_value{ static_cast<bool>(my_stoi(input_value)) };
@@ -788,27 +788,24 @@ boost::optional<csg::Graph> csg::deserialize_graph(const std::string& graph_stri
 					if (new_curve) {
 						const boost::optional<size_t> slot_index{ node->slot_index(csg::SlotDirection::INPUT, "curves") };
 						if (slot_index) {
-							const boost::optional<csg::Slot> slot{ node->slot(*slot_index) };
-							if (slot && slot->type() == csg::SlotType::CURVE_RGB) {
-								const boost::optional<csg::RGBCurveSlotValue> opt_curve{ slot->value->as<csg::RGBCurveSlotValue>() };
-								if (opt_curve) {
-									csg::RGBCurveSlotValue rgb_curve{ *opt_curve };
-									if (input_name == "rgb_curve") {
-										rgb_curve.set_all(*new_curve);
-										result.set_curve_rgb(csg::SlotId{ node_id, *slot_index }, rgb_curve);
-									}
-									else if (input_name == "r_curve") {
-										rgb_curve.set_r(*new_curve);
-										result.set_curve_rgb(csg::SlotId{ node_id, *slot_index }, rgb_curve);
-									}
-									else if (input_name == "g_curve") {
-										rgb_curve.set_g(*new_curve);
-										result.set_curve_rgb(csg::SlotId{ node_id, *slot_index }, rgb_curve);
-									}
-									else if (input_name == "b_curve") {
-										rgb_curve.set_b(*new_curve);
-										result.set_curve_rgb(csg::SlotId{ node_id, *slot_index }, rgb_curve);
-									}
+							const csg::RGBCurveSlotValue* const opt_curve{ node->slot_value_as_ptr<csg::RGBCurveSlotValue>(*slot_index) };
+							if (opt_curve) {
+								csg::RGBCurveSlotValue rgb_curve{ *opt_curve };
+								if (input_name == "rgb_curve") {
+									rgb_curve.set_all(*new_curve);
+									result.set_curve_rgb(csg::SlotId{ node_id, *slot_index }, rgb_curve);
+								}
+								else if (input_name == "r_curve") {
+									rgb_curve.set_r(*new_curve);
+									result.set_curve_rgb(csg::SlotId{ node_id, *slot_index }, rgb_curve);
+								}
+								else if (input_name == "g_curve") {
+									rgb_curve.set_g(*new_curve);
+									result.set_curve_rgb(csg::SlotId{ node_id, *slot_index }, rgb_curve);
+								}
+								else if (input_name == "b_curve") {
+									rgb_curve.set_b(*new_curve);
+									result.set_curve_rgb(csg::SlotId{ node_id, *slot_index }, rgb_curve);
 								}
 							}
 						}
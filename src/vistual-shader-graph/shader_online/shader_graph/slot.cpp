@@ -2,14 +2,27 @@
 
 #include <cassert>
 #include <cmath>
+#include <cstring>
 
 #include <boost/algorithm/clamp.hpp>
 #include <boost/optional.hpp>
 
 #include "../shader_core/config.h"
+#include "../shader_core/hash.h"
 #include "../shader_core/rect.h"
 #include "../shader_core/vector.h"
 
+static uint64_t hash_curve(const csg::Curve& curve, uint64_t hash)
+{
+	hash = csc::hash_value(curve.min(), hash);
+	hash = csc::hash_value(curve.max(), hash);
+	for (const csg::CurvePoint& point : curve.control_points()) {
+		hash = csc::hash_value(point.pos, hash);
+		hash = csc::hash_value(point.interp, hash);
+	}
+	return hash;
+}
+
 static bool set_curve(csg::Curve& curve, const csg::Curve& new_value)
 {
 	if (new_value.min() != curve.min() || new_value.max() != curve.max()) {
@@ -249,6 +262,117 @@ template <> boost::optional<csg::ImageSlotValue> csg::SlotValue::as() const {
     return (type() != SlotType::IMAGE || static_cast<bool>(image_path_value) == false) ? boost::none : boost::optional<csg::ImageSlotValue>{ *image_path_value };
 }
 
+template <> const csg::BoolSlotValue* csg::SlotValue::as_ptr() const {
+	return (type() != SlotType::BOOL) ? nullptr : &value_union.bool_value;
+}
+template <> const csg::ColorSlotValue* csg::SlotValue::as_ptr() const {
+	return (type() != SlotType::COLOR) ? nullptr : &value_union.color_value;
+}
+template <> const csg::EnumSlotValue* csg::SlotValue::as_ptr() const {
+	return (type() != SlotType::ENUM) ? nullptr : &value_union.enum_value;
+}
+template <> const csg::FloatSlotValue* csg::SlotValue::as_ptr() const {
+	return (type() != SlotType::FLOAT) ? nullptr : &value_union.float_value;
+}
+template <> const csg::IntSlotValue* csg::SlotValue::as_ptr() const {
+	return (type() != SlotType::INT) ? nullptr : &value_union.int_value;
+}
+template <> const csg::VectorSlotValue* csg::SlotValue::as_ptr() const {
+	return (type() != SlotType::VECTOR) ? nullptr : &value_union.vector_value;
+}
+template <> const csg::RGBCurveSlotValue* csg::SlotValue::as_ptr() const {
+	return (type() != SlotType::CURVE_RGB) ? nullptr : curve_rgb_value.get();
+}
+template <> const csg::VectorCurveSlotValue* csg::SlotValue::as_ptr() const {
+	return (type() != SlotType::CURVE_VECTOR) ? nullptr : curve_vector_value.get();
+}
+template <> const csg::ColorRampSlotValue* csg::SlotValue::as_ptr() const {
+	return (type() != SlotType::COLOR_RAMP) ? nullptr : color_ramp_value.get();
+}
+template <> const csg::ImageSlotValue* csg::SlotValue::as_ptr() const {
+	return (type() != SlotType::IMAGE) ? nullptr : image_path_value.get();
+}
+
+size_t csg::SlotValue::memory_size() const
+{
+	size_t result{ sizeof(SlotValue) };
+	if (curve_rgb_value) {
+		result += sizeof(RGBCurveSlotValue);
+		result += curve_rgb_value->get_all_ptr()->control_points().capacity() * sizeof(CurvePoint);
+		result += curve_rgb_value->get_x_ptr()->control_points().capacity() * sizeof(CurvePoint);
+		result += curve_rgb_value->get_y_ptr()->control_points().capacity() * sizeof(CurvePoint);
+		result += curve_rgb_value->get_z_ptr()->control_points().capacity() * sizeof(CurvePoint);
+	}
+	if (curve_vector_value) {
+		result += sizeof(VectorCurveSlotValue);
+		result += curve_vector_value->get_x_ptr()->control_points().capacity() * sizeof(CurvePoint);
+		result += curve_vector_value->get_y_ptr()->control_points().capacity() * sizeof(CurvePoint);
+		result += curve_vector_value->get_z_ptr()->control_points().capacity() * sizeof(CurvePoint);
+	}
+	if (color_ramp_value) {
+		result += sizeof(ColorRampSlotValue);
+		result += color_ramp_value->get_ptr()->size() * sizeof(ColorRampPoint);
+	}
+	if (image_path_value) {
+		result += sizeof(ImageSlotValue);
+	}
+	return result;
+}
+
+uint64_t csg::SlotValue::hash(uint64_t seed) const
+{
+	uint64_t hash{ csc::hash_value(_type, seed) };
+	switch (_type) {
+	case SlotType::BOOL:
+		return csc::hash_value(value_union.bool_value.get(), hash);
+	case SlotType::COLOR:
+		return csc::hash_value(value_union.color_value.get(), hash);
+	case SlotType::ENUM:
+		hash = csc::hash_value(value_union.enum_value.get_meta(), hash);
+		return csc::hash_value(value_union.enum_value.get(), hash);
+	case SlotType::FLOAT:
+		return csc::hash_value(value_union.float_value.get(), hash);
+	case SlotType::INT:
+		return csc::hash_value(value_union.int_value.get(), hash);
+	case SlotType::VECTOR:
+		return csc::hash_value(value_union.vector_value.get(), hash);
+	case SlotType::CURVE_RGB:
+		if (curve_rgb_value) {
+			hash = hash_curve(*curve_rgb_value->get_all_ptr(), hash);
+			hash = hash_curve(*curve_rgb_value->get_x_ptr(), hash);
+			hash = hash_curve(*curve_rgb_value->get_y_ptr(), hash);
+			hash = hash_curve(*curve_rgb_value->get_z_ptr(), hash);
+		}
+		return hash;
+	case SlotType::CURVE_VECTOR:
+		if (curve_vector_value) {
+			hash = hash_curve(*curve_vector_value->get_x_ptr(), hash);
+			hash = hash_curve(*curve_vector_value->get_y_ptr(), hash);
+			hash = hash_curve(*curve_vector_value->get_z_ptr(), hash);
+		}
+		return hash;
+	case SlotType::COLOR_RAMP:
+		if (color_ramp_value) {
+			const ColorRamp& ramp{ *color_ramp_value->get_ptr() };
+			for (size_t i = 0; i < ramp.size(); i++) {
+				const ColorRampPoint point{ ramp.get(i) };
+				hash = csc::hash_value(point.pos, hash);
+				hash = csc::hash_value(point.color, hash);
+				hash = csc::hash_value(point.alpha, hash);
+			}
+		}
+		return hash;
+	case SlotType::IMAGE:
+		if (image_path_value) {
+			const char* const path{ image_path_value->get() };
+			hash = csc::hash_bytes(path, strlen(path), hash);
+		}
+		return hash;
+	default:
+		return hash;
+	}
+}
+
 bool csg::SlotValue::operator==(const SlotValue& other) const
 {
 	if (_type != other._type) {
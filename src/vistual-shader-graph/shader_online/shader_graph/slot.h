@@ -2,6 +2,7 @@
 
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 
 #include <boost/optional.hpp>
@@ -227,6 +228,7 @@ namespace csg {
 		ColorRampSlotValue(ColorRamp ramp) : ramp{ ramp } {}
 
 		ColorRamp get() const { return ramp; }
+		const ColorRamp* get_ptr() const { return &ramp; }
 		void set(ColorRamp new_ramp) { ramp = new_ramp; }
 		void set(ColorRampSlotValue new_ramp) { *this = new_ramp; }
  
@@ -280,12 +282,21 @@ namespace csg {
 		// Base template function to get this object's value
 		// Needs to be specialized for each type
 		template <typename T> boost::optional<T> as() const { assert(false); }
+		// Same as as<T>() but points at the stored value instead of copying it
+		// Returns nullptr on type mismatch, the pointer is invalidated when this object changes
+		template <typename T> const T* as_ptr() const { assert(false); return nullptr; }
 
 		bool operator==(const SlotValue& other) const;
 		bool operator!=(const SlotValue& other) const { return operator==(other) == false; }
 
 		static size_t sizeof_union() { return sizeof(SlotValueUnion); }
 
+		// Approximate number of bytes owned by this value, including heap-allocated curve and ramp data
+		size_t memory_size() const;
+
+		// Content hash of the stored value, chained onto seed
+		uint64_t hash(uint64_t seed) const;
+
 	private:
 		union SlotValueUnion {
 		public:
@@ -327,6 +338,17 @@ namespace csg {
 	template <> boost::optional<ColorRampSlotValue> SlotValue::as() const;
     template <> boost::optional<ImageSlotValue> SlotValue::as() const;
 
+	template <> const BoolSlotValue* SlotValue::as_ptr() const;
+	template <> const ColorSlotValue* SlotValue::as_ptr() const;
+	template <> const EnumSlotValue* SlotValue::as_ptr() const;
+	template <> const FloatSlotValue* SlotValue::as_ptr() const;
+	template <> const IntSlotValue* SlotValue::as_ptr() const;
+	template <> const VectorSlotValue* SlotValue::as_ptr() const;
+	template <> const RGBCurveSlotValue* SlotValue::as_ptr() const;
+	template <> const VectorCurveSlotValue* SlotValue::as_ptr() const;
+	template <> const ColorRampSlotValue* SlotValue::as_ptr() const;
+    template <> const ImageSlotValue* SlotValue::as_ptr() const;
+
 	class Slot {
 	public:
 		// Creates a slot that does not have an editable value
@@ -386,7 +408,7 @@ namespace csg {
         static bool type_match(csg::SlotType slot_type1,csg::SlotType slot_type2);
         static const char* type_shader_name_str(csg::SlotType slot_type);
         
-        const char* getGPUVaryName(){
+        const char* getGPUVaryName() const {
             return _gpuVaryName;
         }
 
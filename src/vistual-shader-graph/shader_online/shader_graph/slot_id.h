@@ -6,6 +6,7 @@
  */
 
 #include <cstddef>
+#include <functional>
 
 #include "node_id.h"
 
@@ -38,3 +39,16 @@ namespace csg {
 
     };
 }
+
+namespace std {
+	/**
+	 * @brief Hash for SlotId so it can be used as a key in unordered containers.
+	 */
+	template <> struct hash<csg::SlotId> {
+		size_t operator()(const csg::SlotId& slot_id) const
+		{
+			const size_t node_hash{ std::hash<csg::NodeId>{}(slot_id.node_id()) };
+			return node_hash ^ (std::hash<size_t>{}(slot_id.index()) + 0x9e3779b9 + (node_hash << 6) + (node_hash >> 2));
+		}
+	};
+}
@@ -6,6 +6,8 @@
 #include "shaderc.h"
 #include <bx/commandline.h>
 #include <bx/filepath.h>
+#include <chrono>
+#include <set>
 
 
 #define MAX_TAGS 256
@@ -24,9 +26,74 @@ extern "C"
 
 namespace runshaderc
 {
-	bool g_verbose = false;
     static bx::DefaultAllocator s_allocator;
-    bx::AllocatorI* g_allocator = &s_allocator;
+    // set by compile() for the duration of one request
+    static thread_local bx::AllocatorI* s_threadAllocator = NULL;
+
+	bx::AllocatorI* getAllocator()
+	{
+		return NULL != s_threadAllocator ? s_threadAllocator : &s_allocator;
+	}
+
+	struct AllocatorScope
+	{
+		AllocatorScope(bx::AllocatorI* _allocator)
+			: m_prev(s_threadAllocator)
+		{
+			s_threadAllocator = _allocator;
+		}
+
+		~AllocatorScope()
+		{
+			s_threadAllocator = m_prev;
+		}
+
+		bx::AllocatorI* m_prev;
+	};
+
+	// set by compile() like s_threadAllocator, PhaseScope reports to it
+	static thread_local const PhaseObserver* s_threadPhaseObserver = NULL;
+
+	static int64_t phaseNowNs()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch() ).count();
+	}
+
+	PhaseScope::PhaseScope(const char* _phase)
+		: m_phase(NULL != s_threadPhaseObserver ? _phase : NULL)
+		, m_begin(NULL != m_phase ? phaseNowNs() : 0)
+	{
+	}
+
+	PhaseScope::~PhaseScope()
+	{
+		stop();
+	}
+
+	void PhaseScope::stop()
+	{
+		if (NULL != m_phase)
+		{
+			(*s_threadPhaseObserver)(m_phase, m_begin, phaseNowNs() );
+			m_phase = NULL;
+		}
+	}
+
+	struct PhaseObserverScope
+	{
+		PhaseObserverScope(const PhaseObserver& _observer)
+			: m_prev(s_threadPhaseObserver)
+		{
+			s_threadPhaseObserver = _observer ? &_observer : NULL;
+		}
+
+		~PhaseObserverScope()
+		{
+			s_threadPhaseObserver = m_prev;
+		}
+
+		const PhaseObserver* m_prev;
+	};
 	struct ShadingLang
 	{
 		enum Enum
@@ -327,6 +394,7 @@ namespace runshaderc
 		, keepIntermediate(false)
 		, optimize(false)
 		, optimizationLevel(3)
+		, verbose(false)
 	{
 	}
 
@@ -818,6 +886,7 @@ namespace runshaderc
 			tagptr->data = 0;
 			tagptr++;
 
+			PhaseScope phase("preprocess");
 			int result = fppPreProcess(m_tags);
 
 			return 0 == result;
@@ -2567,8 +2636,6 @@ namespace runshaderc
 			return bx::kExitFailure;
 		}
 
-		g_verbose = cmdLine.hasArg("verbose");
-
 		const char* filePath = cmdLine.findOption('f');
 		if (NULL == filePath)
 		{
@@ -2591,6 +2658,7 @@ namespace runshaderc
 		}
 
 		Options options;
+		options.verbose = cmdLine.hasArg("verbose");
 		options.inputFilePath = filePath;
 		options.outputFilePath = outFilePath;
 		options.shaderType = bx::toLower(type[0]);
@@ -2758,7 +2826,7 @@ namespace runshaderc
 
             if(outPut)
             {
-                bx::MemoryBlock mb(g_allocator);
+                bx::MemoryBlock mb(getAllocator() );
                 bx::MemoryWriter *memWriter = new bx::MemoryWriter(&mb);
 
                 compiled = compileShader(varying, commandLineComment.c_str(), data, size, options, memWriter);
@@ -2766,7 +2834,7 @@ namespace runshaderc
                 uint8_t* mbData = (uint8_t*)mb.more();
                 uint32_t mbSize = uint32_t(bx::getSize(memWriter) );
                 *outputSize = mbSize;
-                outputData = BX_ALLOC(g_allocator, mbSize);
+                outputData = BX_ALLOC(getAllocator(), mbSize);
                 bx::memCopy(outputData, mbData, mbSize);
                 delete memWriter;
             }else{
@@ -2807,6 +2875,292 @@ namespace runshaderc
 		return bx::kExitFailure;
 	}
 
+	static std::string joinPath(const std::string& _dir, const std::string& _fileName)
+	{
+		bx::FilePath fp(_dir.empty() ? _fileName.c_str() : _dir.c_str() );
+		if (!_dir.empty() )
+		{
+			fp.join(_fileName.c_str() );
+		}
+
+		return fp.getCPtr();
+	}
+
+	static std::string pathDir(const std::string& _filePath)
+	{
+		bx::FilePath fp(_filePath.c_str() );
+		bx::StringView path(fp.getPath() );
+		return std::string(path.getPtr(), path.getTerm() );
+	}
+
+	// Returns the file name of an #include line, _quoted is false for #include <...>.
+	static bool parseInclude(const std::string& _line, std::string& _fileName, bool& _quoted)
+	{
+		size_t pos = _line.find_first_not_of(" \t");
+		if (std::string::npos == pos
+		||  '#' != _line[pos])
+		{
+			return false;
+		}
+
+		pos = _line.find_first_not_of(" \t", pos+1);
+		if (std::string::npos == pos
+		||  0 != _line.compare(pos, 7, "include") )
+		{
+			return false;
+		}
+
+		pos = _line.find_first_not_of(" \t", pos+7);
+		if (std::string::npos == pos)
+		{
+			return false;
+		}
+
+		const char open = _line[pos];
+		if ('"' != open
+		&&  '<' != open)
+		{
+			return false;
+		}
+
+		const size_t end = _line.find('"' == open ? '"' : '>', pos+1);
+		if (std::string::npos == end)
+		{
+			return false;
+		}
+
+		_fileName = _line.substr(pos+1, end-pos-1);
+		_quoted   = '"' == open;
+		return true;
+	}
+
+	// True when the first two directives are #ifndef X / #define X.
+	static bool hasIncludeGuard(const std::string& _source)
+	{
+		std::string guard;
+		for (size_t pos = 0; pos < _source.size(); )
+		{
+			size_t eol = _source.find('\n', pos);
+			if (std::string::npos == eol)
+			{
+				eol = _source.size();
+			}
+
+			bx::StringView line = bx::strTrimSpace(bx::StringView(&_source[pos], int32_t(eol-pos) ) );
+			pos = eol+1;
+
+			if (line.isEmpty()
+			||  '#' != line.getPtr()[0])
+			{
+				continue;
+			}
+
+			bx::StringView parse(line.getPtr()+1, line.getTerm() );
+			bx::StringView directive = nextWord(parse);
+			bx::StringView name = nextWord(parse);
+			if (guard.empty() )
+			{
+				if (0 != bx::strCmp(directive, "ifndef") )
+				{
+					return false;
+				}
+				guard.assign(name.getPtr(), name.getTerm() );
+			}
+			else
+			{
+				return 0 == bx::strCmp(directive, "define")
+					&& 0 == bx::strCmp(name, guard.c_str() )
+					;
+			}
+		}
+
+		return false;
+	}
+
+	// Splices the #includes the resolver knows into the source before fcpp sees it.
+	struct IncludeExpander
+	{
+		IncludeExpander(const IncludeResolver& _resolver, const std::vector<std::string>& _includeDirs)
+			: m_resolver(_resolver)
+			, m_includeDirs(_includeDirs)
+		{
+		}
+
+		bool resolve(const std::string& _dir, const std::string& _fileName, bool _quoted, std::string& _filePath, std::string& _source)
+		{
+			if (!m_resolver)
+			{
+				return false;
+			}
+
+			if (_quoted)
+			{
+				_filePath = joinPath(_dir, _fileName);
+				if (m_resolver(_filePath, _source) )
+				{
+					return true;
+				}
+			}
+
+			for (size_t ii = 0; ii < m_includeDirs.size(); ++ii)
+			{
+				_filePath = joinPath(m_includeDirs[ii], _fileName);
+				if (m_resolver(_filePath, _source) )
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		bool expand(const std::string& _source, const std::string& _dir, uint32_t _depth, std::string& _out)
+		{
+			if (_depth > 32)
+			{
+				bx::printf("#include nested too deeply in '%s'.\n", _dir.c_str() );
+				return false;
+			}
+
+			for (size_t pos = 0; pos < _source.size(); )
+			{
+				size_t eol = _source.find('\n', pos);
+				eol = std::string::npos == eol ? _source.size() : eol+1;
+				const std::string line = _source.substr(pos, eol-pos);
+				pos = eol;
+
+				std::string fileName;
+				bool quoted;
+				std::string filePath;
+				std::string source;
+				if (!parseInclude(line, fileName, quoted)
+				||  !resolve(_dir, fileName, quoted, filePath, source) )
+				{
+					_out += line;
+					continue;
+				}
+
+				// the guard is still defined, fcpp would skip the file anyway
+				if (0 != m_guarded.count(filePath) )
+				{
+					_out += "\n";
+					continue;
+				}
+
+				if (hasIncludeGuard(source) )
+				{
+					m_guarded.insert(filePath);
+				}
+
+				if (!expand(source, pathDir(filePath), _depth+1, _out) )
+				{
+					return false;
+				}
+				_out += "\n";
+			}
+
+			return true;
+		}
+
+		const IncludeResolver& m_resolver;
+		const std::vector<std::string>& m_includeDirs;
+		std::set<std::string> m_guarded;
+	};
+
+	bool expandIncludes(const Options& _options, const std::string& _source, const IncludeResolver& _resolver, std::string& _out)
+	{
+		const std::string dir = pathDir(_options.inputFilePath);
+		std::vector<std::string> includeDirs = _options.includeDirs;
+		includeDirs.push_back(dir);
+
+		_out.clear();
+		IncludeExpander expander(_resolver, includeDirs);
+		return expander.expand(_source, dir, 0, _out);
+	}
+
+	const char* getVersionString()
+	{
+		return BX_STRINGIZE(BGFX_SHADERC_VERSION_MAJOR) "." BX_STRINGIZE(BGFX_SHADERC_VERSION_MINOR) "." BX_STRINGIZE(BGFX_SHADER_BIN_VERSION);
+	}
+
+	CompileResult compile(const CompileRequest& _request)
+	{
+		CompileResult result;
+		AllocatorScope allocatorScope(_request.allocator);
+		PhaseObserverScope phaseObserverScope(_request.phaseObserver);
+
+		std::string source;
+		if (!expandIncludes(_request.options, _request.source, _request.includeResolver, source) )
+		{
+			result.error = "Failed to expand #include in '" + _request.options.inputFilePath + "'.";
+			return result;
+		}
+
+		Options options = _request.options;
+		// these write files next to outputFilePath
+		options.depends          = false;
+		options.disasm           = false;
+		options.keepIntermediate = false;
+		options.includeDirs.push_back(pathDir(options.inputFilePath) );
+
+		const char* varying = NULL;
+		if ('c' != options.shaderType)
+		{
+			varying = _request.varying.c_str();
+			if (_request.varying.empty() )
+			{
+				bx::printf("ERROR: Empty varying def for \"%s\" No input/output semantics will be generated in the code!\n", options.inputFilePath.c_str() );
+			}
+		}
+
+		const size_t padding = 16384;
+		uint32_t size = (uint32_t)source.size();
+		char* data = new char[size+padding+1];
+		bx::memCopy(data, source.c_str(), size);
+
+		// Compiler generates "error X3000: syntax error: unexpected end of file"
+		// if input doesn't have empty line at EOF.
+		data[size] = '\n';
+		bx::memSet(&data[size+1], 0, padding);
+
+		std::string comment = "// shaderc in-memory source: ";
+		comment += options.inputFilePath;
+		comment += "\n\n";
+
+		bx::MemoryBlock mb(getAllocator() );
+		bx::MemoryWriter writer(&mb);
+		result.success = compileShader(varying, comment.c_str(), data, size, options, &writer);
+		delete [] data;
+
+		if (!result.success)
+		{
+			result.error = "Failed to build shader '" + options.inputFilePath + "'.";
+			return result;
+		}
+
+		const uint8_t* mbData = (const uint8_t*)mb.more();
+		result.binary.assign(mbData, mbData + uint32_t(bx::getSize(&writer) ) );
+		return result;
+	}
+
+	bool compileShaderMemory(const Options& _options, const std::string& _source, const std::string& _varying, const IncludeResolver& _resolver, std::vector<uint8_t>& _output)
+	{
+		CompileRequest request;
+		request.options         = _options;
+		request.source          = _source;
+		request.varying         = _varying;
+		request.includeResolver = _resolver;
+
+		CompileResult result = compile(request);
+		if (!result.success)
+		{
+			bx::printf("%s\n", result.error.c_str() );
+		}
+
+		_output = std::move(result.binary);
+		return result.success;
+	}
+
 } // namespace bgfx
 
 //int main(int _argc, const char* _argv[])
@@ -6,10 +6,6 @@
 #ifndef SHADERC_H_HEADER_GUARD
 #define SHADERC_H_HEADER_GUARD
 
-namespace runshaderc
-{
-	extern bool g_verbose;
-}
 //
 //#define _BX_TRACE(_format, ...)                                                          \
 //				BX_MACRO_BLOCK_BEGIN                                                     \
@@ -48,6 +44,7 @@ namespace runshaderc
 #include <stdint.h>
 #include <string.h>
 #include <algorithm>
+#include <functional>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -66,8 +63,25 @@ using namespace bgfx;
 
 namespace runshaderc
 {
-	extern bool g_verbose;
-    extern bx::AllocatorI* g_allocator;
+	/// Allocator of the compile() running on this thread, a shared bx::DefaultAllocator otherwise.
+	bx::AllocatorI* getAllocator();
+
+	/// Told how long each phase of a compile() took: "preprocess", "glsl-optimizer", "glslang",
+	/// "spirv-opt" or "spirv-cross". _phase is a string literal, times are steady_clock nanoseconds.
+	typedef std::function<void(const char* _phase, int64_t _beginNs, int64_t _endNs)> PhaseObserver;
+
+	/// Times a phase for the PhaseObserver of the compile() running on this thread, does nothing without one.
+	struct PhaseScope
+	{
+		PhaseScope(const char* _phase);
+		~PhaseScope();
+
+		/// Ends the phase before the scope does.
+		void stop();
+
+		const char* m_phase;
+		int64_t m_begin;
+	};
 
 	bx::StringView nextWord(bx::StringView& _parse);
 
@@ -143,6 +157,8 @@ namespace runshaderc
 
 		bool optimize;
 		uint32_t optimizationLevel;
+
+		bool verbose;
 	};
 
 	typedef std::vector<Uniform> UniformArray;
@@ -162,6 +178,56 @@ namespace runshaderc
 
 
     int compileShader(int _argc, const char* const* _arg,bool outPut = false,void* outputData = nullptr,uint32_t* outputSize = 0);
+
+	/// Returns the text of an #include, _filePath is already joined with the including file's
+	/// dir or one of the include dirs. Returning false leaves the #include to fcpp, which reads it from disk.
+	typedef std::function<bool(const std::string& _filePath, std::string& _source)> IncludeResolver;
+
+	/// Splices the includes _resolver knows into _source, the result depends only on the text of
+	/// the source and of the resolved files. Also done by compileShaderMemory, running it again is a no-op.
+	bool expandIncludes(const Options& _options, const std::string& _source, const IncludeResolver& _resolver, std::string& _out);
+
+	/// "major.minor.binVersion", changes whenever the compiled output may change.
+	const char* getVersionString();
+
+	struct CompileRequest
+	{
+		CompileRequest()
+			: allocator(NULL)
+		{
+		}
+
+		Options options;
+		std::string source;
+		std::string varying;              ///< contents of varying.def.sc, unused for compute shaders
+		IncludeResolver includeResolver;  ///< may be empty, every #include then goes to fcpp
+		bx::AllocatorI* allocator;        ///< used for all of this request's allocations, NULL for the default
+		PhaseObserver phaseObserver;      ///< may be empty
+	};
+
+	struct CompileResult
+	{
+		CompileResult()
+			: success(false)
+		{
+		}
+
+		bool success;
+		std::vector<uint8_t> binary;
+		std::string error;
+	};
+
+	/// Compiles one stage from memory. Reentrant: every piece of state lives in the request or on
+	/// the stack, so requests for different graphs, stages and profiles can be issued from any number
+	/// of threads. The GLSL/ESSL (glsl-optimizer) and HLSL (d3dcompiler) backends are serialized behind
+	/// a process-wide mutex though, only preprocessing and the SPIR-V and Metal backends run in parallel.
+	/// Diagnostics from fcpp and the backends still go to bx::printf.
+	CompileResult compile(const CompileRequest& _request);
+
+	/// Compiles _source with _varying as varying.def.sc and writes the shader binary to _output,
+	/// nothing is read from or written to disk except includes _resolver declines.
+	/// _options.inputFilePath only names the source, relative includes are resolved against its dir.
+	bool compileShaderMemory(const Options& _options, const std::string& _source, const std::string& _varying, const IncludeResolver& _resolver, std::vector<uint8_t>& _output);
 } // namespace bgfx
 
 #endif // SHADERC_H_HEADER_GUARD
@@ -5,6 +5,7 @@
 
 #include "shaderc.h"
 #include "glsl_optimizer.h"
+#include <mutex>
 
 namespace runshaderc { namespace glsl
 {
@@ -379,6 +380,10 @@ namespace runshaderc { namespace glsl
 
 	bool compileGLSLShader(const Options& _options, uint32_t _version, const std::string& _code, bx::WriterI* _writer)
 	{
+		// glslopt_cleanup releases mesa's process-wide glsl_type tables
+		static std::mutex s_mutex;
+		std::lock_guard<std::mutex> lock(s_mutex);
+		PhaseScope phase("glsl-optimizer");
 		return glsl::compile(_options, _version, _code, _writer);
 	}
 
@@ -17,6 +17,7 @@
 #include <d3dcompiler.h>
 #include <d3d11shader.h>
 #include <bx/os.h>
+#include <mutex>
 
 #ifndef D3D_SVF_USED
 #	define D3D_SVF_USED 2
@@ -80,7 +81,7 @@ namespace runshaderc { namespace hlsl
 	static const D3DCompiler* s_compiler;
 	static void* s_d3dcompilerdll;
 
-	const D3DCompiler* load()
+	const D3DCompiler* load(bool _verbose)
 	{
 		for (uint32_t ii = 0; ii < BX_COUNTOF(s_d3dcompiler); ++ii)
 		{
@@ -105,7 +106,7 @@ namespace runshaderc { namespace hlsl
 				continue;
 			}
 
-			if (g_verbose)
+			if (_verbose)
 			{
 				char filePath[bx::kMaxFilePath];
 				GetModuleFileNameA( (HMODULE)s_d3dcompilerdll, filePath, sizeof(filePath) );
@@ -562,7 +563,7 @@ namespace runshaderc { namespace hlsl
 			return false;
 		}
 
-		s_compiler = load();
+		s_compiler = load(_options.verbose);
 
 		bool result = false;
 		bool debug = _options.debugInformation;
@@ -827,6 +828,9 @@ namespace runshaderc { namespace hlsl
 
 	bool compileHLSLShader(const Options& _options, uint32_t _version, const std::string& _code, bx::WriterI* _writer)
 	{
+		// the d3dcompiler dll and its entry points are process-wide
+		static std::mutex s_mutex;
+		std::lock_guard<std::mutex> lock(s_mutex);
 		return hlsl::compile(_options, _version, _code, _writer, true);
 	}
 
@@ -288,6 +288,7 @@ namespace runshaderc { namespace metal
 			  shaderStrings
 			, BX_COUNTOF(shaderStrings)
 			);
+		PhaseScope glslangPhase("glslang");
 		bool compiled = shader->parse(&resourceLimits
 			, 110
 			, false
@@ -466,7 +467,7 @@ namespace runshaderc { namespace metal
 						uniforms.push_back(un);
 					}
 				}
-				if (g_verbose)
+				if (_options.verbose)
 				{
 					program->dumpReflection();
 				}
@@ -480,6 +481,7 @@ namespace runshaderc { namespace metal
 				options.disableOptimizer = false;
 
 				glslang::GlslangToSpv(*intermediate, spirv, &options);
+				glslangPhase.stop();
 
 				spvtools::Optimizer opt(SPV_ENV_VULKAN_1_0);
 
@@ -500,19 +502,23 @@ namespace runshaderc { namespace metal
 				spvtools::ValidatorOptions validatorOptions;
 				validatorOptions.SetBeforeHlslLegalization(true);
 
-				if (!opt.Run(
+				PhaseScope optPhase("spirv-opt");
+				const bool optimized = opt.Run(
 					  spirv.data()
 					, spirv.size()
 					, &spirv
 					, validatorOptions
 					, false
-					) )
+					);
+				optPhase.stop();
+
+				if (!optimized)
 				{
 					compiled = false;
 				}
 				else
 				{
-					if (g_verbose)
+					if (_options.verbose)
 					{
 						glslang::SpirvToolsDisassemble(std::cout, spirv, SPV_ENV_VULKAN_1_0);
 					}
@@ -618,7 +624,9 @@ namespace runshaderc { namespace metal
 							msl.add_msl_resource_binding( newBinding );
 						}
 
+						PhaseScope crossPhase("spirv-cross");
 						std::string source = msl.compile();
+						crossPhase.stop();
 
 						if ('c' == _options.shaderType)
 						{
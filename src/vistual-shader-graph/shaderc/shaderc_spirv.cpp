@@ -37,14 +37,14 @@ namespace runshaderc
 
 	void* TinyStlAllocator::static_allocate(size_t _bytes)
 	{
-		return BX_ALLOC(g_allocator, _bytes);
+		return BX_ALLOC(getAllocator(), _bytes);
 	}
 
 	void TinyStlAllocator::static_deallocate(void* _ptr, size_t /*_bytes*/)
 	{
 		if (NULL != _ptr)
 		{
-			BX_FREE(g_allocator, _ptr);
+			BX_FREE(getAllocator(), _ptr);
 		}
 	}
 } // namespace bgfx
@@ -462,6 +462,7 @@ namespace runshaderc { namespace spirv
 			  shaderStrings
 			, BX_COUNTOF(shaderStrings)
 			);
+		PhaseScope glslangPhase("glslang");
 		bool compiled = shader->parse(&resourceLimits
 			, 110
 			, false
@@ -669,7 +670,7 @@ namespace runshaderc { namespace spirv
 					}
 				}
 
-				if (g_verbose)
+				if (_options.verbose)
 				{
 					program->dumpReflection();
 				}
@@ -683,6 +684,7 @@ namespace runshaderc { namespace spirv
 				options.disableOptimizer = false;
 
 				glslang::GlslangToSpv(*intermediate, spirv, &options);
+				glslangPhase.stop();
 
 				spvtools::Optimizer opt(getSpirvTargetVersion(_version));
 
@@ -703,19 +705,23 @@ namespace runshaderc { namespace spirv
 				spvtools::ValidatorOptions validatorOptions;
 				validatorOptions.SetBeforeHlslLegalization(true);
 
-				if (!opt.Run(
+				PhaseScope optPhase("spirv-opt");
+				const bool optimized = opt.Run(
 					  spirv.data()
 					, spirv.size()
 					, &spirv
 					, validatorOptions
 					, false
-					) )
+					);
+				optPhase.stop();
+
+				if (!optimized)
 				{
 					compiled = false;
 				}
 				else
 				{
-					if (g_verbose)
+					if (_options.verbose)
 					{
 						glslang::SpirvToolsDisassemble(std::cout, spirv, getSpirvTargetVersion(_version));
 					}
@@ -3,9 +3,11 @@
 * License: https://github.com/zwluoqi/mobile-visual-shader-editor#license-bsd-2-clause
 */
 
+#include <future>
 #include "user_engine.h"
 #include "../common/entry/input.h"
 #include "vsg_global.h"
+#include "profiler.h"
 
 namespace userengine {
 
@@ -20,50 +22,65 @@ namespace userengine {
         const std::shared_ptr<cse::SharedState> shared_state = self->shared_state;
         
         uint32_t shaderUniformStreamSize = 0;
+        uint32_t uniformLayoutVersion = 0;
+        uint64_t programKey = 0;
         void* shaderUniformStreamData = nullptr;
         
-        uint32_t uniformChangeStreamSize = 0;
-        void* uniformChangeStreamData = nullptr;
-        while (true) {
-            if (shared_state->output_updated()) {
-                float startCTime = vsg::get_cur_time();
-
+        std::vector<csc::UniformChangeData> uniformChanges;//复用, 拖动时不再每次realloc
+        //连续拖动/输入时图会一直变, 停下来这么久才开始编译
+        const std::chrono::milliseconds compileDebounce(80);
+        while (!shared_state->should_stop()) {
+            //没有事情做的时候睡在条件变量上, 不再空转
+            bool compile = shared_state->wait_for_work(compileDebounce);
+            
+            if (shared_state->get_uniform_updated(uniformChanges)) {
+                csc::ProfileScope uniformPhase("apply uniforms");
+                scene->reset_shader_uniform_data(uniformChanges.data(),(uint32_t)(uniformChanges.size()*sizeof(csc::UniformChangeData)));
+            }
+            
+            if (compile && shared_state->output_updated()) {
+                csc::ProfileScope pipelinePhase("compile pipeline");
 
+                csc::ProfileScope snapshotPhase("graph snapshot");
                 std::string graphContent;
                 std::string fragment;
                 std::string vertex;
-                std::string vardefine; shared_state->get_output_code(graphContent,vertex,fragment,vardefine,shaderUniformStreamData,shaderUniformStreamSize);
+                std::string vardefine; shared_state->get_output_code(graphContent,vertex,fragment,vardefine,shaderUniformStreamData,shaderUniformStreamSize,uniformLayoutVersion,programKey);
+                snapshotPhase.stop();
                 
                 bool isDocument = shared_state->isDocumentPath();
 
-                if(graphContent.size()>0){
+                if(graphContent.size()>0){//只有图本身需要保存, shader源码和二进制都留在内存里
+                    csc::ProfileScope writePhase("write graph file");
                     auto filePath = shared_state->getNodeDataFilePathWithPrefix();
                     vsg::write_file(filePath.c_str(), (void*)graphContent.c_str(), (uint32_t)graphContent.length(),isDocument);
                 }
                 
-                auto vertexfilePath = shared_state->getVertexFilePathWithPrefix();
-                vsg::write_file(vertexfilePath.c_str(), (void*)vertex.c_str(), (uint32_t)vertex.length(),isDocument);
-                auto fragfilePath = shared_state->getFragFilePathWithPrefix();
-                vsg::write_file(fragfilePath.c_str(), (void*)fragment.c_str(), (uint32_t)fragment.length(),isDocument);
-                auto varfilePath = shared_state->getVaringFilePathWithPrefix();
-                vsg::write_file(varfilePath.c_str(), (void*)vardefine.c_str(), (uint32_t)vardefine.length(),isDocument);
-
-                bool success1 = vsg::compile_shader(vertexfilePath.c_str() ,shared_state->getVertexName().c_str(),"vertex");
-                bool success2 = vsg::compile_shader(fragfilePath.c_str(),shared_state->getFragName().c_str(),"fragment");
+                std::vector<uint8_t> vertexBin;
+                std::vector<uint8_t> fragBin;
+                bool success1 = true;
+                bool success2 = true;
+                //结构没变或者切回了之前的结构, program还在, 只换参数表
+                if(!scene->has_shader_program(programKey)){
+                    auto vertexfilePath = shared_state->getVertexFilePathWithPrefix();
+                    auto fragfilePath = shared_state->getFragFilePathWithPrefix();
+                    //两个阶段互不依赖, 顶点放到另一个线程上和片元同时编译
+                    std::future<bool> vertexJob = std::async(std::launch::async,[&](){
+                        return vsg::compile_shader_memory(vertexfilePath.c_str(),vertex,vardefine,"vertex",vertexBin);
+                    });
+                    success2 = vsg::compile_shader_memory(fragfilePath.c_str(),fragment,vardefine,"fragment",fragBin);
+                    success1 = vertexJob.get();
+                }
 
-                if(success1 == 0 && success2 == 0){ scene->reload_shader_program(shared_state->getVertexName().c_str(),shared_state->getFragName().c_str(),shaderUniformStreamData,shaderUniformStreamSize);
+                if(shared_state->output_updated()){
+                    //编译期间又来了新的图, 这次的结果已经过时, 直接丢掉去编译最新的(二进制已经进了缓存)
+                }else if(success1 && success2){ scene->stage_shader_program(programKey,shared_state->getVertexName(),std::move(vertexBin),shared_state->getFragName(),std::move(fragBin),shaderUniformStreamData,shaderUniformStreamSize,uniformLayoutVersion);
                 }else{
                     //tips error
                 }
-                float endCTime = vsg::get_cur_time();
-                bx::printf("compileShader time:%f",(endCTime-startCTime));
-            }
-            
-            if (shared_state->uniform_updated()) {
-                shared_state->get_uniform_updated(uniformChangeStreamData,uniformChangeStreamSize);
-                scene->reset_shader_uniform_data(uniformChangeStreamData,uniformChangeStreamSize);
             }
         }
+        free(shaderUniformStreamData);
         return 0;
     }
 
@@ -211,11 +228,13 @@ namespace userengine {
         float proj[16];
         bx::mtxProj(proj, 60.0f, float(startSize.x)/float(startSize.y), 0.1f, 100.0f, bgfx::getCaps()->homogeneousDepth);
         bgfx::setViewTransform(SceneViewID, view, proj);
+        ue_ctx->scene->begin_frame();
         ue_ctx->scene->draw_call(_deltaTime,SceneViewID);
     }
      
     void run_shader_editor(){
 
+        ue_ctx->shared_state->poll_texture_loads(ue_ctx->scene->applied_layout_version());
         if (ue_ctx->shared_state->input_reload()) {
             uint32_t size = 0;
             auto isDocument =ue_ctx->shared_state->isDocumentPath();
@@ -307,6 +326,11 @@ namespace userengine {
     }
 
 
+    void destroy(){
+        ue_ctx->shared_state->request_stop();
+        ue_ctx->shader_complie_thread.shutdown();
+    }
+
     void add_scene_model(std::string& path){
         ue_ctx->scene->load_model(path);
     }
@@ -73,6 +73,8 @@ namespace userengine {
     const uint16_t SceneViewID = 160;
 
     std::shared_ptr<UEAppContext> init();
+    //停掉编译线程
+    void destroy();
     void add_scene_model(std::string& path);
 
     void run_scene_3dview(ImVec2 startPos, ImVec2 startSize);
@@ -3,9 +3,12 @@
 * License: https://github.com/zwluoqi/mobile-visual-shader-editor#license-bsd-2-clause
 */
 
+#include <array>
+#include <cstring>
 #include <vector>
 #include <memory>
 #include <map>
+#include <algorithm>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -22,6 +25,7 @@
 
 #include "Sky.h"
 #include "vsg_global.h"
+#include "profiler.h"
 
 #include "Scene.h"
 
@@ -41,64 +45,223 @@ namespace userengine {
         }
     }
 
-    void Scene::reload_shader_program(const char* vs_file_name,const char* fs_file_name,void* shader_uniform_stream_data,uint32_t shader_uniform_stream_size){
-        std::lock_guard<std::mutex> lock(reload_shader_program_mutex);//其他线程要求重新编译shader及重置uniform数据
+    bool Scene::has_shader_program(uint64_t program_key){
+        std::lock_guard<std::mutex> lock(program_cache_mutex);
+        return program_cache.keep(program_key);
+    }
+
+    void Scene::stage_shader_program(uint64_t program_key,const std::string& vs_name,std::vector<uint8_t>&& vs_data,const std::string& fs_name,std::vector<uint8_t>&& fs_data,void* shader_uniform_stream_data,uint32_t shader_uniform_stream_size,uint32_t layout_version){
+        std::unique_ptr<StagedShaderProgram> staged(new StagedShaderProgram());
+        staged->programKey = program_key;
+        staged->vsName = vs_name;
+        staged->vsData = std::move(vs_data);
+        staged->fsName = fs_name;
+        staged->fsData = std::move(fs_data);
+        staged->uniforms.assign(static_cast<csc::UniformData*>(shader_uniform_stream_data), static_cast<csc::UniformData*>(shader_uniform_stream_data) + shader_uniform_stream_size / sizeof(csc::UniformData));
+        staged->layoutVersion = layout_version;
         
-        bgfx::destroy(model_program_handle);
-        model_program_handle = vsg::load_shader_program(vs_file_name, fs_file_name);
-        std::vector<csc::UniformData> uniformDatas(static_cast<csc::UniformData*>(shader_uniform_stream_data), static_cast<csc::UniformData*>(shader_uniform_stream_data) + shader_uniform_stream_size / sizeof(csc::UniformData));
-        uniform_handle_map.clear();
-        cur_stream_shader_uniform_counter = 0;
-        for (const auto& this_point  : uniformDatas) {
-            auto bgfxUniformType = s_shaderRemap[this_point.uniformType];
-            ShaderUniformHandle* vec4Uniform = &stream_shader_uniform_handle[cur_stream_shader_uniform_counter];
-            if(bgfx::isValid(vec4Uniform->uniformHandle)){
-                bgfx::destroy(vec4Uniform->uniformHandle);
+        std::lock_guard<std::mutex> lock(staged_mutex);
+        staged_program = std::move(staged);
+    }
+    
+    void Scene::reset_shader_uniform_data(void* shader_uniform_stream_data,uint32_t shader_uniform_stream_size){
+        csc::UniformChangeData* uniformChangeDatas = static_cast<csc::UniformChangeData*>(shader_uniform_stream_data);
+        uint32_t arraySize = shader_uniform_stream_size/sizeof(csc::UniformChangeData);
+        
+        std::lock_guard<std::mutex> lock(staged_mutex);
+        for(uint32_t i=0;i<arraySize;i++){
+            //渲染线程没跟上时同一个参数只留最后一次的值
+            const csc::UniformChangeData& change = uniformChangeDatas[i];
+            auto same = std::find_if(staged_uniform_changes.begin(), staged_uniform_changes.end(), [&change](const csc::UniformChangeData& staged){
+                return staged.uniformIndex == change.uniformIndex && staged.layoutVersion == change.layoutVersion;
+            });
+            if(same != staged_uniform_changes.end()){
+                *same = change;
+            }else{
+                staged_uniform_changes.push_back(change);
+            }
+        }
+    }
+    
+    void Scene::begin_frame(){
+        frame_index++;
+        std::unique_ptr<StagedShaderProgram> staged;
+        {
+            //编译线程正拿着锁就下一帧再换, 渲染线程不等
+            std::unique_lock<std::mutex> lock(staged_mutex, std::try_to_lock);
+            if(lock.owns_lock()){
+                staged = std::move(staged_program);
+                frame_uniform_changes.swap(staged_uniform_changes);
             }
-            bgfx::UniformHandle u_handle = bgfx::createUniform(this_point.uniformName,bgfxUniformType);
-            vec4Uniform->_type = bgfxUniformType;
-            vec4Uniform->uniformHandle = u_handle;
-            cur_stream_shader_uniform_counter++;
-            if(this_point.uniformId!=0){//可以变化的参数
-                uniform_handle_map[this_point.uniformId] = vec4Uniform;
+        }
+        if(staged != nullptr){
+            swap_shader_program(*staged);
+        }
+        for(const auto& change : frame_uniform_changes){
+            stash_or_apply_uniform_change(change);
+        }
+        frame_uniform_changes.clear();
+        destroy_retired_programs(false);
+    }
+    
+    void Scene::swap_shader_program(StagedShaderProgram& staged){
+        bgfx::ProgramHandle program_handle;
+        {
+            std::lock_guard<std::mutex> lock(program_cache_mutex);
+            program_handle = program_cache.acquire(staged.programKey);
+        }
+        if(!bgfx::isValid(program_handle)){
+            csc::ProfileScope programPhase("create program");
+            program_handle = vsg::create_shader_program(staged.vsData, staged.vsName.c_str(), staged.fsData, staged.fsName.c_str());
+            programPhase.stop();
+            if(!bgfx::isValid(program_handle)){//二进制有问题, 保留旧的program
+                return;
+            }
+            std::lock_guard<std::mutex> lock(program_cache_mutex);
+            program_handle = program_cache.insert(staged.programKey, program_handle);
+        }
+        csc::ProfileScope rebindPhase("rebind uniforms");
+        //旧的program和uniform过几帧才销毁, 同名uniform新建时和旧的共用一个handle
+        retire_shader_program();
+        model_program_handle = program_handle;
+        model_program_key = staged.programKey;
+        stream_uniform_targets.assign(staged.uniforms.size(), StreamUniformTarget());
+        for (const auto& this_point  : staged.uniforms) {
+            if(this_point.uniformIndex >= stream_uniform_targets.size()){
+                continue;
+            }
+            StreamUniformTarget& target = stream_uniform_targets[this_point.uniformIndex];
+            if(this_point.packedOffset >= 0){//没有自己的uniform, 值放进打包数组
+                target.packedOffset = this_point.packedOffset;
+                target.packedCount = csc::packed_component_count(this_point.uniformType);
+                write_packed_uniform(target.packedOffset, target.packedCount, this_point.uniformUnionData.defaultValue);
+                continue;
+            }
+            if(strcmp(this_point.uniformName, csc::PACKED_PARAMS_NAME) == 0){
+                packed_uniform_handle = bgfx::createUniform(this_point.uniformName, bgfx::UniformType::Vec4, this_point.num);
+                if(packed_uniform_values.size() < this_point.num){
+                    packed_uniform_values.resize(this_point.num);
+                }
+                continue;
             }
+            auto bgfxUniformType = s_shaderRemap[this_point.uniformType];
+            ShaderUniformHandle vec4Uniform;
+            vec4Uniform._type = bgfxUniformType;
+            vec4Uniform.uniformHandle = bgfx::createUniform(this_point.uniformName,bgfxUniformType);
             
             if(bgfxUniformType == bgfx::UniformType::Vec4){
-                vec4Uniform->value_union = Vec4UniformHandle{this_point.uniformUnionData.defaultValue};
+                vec4Uniform.value_union = Vec4UniformHandle{this_point.uniformUnionData.defaultValue};
             }
             else if(bgfxUniformType == bgfx::UniformType::Sampler ){
-                vec4Uniform->value_union = SamplerUniformHandle{this_point.uniformUnionData.defaultTextureData.handle,this_point.uniformUnionData.defaultTextureData.samplerHandleIndex};
+                vec4Uniform.value_union = SamplerUniformHandle{this_point.uniformUnionData.defaultTextureData.handle,this_point.uniformUnionData.defaultTextureData.samplerHandleIndex};
             }
             else{
                 assert(false);
             }
+            target.handleIndex = static_cast<int32_t>(stream_shader_uniform_handle.size());
+            stream_shader_uniform_handle.push_back(vec4Uniform);
+        }
+        
+        //编译期间攒下的改值, 属于这一版参数表的补上, 更旧的丢掉
+        uniform_layout_version = staged.layoutVersion;
+        size_t keep = 0;
+        for(const auto& change : pending_uniform_changes){
+            if(change.layoutVersion == uniform_layout_version){
+                apply_uniform_change(change);
+            }else if(int32_t(change.layoutVersion - uniform_layout_version) > 0){
+                pending_uniform_changes[keep++] = change;
+            }
         }
+        pending_uniform_changes.resize(keep);
     }
     
-    void Scene::reset_shader_uniform_data(void* shader_uniform_stream_data,uint32_t shader_uniform_stream_size){
-        std::lock_guard<std::mutex> lock(uniform_change_mutex);//其他线程要求重置uniform数据
-        csc::UniformChangeData* uniformChangeDatas = static_cast<csc::UniformChangeData*>(shader_uniform_stream_data);
-        uint32_t arraySize = shader_uniform_stream_size/sizeof(csc::UniformChangeData);
-        uint64_t uniformId;
+    void Scene::retire_shader_program(){
+        RetiredShaderProgram retired;
+        retired.frame = frame_index;
+        retired.programKey = model_program_key;
+        retired.program = model_program_handle;
+        for (const auto& handle : stream_shader_uniform_handle) {
+            retired.uniforms.push_back(handle.uniformHandle);
+        }
+        retired.uniforms.push_back(packed_uniform_handle);
+        retired_programs.push_back(std::move(retired));
         
-        for(uint32_t i=0;i<arraySize;i++){
-            uniformId = uniformChangeDatas[i].uniformId;
-            if(uniformId ==0){
-                continue;
+        stream_shader_uniform_handle.clear();
+        packed_uniform_handle = BGFX_INVALID_HANDLE;
+        packed_uniform_values.clear();
+    }
+    
+    void Scene::destroy_retired_programs(bool all){
+        //bgfx::frame()提交之后渲染线程还可能在画上一帧, 多留几帧再释放
+        const uint64_t retireFrames = 3;
+        while(!retired_programs.empty() && (all || frame_index - retired_programs.front().frame >= retireFrames)){
+            const RetiredShaderProgram& retired = retired_programs.front();
+            if(retired.programKey != 0){
+                std::lock_guard<std::mutex> lock(program_cache_mutex);
+                program_cache.release(retired.programKey);
+            }else if(bgfx::isValid(retired.program)){
+                bgfx::destroy(retired.program);
             }
-            if(uniform_handle_map.count(uniformId)){
-                ShaderUniformHandle* handle = uniform_handle_map[uniformId];
-                if(handle->_type == bgfx::UniformType::Vec4){
-                    handle->value_union.vec4_value.vec = uniformChangeDatas[i].uniformUnionData.defaultValue;
-                }else if(handle->_type == bgfx::UniformType::Sampler){
-                    handle->value_union.sampler_value.tex = uniformChangeDatas[i].uniformUnionData.defaultTextureData.handle;
-                }else{
-                    assert(false);
+            for (const auto& uniform : retired.uniforms) {
+                if(bgfx::isValid(uniform)){
+                    bgfx::destroy(uniform);
                 }
             }
+            retired_programs.pop_front();
+        }
+    }
+    
+    void Scene::stash_or_apply_uniform_change(const csc::UniformChangeData& change){
+        if(change.layoutVersion == uniform_layout_version){
+            apply_uniform_change(change);
+        }else if(int32_t(change.layoutVersion - uniform_layout_version) > 0){//新参数表的program还没换上
+            //同一个参数只留最后一次的值, 编译失败时也不会越攒越多
+            auto same = std::find_if(pending_uniform_changes.begin(), pending_uniform_changes.end(), [&change](const csc::UniformChangeData& pending){
+                return pending.uniformIndex == change.uniformIndex && pending.layoutVersion == change.layoutVersion;
+            });
+            if(same != pending_uniform_changes.end()){
+                *same = change;
+            }else{
+                pending_uniform_changes.push_back(change);
+            }
+        }
+    }
+    
+    void Scene::apply_uniform_change(const csc::UniformChangeData& change){
+        if(change.uniformIndex >= stream_uniform_targets.size()){
+            return;
+        }
+        const StreamUniformTarget& target = stream_uniform_targets[change.uniformIndex];
+        if(target.packedOffset >= 0){
+            write_packed_uniform(target.packedOffset, target.packedCount, change.uniformUnionData.defaultValue);
+            return;
+        }
+        if(target.handleIndex < 0){
+            return;
+        }
+        ShaderUniformHandle* handle = &stream_shader_uniform_handle[target.handleIndex];
+        if(handle->_type == bgfx::UniformType::Vec4){
+            handle->value_union.vec4_value.vec = change.uniformUnionData.defaultValue;
+        }else if(handle->_type == bgfx::UniformType::Sampler){
+            handle->value_union.sampler_value.tex = change.uniformUnionData.defaultTextureData.handle;
+        }else{
+            assert(false);
         }
     }
     
+    void Scene::write_packed_uniform(int32_t offset,uint8_t count,const csc::Float4& value){
+        const size_t row = offset / 4;
+        if(packed_uniform_values.size() <= row){
+            packed_uniform_values.resize(row + 1);
+        }
+        std::array<float, 4> dst = packed_uniform_values[row].as_array();
+        const std::array<float, 4> src = value.as_array();
+        for(uint8_t i=0;i<count && offset % 4 + i < 4;i++){
+            dst[offset % 4 + i] = src[i];
+        }
+        packed_uniform_values[row] = csc::Float4(dst[0], dst[1], dst[2], dst[3]);
+    }
+    
     void Scene::draw_call(float deltaTime,int viewId){
         for (int i = 0; i < objects.size(); i++) {
             for(int l=0;l<lights.size();l++){
@@ -110,7 +273,9 @@ namespace userengine {
     }
 
     void Scene::destroy(){
-        bgfx::destroy(model_program_handle);
+        retire_shader_program();
+        destroy_retired_programs(true);
+        program_cache.destroy();
         for (int i = 0; i < objects.size(); i++) {
             objects[i]->destroy( );
         }
@@ -121,7 +286,10 @@ namespace userengine {
 
 
     void Scene::set_material_uniform_data(){
-        for(uint8_t i=0;i<cur_stream_shader_uniform_counter;i++) {
+        if(bgfx::isValid(packed_uniform_handle)){
+            bgfx::setUniform(packed_uniform_handle, packed_uniform_values.data(), static_cast<uint16_t>(packed_uniform_values.size()));
+        }
+        for(size_t i=0;i<stream_shader_uniform_handle.size();i++) {
             auto& this_point = stream_shader_uniform_handle[i];
             if(this_point._type == bgfx::UniformType::Sampler){
                 bgfx::setTexture(this_point.value_union.sampler_value.texIndex,this_point.uniformHandle, this_point.value_union.sampler_value.tex);
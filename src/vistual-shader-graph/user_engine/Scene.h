@@ -6,6 +6,7 @@
 #pragma once
 
 #include <vector>
+#include <deque>
 #include <memory>
 #include <map>
 
@@ -17,6 +18,7 @@
 #include "MeshUtil.h"
 #include "Object.h"
 #include "Light.h"
+#include "ShaderProgramCache.h"
 #include "../shader_online/shader_core/shader_def.h"
 
 namespace userengine {
@@ -30,10 +32,22 @@ namespace userengine {
         
         void load_model(std::string& path);
         
-        void reload_shader_program(const char* vs_file_name,const char* fs_file_name,void* shader_uniform_stream_data,uint32_t shader_uniform_stream_size);
+        //编译线程: 这个结构的program已经有了, 不用再编译, 换上之前不会被淘汰
+        bool has_shader_program(uint64_t program_key);
         
+        //编译线程: 交出新的program和参数表, 渲染线程下一帧开始时换上. 还没换上的上一份直接被替换
+        //program_key已经在缓存里时不用二进制, 只换参数表
+        void stage_shader_program(uint64_t program_key,const std::string& vs_name,std::vector<uint8_t>&& vs_data,const std::string& fs_name,std::vector<uint8_t>&& fs_data,void* shader_uniform_stream_data,uint32_t shader_uniform_stream_size,uint32_t layout_version);
+        
+        //编译线程: 改值也等到下一帧开始时应用
         void reset_shader_uniform_data(void* shader_uniform_stream_data,uint32_t shader_uniform_stream_size);
         
+        //渲染线程: 每帧draw_call之前调用, 换上交过来的program, 不等锁
+        void begin_frame();
+        
+        //渲染线程: 当前program的参数表版本, 更旧的参数表里的贴图不会再用到
+        uint32_t applied_layout_version() const { return uniform_layout_version; }
+        
         void draw_call(float deltaTime,int viewId);
 
         void destroy();
@@ -41,20 +55,49 @@ namespace userengine {
     private:
 
         void set_material_uniform_data();
+        
+        void swap_shader_program(StagedShaderProgram& staged);
+        
+        void retire_shader_program();
+        
+        void destroy_retired_programs(bool all);
+        
+        void stash_or_apply_uniform_change(const csc::UniformChangeData& change);
+        
+        void apply_uniform_change(const csc::UniformChangeData& change);
+        
+        void write_packed_uniform(int32_t offset,uint8_t count,const csc::Float4& value);
 
         MeshUtil mesh_util;
         std::vector<std::shared_ptr<userengine::Object> > objects;
         std::vector<std::shared_ptr<userengine::Light> > lights;
         
-        bgfx::ProgramHandle model_program_handle;
         bgfx::ProgramHandle light_program_handle;
         
-        ShaderUniformHandle stream_shader_uniform_handle[32];
-        uint8_t cur_stream_shader_uniform_counter = 0;
+        //下面这些到pending_uniform_changes只在渲染线程上用
+        bgfx::ProgramHandle model_program_handle;
+        uint64_t model_program_key = 0;//0: 不在program_cache里的默认program
+        
+        std::vector<ShaderUniformHandle> stream_shader_uniform_handle;
+        std::vector<StreamUniformTarget> stream_uniform_targets;//按参数表下标
+        //打包参数的值, 每次draw一次setUniform传完
+        bgfx::UniformHandle packed_uniform_handle{bgfx::kInvalidHandle};
+        std::vector<csc::Float4> packed_uniform_values;
+        //stream_shader_uniform_handle对应的参数表版本, 改值里的下标只在同一版本下有效
+        uint32_t uniform_layout_version = 0;
+        //比当前program新的参数表上的改值, 等那个版本的program装上后再用
+        std::vector<csc::UniformChangeData> pending_uniform_changes;
+        std::vector<csc::UniformChangeData> frame_uniform_changes;//和staged_uniform_changes交换, 复用内存
+        std::deque<RetiredShaderProgram> retired_programs;
+        uint64_t frame_index = 0;
         
-        std::mutex reload_shader_program_mutex;
+        //编译线程交给渲染线程的
+        std::mutex staged_mutex;
+        std::unique_ptr<StagedShaderProgram> staged_program;
+        std::vector<csc::UniformChangeData> staged_uniform_changes;
         
-        std::mutex uniform_change_mutex;
-        std::map<uint64_t,ShaderUniformHandle*> uniform_handle_map;
+        //编译线程查, 渲染线程取用和释放
+        std::mutex program_cache_mutex;
+        ShaderProgramCache program_cache;
     };
 }
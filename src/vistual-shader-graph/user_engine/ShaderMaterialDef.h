@@ -8,6 +8,7 @@
 #include <vector>
 #include <memory>
 #include <map>
+#include <string>
 
 #include "../shader_online/shader_core/shader_def.h"
 
@@ -71,4 +72,30 @@ namespace userengine {
         ShaderUniformHandle(const SamplerUniformHandle& vec4):_type{bgfx::UniformType::Sampler},value_union{vec4}{}
         ShaderUniformHandle(){}
     };
+    
+    //参数表里一项对应的位置: 自己的uniform, 或者打包数组里的几个float
+    struct StreamUniformTarget{
+        int32_t handleIndex = -1;
+        int32_t packedOffset = -1;
+        uint8_t packedCount = 0;
+    };
+    
+    //编译线程准备好的program和参数表, 渲染线程在下一帧开始时换上
+    struct StagedShaderProgram{
+        uint64_t programKey = 0;
+        std::string vsName;
+        std::vector<uint8_t> vsData;//program已经在缓存里时为空
+        std::string fsName;
+        std::vector<uint8_t> fsData;
+        std::vector<csc::UniformData> uniforms;
+        uint32_t layoutVersion = 0;
+    };
+    
+    //换下来的program和uniform, 等已经提交的几帧画完再销毁
+    struct RetiredShaderProgram{
+        uint64_t frame;
+        uint64_t programKey;//0: 不在缓存里, 直接销毁
+        bgfx::ProgramHandle program;
+        std::vector<bgfx::UniformHandle> uniforms;
+    };
 }
@@ -0,0 +1,77 @@
+/*
+* Copyright 2021-2021 Zhouwei. All rights reserved.
+* License: https://github.com/zwluoqi/mobile-visual-shader-editor#license-bsd-2-clause
+*/
+
+#include "ShaderProgramCache.h"
+
+namespace userengine {
+
+    ShaderProgramCache::ShaderProgramCache(size_t maxIdle):maxIdle{maxIdle}{
+    }
+
+    bool ShaderProgramCache::contains(uint64_t key) const{
+        return entries.count(key) > 0;
+    }
+
+    bool ShaderProgramCache::keep(uint64_t key){
+        kept_key = key;
+        return contains(key);
+    }
+
+    bgfx::ProgramHandle ShaderProgramCache::acquire(uint64_t key){
+        auto it = entries.find(key);
+        if(it == entries.end()){
+            bgfx::ProgramHandle invalid = BGFX_INVALID_HANDLE;
+            return invalid;
+        }
+        Entry& entry = it->second;
+        if(entry.refs == 0){
+            idle_keys.erase(entry.idle);
+        }
+        entry.refs++;
+        return entry.program;
+    }
+
+    bgfx::ProgramHandle ShaderProgramCache::insert(uint64_t key,bgfx::ProgramHandle program){
+        if(contains(key)){//同一个结构编了两次, 用已有的那个
+            bgfx::destroy(program);
+            return acquire(key);
+        }
+        Entry entry;
+        entry.program = program;
+        entry.refs = 1;
+        entries[key] = entry;
+        return program;
+    }
+
+    void ShaderProgramCache::release(uint64_t key){
+        auto it = entries.find(key);
+        if(it == entries.end() || it->second.refs == 0){
+            return;
+        }
+        Entry& entry = it->second;
+        if(--entry.refs > 0){
+            return;
+        }
+        entry.idle = idle_keys.insert(idle_keys.end(), key);
+        while(idle_keys.size() > maxIdle){
+            auto oldest = idle_keys.begin();
+            if(*oldest == kept_key && ++oldest == idle_keys.end()){
+                break;
+            }
+            auto evicted = entries.find(*oldest);
+            bgfx::destroy(evicted->second.program);
+            entries.erase(evicted);
+            idle_keys.erase(oldest);
+        }
+    }
+
+    void ShaderProgramCache::destroy(){
+        for(auto& entry : entries){
+            bgfx::destroy(entry.second.program);
+        }
+        entries.clear();
+        idle_keys.clear();
+    }
+}
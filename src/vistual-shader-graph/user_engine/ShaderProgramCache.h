@@ -0,0 +1,46 @@
+/*
+* Copyright 2021-2021 Zhouwei. All rights reserved.
+* License: https://github.com/zwluoqi/mobile-visual-shader-editor#license-bsd-2-clause
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <list>
+#include <unordered_map>
+
+#include "bgfx_utils.h"
+
+namespace userengine {
+
+    //按结构hash共享program, 只是参数默认值和贴图不同的材质用同一个program, 各自只有参数表不同
+    //没人用的program留着一些, 切回之前的结构时不用重新编译和创建
+    class ShaderProgramCache
+    {
+    public:
+        explicit ShaderProgramCache(size_t maxIdle = 16);
+
+        bool contains(uint64_t key) const;
+        //和contains一样, 另外在下次keep之前不淘汰这个key, 查到以后再来acquire时它一定还在
+        bool keep(uint64_t key);
+        //引用计数加一, 没有时返回无效handle
+        bgfx::ProgramHandle acquire(uint64_t key);
+        //新建的program放进来, 调用方持有一份引用, 返回以后要用的handle
+        bgfx::ProgramHandle insert(uint64_t key,bgfx::ProgramHandle program);
+        //引用归零后放进空闲LRU, 超出maxIdle的销毁
+        void release(uint64_t key);
+        void destroy();
+
+    private:
+        struct Entry{
+            bgfx::ProgramHandle program;
+            uint32_t refs = 0;
+            std::list<uint64_t>::iterator idle;//refs为0时在idle_keys里
+        };
+
+        size_t maxIdle;
+        uint64_t kept_key = 0;
+        std::unordered_map<uint64_t,Entry> entries;
+        std::list<uint64_t> idle_keys;//最近空闲的在后面
+    };
+}
@@ -3,6 +3,8 @@
  * License: https://github.com/zwluoqi/mobile-visual-shader-editor#license-bsd-2-clause
  */
 
+#include <bx/commandline.h>
+
 #include "common.h"
 #include "camera.h"
 #include "bgfx_utils.h"
@@ -51,6 +53,12 @@ public:
         vsg::init();
         ue_ctx = userengine::init();
         
+        //--texture-budget <MB>: 图片贴图最多占用的显存, 不传用DEFAULT_TEXTURE_BUDGET
+        bx::CommandLine cmdLine(_argc, _argv);
+        uint32_t textureBudgetMB = 0;
+        if (cmdLine.hasArg(textureBudgetMB, '\0', "texture-budget") && textureBudgetMB > 0) {
+            ue_ctx->shared_state->set_texture_budget(uint64_t(textureBudgetMB) << 20);
+        }
 
         std::string path = "meshes/spot/spot_triangulated_good.obj";
         userengine::add_scene_model(path);
@@ -61,6 +69,7 @@ public:
 
     int shutdown() override
     {
+        userengine::destroy();
         vsg::destroy();
         
         cameraDestroy();
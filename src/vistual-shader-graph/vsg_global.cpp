@@ -4,8 +4,12 @@
 */
 
 #include <sstream>
+#include <mutex>
+#include <unordered_map>
 #include <sys/stat.h>
+#include <bx/file.h>
 #include "vsg_global.h"
+#include "profiler.h"
 
 namespace vsg {
 
@@ -98,6 +102,69 @@ namespace vsg {
     }
 
 
+    bgfx::ShaderHandle create_shader(const std::vector<uint8_t>& data, const char* _name)
+    {
+        bgfx::ShaderHandle handle = bgfx::createShader(bgfx::copy(data.data(), (uint32_t)data.size()) );
+        if (isValid(handle) )
+        {
+            bgfx::setName(handle, _name);
+        }
+
+        return handle;
+    }
+
+    //include文件读过一次后留在内存里, 文件的修改时间或大小变了就重新读, 编辑器开着时改.cginc/.sh也能生效
+    struct IncludeSource{
+        time_t mtime;
+        off_t size;
+        std::string source;
+    };
+    static std::mutex include_source_mutex;
+    static std::unordered_map<std::string,IncludeSource> include_sources;
+
+    //两个阶段同时编译时都会走到这里, 用自己的reader, 不碰entry::getFileReader()
+    static bool read_include_file(const std::string& filePath,std::string& source){
+        bx::FileReader reader;
+        if(!bx::open(&reader, filePath.c_str())){
+            return false;
+        }
+        source.resize((size_t)bx::getSize(&reader));
+        bx::Error err;
+        bx::read(&reader, &source[0], (int32_t)source.size(), &err);
+        bx::close(&reader);
+        if(!err.isOk()){
+            return false;
+        }
+        if(source.size() >= 3 && source[0] == '\xef' && source[1] == '\xbb' && source[2] == '\xbf'){
+            source.erase(0,3);
+        }
+        return true;
+    }
+
+    bool resolve_include_source(const std::string& filePath,std::string& source){
+        struct stat fileStat;
+        if(stat(filePath.c_str(), &fileStat) != 0){
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(include_source_mutex);
+            auto it = include_sources.find(filePath);
+            if(it != include_sources.end() && it->second.mtime == fileStat.st_mtime && it->second.size == fileStat.st_size){
+                source = it->second.source;
+                return true;
+            }
+        }
+        //读文件时不拿锁, 另一个阶段可以同时取别的include
+        IncludeSource include{fileStat.st_mtime,fileStat.st_size,""};
+        if(!read_include_file(filePath,include.source)){
+            return false;
+        }
+        source = include.source;
+        std::lock_guard<std::mutex> lock(include_source_mutex);
+        include_sources[filePath] = std::move(include);
+        return true;
+    }
+
 //    bgfx::ShaderHandle load_mem_shader(char* data, uint32_t size, const char* _name)
 //    {
 //
@@ -156,7 +223,9 @@ namespace vsg {
     //下面这些函数是外部API
 
     void destroy(){
-        
+        if(vsg_ctx != nullptr && vsg_ctx->binaryCache != nullptr){
+            vsg_ctx->binaryCache->flush();
+        }
     }
     int init(){
         vsg_ctx =  std::make_shared<VSGContext>() ;
@@ -224,11 +293,12 @@ namespace vsg {
         if (!bx::makeAll(dir)){
             return false;
         }
-        bx::FileWriterI* _writer = entry::getFileWriter();
-        if (bx::open(_writer, _fileFullPath))
+        //编译线程的两个阶段和主线程会同时读写文件, 每次用自己的writer, 不共用entry::getFileWriter()
+        bx::FileWriter writer;
+        if (bx::open(&writer, _fileFullPath))
         {
-            bx::write(_writer, data, _size);
-            bx::close(_writer);
+            bx::write(&writer, data, _size);
+            bx::close(&writer);
             return true;
         }
         else
@@ -239,13 +309,14 @@ namespace vsg {
     }
 
     void* _loadFile(const char* _fileFullPath, uint32_t* _size){
-        auto _reader = entry::getFileReader();
-        if (bx::open(_reader, _fileFullPath) )
+        //同_writeFile, 用自己的reader
+        bx::FileReader reader;
+        if (bx::open(&reader, _fileFullPath) )
         {
-            uint32_t size = (uint32_t)bx::getSize(_reader);
+            uint32_t size = (uint32_t)bx::getSize(&reader);
             void* data = BX_ALLOC(entry::getAllocator(), size);
-            bx::read(_reader, data, size);
-            bx::close(_reader);
+            bx::read(&reader, data, size);
+            bx::close(&reader);
             if (NULL != _size)
             {
                 *_size = size;
@@ -319,12 +390,15 @@ namespace vsg {
             filePath = bx::FilePath(dir);//(bx::Dir::Home)
             filePath.join("varying.def.sc");
             
-            vsg_ctx->shaderOption->compileShaderStr[1] = tmpInputFile;
-            vsg_ctx->shaderOption->compileShaderStr[3] = outFileFullPath;
-            vsg_ctx->shaderOption->compileShaderStr[8] = filePath.getCPtr();
-            vsg_ctx->shaderOption->compileShaderStr[12] = shaderType;
-            vsg_ctx->shaderOption->compileShaderStr[14] = get_cur_rt_gl_name();
-            auto success = runshaderc::compileShader(17, vsg_ctx->shaderOption->compileShaderStr,output,outputData,size);
+            //每次编译用自己的参数拷贝, 共享的compileShaderStr只当模板, 多个线程可以同时编译
+            const char* compileShaderStr[BX_COUNTOF(vsg_ctx->shaderOption->compileShaderStr)];
+            bx::memCopy(compileShaderStr, vsg_ctx->shaderOption->compileShaderStr, sizeof(compileShaderStr));
+            compileShaderStr[1] = tmpInputFile;
+            compileShaderStr[3] = outFileFullPath;
+            compileShaderStr[8] = filePath.getCPtr();
+            compileShaderStr[12] = shaderType;
+            compileShaderStr[14] = get_cur_rt_gl_name();
+            auto success = runshaderc::compileShader(BX_COUNTOF(compileShaderStr), compileShaderStr,output,outputData,size);
             if(success == bx::kExitSuccess){
                 bx::debugOutput("compileShader success");
             }else{
@@ -341,6 +415,82 @@ namespace vsg {
     
 
     
+    //缓存目录跟着渲染后端走, 所以要等bgfx初始化之后第一次编译时再创建
+    static std::shared_ptr<ShaderBinaryCache> get_binary_cache(){
+        static std::mutex binary_cache_mutex;
+        std::lock_guard<std::mutex> lock(binary_cache_mutex);
+        if(vsg_ctx->binaryCache == nullptr){
+            std::stringstream cacheDir;
+            cacheDir<<vsg_ctx->dirOption->documentDir<<"/"<<get_cur_rt_shader_path()<<"cache";
+            vsg_ctx->binaryCache = std::make_shared<ShaderBinaryCache>(cacheDir.str(),16<<20,64<<20);
+        }
+        return vsg_ctx->binaryCache;
+    }
+
+    bool compile_shader_memory(const char* sourceName,const std::string& source,const std::string& varyingDef,const char* shaderType,std::vector<uint8_t>& output){
+        const char* const* compileShaderStr = vsg_ctx->shaderOption->compileShaderStr;
+        runshaderc::Options options;
+        options.inputFilePath = sourceName;
+        options.shaderType = bx::toLower(shaderType[0]);
+        options.platform = compileShaderStr[10];
+        options.profile = get_cur_rt_gl_name();
+        options.includeDirs.push_back(compileShaderStr[6]);
+
+        //事件名必须是字面量, 两个阶段分开记
+        const bool isVertex = options.shaderType == 'v';
+        csc::ProfileScope stagePhase(isVertex ? "compile vertex" : "compile fragment");
+
+        std::string expandedSource;
+        csc::ProfileScope expandPhase("expand includes");
+        const bool expanded = runshaderc::expandIncludes(options,source,resolve_include_source,expandedSource);
+        expandPhase.stop();
+        if(!expanded){
+            bx::debugOutput("compileShader failed");
+            return false;
+        }
+        auto binaryCache = get_binary_cache();
+        const uint64_t key = ShaderBinaryCache::make_key(expandedSource,varyingDef,shaderType,options.platform.c_str(),options.profile.c_str());
+        csc::ProfileScope cachePhase("binary cache lookup");
+        const bool cached = binaryCache->find(key,output);
+        cachePhase.stop();
+        if(cached){
+            bx::debugOutput("compileShader cache hit");
+            return true;
+        }
+
+        runshaderc::CompileRequest request;
+        request.options = options;
+        request.source = expandedSource;
+        request.varying = varyingDef;
+        request.includeResolver = resolve_include_source;
+        request.phaseObserver = csc::profile_record;
+        runshaderc::CompileResult result = runshaderc::compile(request);
+        if(result.success){
+            output = std::move(result.binary);
+            binaryCache->insert(key,output);
+            bx::debugOutput("compileShader success");
+        }else{
+            bx::debugOutput(result.error.c_str());
+        }
+        return result.success;
+    }
+
+    bgfx::ProgramHandle create_shader_program(const std::vector<uint8_t>& vsData,const char* vsName,const std::vector<uint8_t>& fsData,const char* fsName){
+        bgfx::ShaderHandle vsh = create_shader(vsData, vsName);
+        bgfx::ShaderHandle fsh = create_shader(fsData, fsName);
+        if(!isValid(vsh) || !isValid(fsh)){
+            if(isValid(vsh)){
+                bgfx::destroy(vsh);
+            }
+            if(isValid(fsh)){
+                bgfx::destroy(fsh);
+            }
+            bgfx::ProgramHandle invalid = BGFX_INVALID_HANDLE;
+            return invalid;
+        }
+        return bgfx::createProgram(vsh, fsh, true /* destroy shaders when program is destroyed */);
+    }
+
     bgfx::ProgramHandle load_shader_program(const char* vsFileName,const char* fsFileName){
         if(exist_document_shader_file(vsFileName)){
             return load_document_program(entry::getFileReader(),vsFileName, fsFileName);
@@ -10,12 +10,15 @@
 #include <bx/os.h>
 #include <stdio.h>
 #include <string.h>
+#include <string>
+#include <vector>
 
 #include "bgfx_utils.h"
 #include "imgui/imgui.h"
 
 #include "shaderc/shaderc.h"
 #include "common.h"
+#include "shader_binary_cache.h"
 
 
 namespace vsg{
@@ -54,6 +57,7 @@ namespace vsg{
         int64_t m_timeOffset;
         std::shared_ptr<VSGDirOption> dirOption;
         std::shared_ptr<VSGShaderOption> shaderOption;
+        std::shared_ptr<ShaderBinaryCache> binaryCache;
     };
 
     static std::shared_ptr<VSGContext> vsg_ctx = NULL;
@@ -67,8 +71,13 @@ namespace vsg{
 
     //编译shader到文件
     int compile_shader(const char* inputFile,const char* outFile,const char* shaderType,bool output = false,char* outputData = NULL,uint32_t* size=NULL);
+    //在内存里编译shader, sourceName只用来解析相对include和打印错误, 不会读写这个文件
+    //编译输入和之前某次相同时直接从ShaderBinaryCache取二进制
+    bool compile_shader_memory(const char* sourceName,const std::string& source,const std::string& varyingDef,const char* shaderType,std::vector<uint8_t>& output);
     //加载shader
     bgfx::ProgramHandle load_shader_program(const char* vsFileName,const char* fsFileName);
+    //用编译好的二进制创建program, 失败返回BGFX_INVALID_HANDLE
+    bgfx::ProgramHandle create_shader_program(const std::vector<uint8_t>& vsData,const char* vsName,const std::vector<uint8_t>& fsData,const char* fsName);
 
     bool write_file(const char* _filePath, void* data, uint32_t _size,bool isDocument);
     void* load_file(const char* _filePath, uint32_t* _size,bool isDocument);